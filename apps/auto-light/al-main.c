@@ -3,17 +3,16 @@
 #include <string.h>
 #include <signal.h>
 #include <stdlib.h>
-#include <unistd.h>
 
 #include <cenviro.h>
 
 #include "al-utils.h"
 
-#define RECHECK_INTERVAL 5 // interval in [s]
-
 static bool _verbose = false;
 static bool _help = false;
-static int _level = 50;
+// clear channel counts with default light configuration (24ms integration, 1x gain)
+static int _level = 500;
+static int _irq_gpio = -1;
 
 static int _check_params(int count, const char **params);
 static void _print_help(char *name);
@@ -36,28 +35,45 @@ int main(int argc, char **argv)
         printf("CEnviro auto light app\n");
         printf("- using light level threshold: %d\n", _level);
     }
+    // sensor INT pin connected to GPIO (otherwise interrupt status is polled)
+    cenviro_set_irq_gpio(CENVIRO_IRQ_LIGHT, _irq_gpio);
     // initialize cenviro library if no issues till now
-    bool result = cenviro_init();
+    const unsigned modules = CENVIRO_MODULE_LIGHT | CENVIRO_MODULE_LED;
+    bool result = cenviro_init_modules(modules);
     if (!result)
     {
         printf("Unable to initialize cenviro library\n");
         return 1;
     }
+    if ((cenviro_modules_ready() & modules) != modules)
+    {
+        printf("Unable to initialize light sensor and LED\n");
+        cenviro_deinit();
+        return 1;
+    }
     // register signal handle
     signal(SIGINT, _sigin_handler);
-    // start light measurement in infinite loop
-    while (true)
+    // set initial light state and wait for light level crossing threshold (sensor interrupt)
+    if (!al_start(_level))
+    {
+        printf("Unable to set light thresholds\n");
+        cenviro_deinit();
+        return 1;
+    }
+    if (_verbose)
     {
-        cenviro_crgb_t measurement = cenviro_light_crgb_scaled();
-
-        al_add_measurement(measurement.clear);
-
-        al_compare_with_threshold(_level);
-
         al_log_state();
-        sleep(RECHECK_INTERVAL);
     }
-    return 0;
+    while (al_wait_and_switch(_level))
+    {
+        if (_verbose)
+        {
+            al_log_state();
+        }
+    }
+    printf("Waiting for light level change failed\n");
+    cenviro_deinit();
+    return 1;
 }
 
 static int _check_params(int count, const char **params)
@@ -115,6 +131,17 @@ static int _check_params(int count, const char **params)
             _level = newlevel;
             continue;
         }
+        if (!strncmp("-g", *params, 2))
+        {
+            ++i;
+            ++params;
+            if (i == count || sscanf(*params, "%d", &_irq_gpio) != 1)
+            {
+                // error - no valid value after 'g'
+                return 1;
+            }
+            continue;
+        }
     }
     return 0;
 }
@@ -123,7 +150,9 @@ static void _print_help(char *name)
 {
     printf("Usage:\n%s [options]\n\n", name);
     printf("Possible options are:\n-h\t\tprint help message\n-v\t\trun in verbose mode (with console output)\n");
-    printf("-l value\tset light switch threshold to value\n");
+    printf("-l value\tset light switch threshold to value (clear channel counts at 24ms integration and 1x gain,\n");
+    printf("\t\tdefault %d)\n", _level);
+    printf("-g pin\t\tGPIO pin connected to light sensor INT output\n");
 }
 
 static void _sigin_handler(int signal)
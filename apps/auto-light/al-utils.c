@@ -2,69 +2,49 @@
 
 #include "al-utils.h"
 
-static uint32_t _counter = 0;
-static uint16_t _samples[4] = {0};
+// number of consecutive integration cycles out of range needed to switch lights (filters short flashes)
+#define AL_PERSISTENCE 10
+// switch-off level is higher than switch-on one by 1/AL_HYSTERESIS_DIV of threshold (LEDs are seen by sensor)
+#define AL_HYSTERESIS_DIV 8
+
 static bool _led_state = false;
-static bool _is_full = false;
+static uint16_t _last_value = 0;
 
-void al_add_measurement(uint16_t value)
+// with LEDs off interrupt is raised when it gets darker than threshold,
+// with LEDs on - when light level exceeds threshold with hysteresis margin
+static bool _arm_threshold(uint16_t thr)
 {
-    _samples[_counter & 0x03] = value;
-    _counter++;
-    if (_counter == 4)
+    if (_led_state)
     {
-        _is_full = true;
+        uint32_t high = thr + thr / AL_HYSTERESIS_DIV;
+        return cenviro_light_set_thresholds(0, (high > UINT16_MAX) ? UINT16_MAX : high, AL_PERSISTENCE);
     }
+    return cenviro_light_set_thresholds(thr, UINT16_MAX, AL_PERSISTENCE);
 }
 
-static uint16_t _get_average()
+bool al_start(uint16_t thr)
 {
-    uint8_t count = 0;
-    if (_is_full)
-    {
-        count = 4;
-    }
-    else
-    {
-        // in case of some error it's better to mas counter value
-        count = _counter & 0x03;
-    }
-    uint32_t avg = 0;
-    for (uint8_t i = 0; i < count; ++i)
-    {
-        avg += _samples[i];
-    }
-    avg /= count;
-    return (uint16_t)avg;
+    cenviro_crgb_t measurement = cenviro_light_crgb_raw();
+    _last_value = measurement.clear;
+    _led_state = measurement.clear < thr;
+    cenviro_led_set(_led_state);
+    return _arm_threshold(thr);
 }
 
-void al_compare_with_threshold(uint16_t thr)
+bool al_wait_and_switch(uint16_t thr)
 {
-    uint16_t average = _get_average();
-    if (average >= thr)
-    {
-        // if already turned off then no need to change anything
-        // otherwise turn LEDs off
-        if (_led_state == true)
-        {
-            _led_state = false;
-            cenviro_led_set(_led_state);
-        }
-    }
-    else
+    cenviro_crgb_t measurement;
+    if (cenviro_light_wait_threshold(-1, &measurement) != 1)
     {
-        // average value below threshold - turn light on if not already on
-        if (_led_state == false)
-        {
-            _led_state = true;
-            cenviro_led_set(_led_state);
-        }
+        return false;
     }
+    _last_value = measurement.clear;
+    _led_state = measurement.clear < thr;
+    cenviro_led_set(_led_state);
+    return _arm_threshold(thr);
 }
 
 void al_log_state()
 {
-    uint16_t last_value = _samples[(_counter - 1) & 0x03];
-    uint16_t average = _get_average();
-    printf("Last measurement: %d Current average: %d Light state: %d\n", last_value, average, _led_state);
+    printf("Last measurement: %d Light state: %d\n", _last_value, _led_state);
 }
@@ -1,13 +1,14 @@
 #ifndef _AL_UTILS_H_
 #define _AL_UTILS_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <cenviro.h>
 
-void al_add_measurement(uint16_t value);
+bool al_start(uint16_t thr);
 
-void al_compare_with_threshold(uint16_t thr);
+bool al_wait_and_switch(uint16_t thr);
 
 void al_log_state();
 
@@ -0,0 +1,811 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include <cenviro.h>
+
+#include "bench-utils.h"
+
+#define DEFAULT_ITERATIONS 1000
+#define DEFAULT_CLOCK_HZ 100000
+#define DEFAULT_THREADS 8
+#define MAX_THREADS 64
+#define STARTUP_CACHE_FILE "/tmp/cenvirobench.cache"
+#define LUX_SAMPLES (1 << 20)
+#define VIBRATION_SAMPLES (1 << 20)
+#define VIBRATION_RATE_HZ 1600
+#define PATTERN_RUN_MS 1000
+#define PATTERN_PWM_HZ 1000
+// every legacy register read sleeps 5ms
+#define LEGACY_ITERATIONS 100
+// log messages recorded between flushes (half of library log ring, so none is dropped)
+#define LOG_FLUSH_BLOCK 128
+
+// config flags
+static bool _opt_read = false;
+static bool _opt_contention = false;
+static bool _opt_startup = false;
+static bool _opt_lux = false;
+static bool _opt_vibration = false;
+static bool _opt_pattern = false;
+static const char *_opt_led_chip = NULL;
+static unsigned long _opt_led_line = 0;
+static size_t _iterations = DEFAULT_ITERATIONS;
+static size_t _threads = DEFAULT_THREADS;
+static cenviro_sim_config_t _sim_config = {.clock_hz = DEFAULT_CLOCK_HZ};
+
+static bool _parse_options(int argc, char *argv[]);
+static void _bench_read_latency();
+static void _bench_contention();
+static void _bench_startup();
+static void _bench_lux();
+static void _bench_vibration();
+static void _bench_pattern();
+static void _bench_led_line();
+
+int main(int argc, char *argv[])
+{
+    printf("CEnviroLib benchmark (simulated board)\n");
+
+    if (!_parse_options(argc, argv))
+    {
+        return 0;
+    }
+
+    cenviro_set_bus(CENVIRO_BUS_SIMULATED, NULL);
+    cenviro_sim_configure(&_sim_config);
+    printf("- bus clock: %uHz, transfer latency: %uus, iterations: %zu\n\n",
+           _sim_config.clock_hz, _sim_config.transfer_latency_us, _iterations);
+
+    if (_opt_startup)
+    {
+        // has to be done before library is initialized for the rest of benchmarks
+        _bench_startup();
+    }
+    if (_opt_led_chip != NULL)
+    {
+        // LED line descriptor has to be set before library is initialized
+        _bench_led_line();
+    }
+
+    if (_opt_lux)
+    {
+        // pure computation, does not need initialized library
+        _bench_lux();
+    }
+    if (_opt_vibration)
+    {
+        _bench_vibration();
+    }
+
+    if (!cenviro_init())
+    {
+        printf("Failed to initialize cenviro library\n");
+        return 1;
+    }
+
+    if (_opt_read)
+    {
+        _bench_read_latency();
+    }
+    if (_opt_contention)
+    {
+        _bench_contention();
+    }
+    if (_opt_pattern)
+    {
+        _bench_pattern();
+    }
+
+    cenviro_deinit();
+    return 0;
+}
+
+#define BENCH_READ_N(name, iterations, call)                      \
+    do                                                            \
+    {                                                             \
+        bench_stats_t stats;                                      \
+        if (!bench_stats_init(&stats, (iterations)))              \
+        {                                                         \
+            break;                                                \
+        }                                                         \
+        uint64_t transfers = cenviro_sim_transfers();             \
+        for (size_t i = 0; i < (iterations); ++i)                 \
+        {                                                         \
+            uint64_t start = bench_now_ns();                      \
+            call;                                                 \
+            bench_stats_add(&stats, bench_now_ns() - start);      \
+        }                                                         \
+        transfers = cenviro_sim_transfers() - transfers;          \
+        bench_stats_print(name, &stats);                          \
+        printf("%-28s %.2f bus transactions per read\n", "",      \
+               (double)transfers / (iterations));                 \
+        bench_stats_free(&stats);                                 \
+    } while (0)
+
+#define BENCH_READ(name, call) BENCH_READ_N(name, _iterations, call)
+
+// the same read with combined register transactions and with legacy read path (address write, 5ms wait, read)
+#define BENCH_READ_PATH(name, call)                                      \
+    do                                                                   \
+    {                                                                    \
+        size_t count = _iterations;                                      \
+        count = (count < LEGACY_ITERATIONS) ? count : LEGACY_ITERATIONS; \
+        cenviro_sim_config_t legacy = _sim_config;                       \
+        legacy.legacy_reads = true;                                      \
+        BENCH_READ_N(name " (combined)", count, call);                   \
+        cenviro_sim_configure(&legacy);                                  \
+        BENCH_READ_N(name " (legacy)", count, call);                     \
+        cenviro_sim_configure(&_sim_config);                             \
+    } while (0)
+
+// bus latency histograms collected by library since last reset
+static void _print_bus_stats()
+{
+    cenviro_stats_t stats;
+    if (!cenviro_stats_get(&stats) || stats.transactions == 0)
+    {
+        return;
+    }
+    printf("%-28s transfer mean %6.1fus p50 %6.1fus p99 %6.1fus\n", "bus",
+           stats.transfer_total_ns / 1e3 / stats.transactions, cenviro_stats_percentile(stats.transfer_ns, 0.5) / 1e3,
+           cenviro_stats_percentile(stats.transfer_ns, 0.99) / 1e3);
+    printf("%-28s lock wait mean %6.1fus p50 %6.1fus p99 %6.1fus\n", "",
+           stats.lock_wait_total_ns / 1e3 / stats.transactions, cenviro_stats_percentile(stats.lock_wait_ns, 0.5) / 1e3,
+           cenviro_stats_percentile(stats.lock_wait_ns, 0.99) / 1e3);
+}
+
+static void _discard_log(cenviro_log_level_t level, uint64_t timestamp_ns, const char *message, void *context)
+{
+}
+
+// ring is drained outside of timed calls before it fills, so only enqueueing is measured
+static void _bench_log_enabled()
+{
+    bench_stats_t stats;
+    if (!bench_stats_init(&stats, _iterations))
+    {
+        return;
+    }
+    for (size_t i = 0; i < _iterations; ++i)
+    {
+        uint64_t start = bench_now_ns();
+        cenviro_log(CENVIRO_LOG_INFO, "bench %zu %s", i, "message");
+        bench_stats_add(&stats, bench_now_ns() - start);
+        if ((i + 1) % LOG_FLUSH_BLOCK == 0)
+        {
+            cenviro_log_flush();
+        }
+    }
+    cenviro_log_flush();
+    bench_stats_print("log (level enabled)", &stats);
+    bench_stats_free(&stats);
+}
+
+static void _bench_read_latency()
+{
+    double temperature = 0.0;
+    double pressure = 0.0;
+
+    printf("Per-read latency\n");
+    cenviro_stats_reset();
+    BENCH_READ("weather_temperature", cenviro_weather_temperature());
+    BENCH_READ("weather_pressure", cenviro_weather_pressure());
+    BENCH_READ("weather_read", cenviro_weather_read(&temperature, &pressure));
+    BENCH_READ("weather_chip_id", cenviro_weather_chip_id());
+    BENCH_READ("light_crgb_raw", cenviro_light_crgb_raw());
+    BENCH_READ("motion_temperature", cenviro_motion_temperature());
+    BENCH_READ("motion_acceleration", cenviro_motion_acceleration());
+    BENCH_READ("motion_heading", cenviro_motion_heading(NULL));
+    BENCH_READ("adc_voltage", cenviro_adc_voltage(0));
+    BENCH_READ("led_set (simulated)", cenviro_led_set(i & 1));
+    BENCH_READ("read_all", cenviro_read_all(CENVIRO_SENSOR_ALL));
+    BENCH_READ("weather_read_forced", cenviro_weather_read_forced(&temperature, &pressure));
+    _print_bus_stats();
+
+    // messages go to discarding sink
+    cenviro_log_level_t level = cenviro_log_level();
+    cenviro_log_set_sink(_discard_log, NULL);
+    cenviro_log_set_level(CENVIRO_LOG_INFO);
+    BENCH_READ("log (level disabled)", cenviro_log(CENVIRO_LOG_DEBUG, "bench %zu %s", i, "message"));
+    _bench_log_enabled();
+    cenviro_log_set_sink(NULL, NULL);
+    cenviro_log_set_level(level);
+
+    printf("\nRegister read path (before/after combined I2C_RDWR transactions)\n");
+    BENCH_READ_PATH("weather_temp", cenviro_weather_temperature());
+    BENCH_READ_PATH("light_crgb_raw", cenviro_light_crgb_raw());
+    BENCH_READ_PATH("motion_temp", cenviro_motion_temperature());
+    printf("\n");
+}
+
+// startup benchmark - library init without cache, with missing cache file (cold), with valid one (warm)
+// and with selected modules only
+static void _run_startup(const char *name, unsigned modules, const char *cache, bool cold)
+{
+    bench_stats_t stats;
+    if (!bench_stats_init(&stats, _iterations))
+    {
+        return;
+    }
+    cenviro_set_calibration_cache(cache);
+    // simulated board is created on every init, so its transaction counter starts from zero
+    uint64_t transfers = 0;
+    for (size_t i = 0; i < _iterations; ++i)
+    {
+        if (cold)
+        {
+            remove(cache);
+        }
+        uint64_t start = bench_now_ns();
+        bool status = cenviro_init_modules(modules);
+        bench_stats_add(&stats, bench_now_ns() - start);
+        if (!status || cenviro_modules_ready() != modules)
+        {
+            printf("Failed to initialize cenviro library\n");
+            cenviro_deinit();
+            break;
+        }
+        transfers += cenviro_sim_transfers();
+        cenviro_deinit();
+    }
+    bench_stats_print(name, &stats);
+    printf("%-28s %.2f bus transactions per init\n", "", (double)transfers / _iterations);
+    bench_stats_free(&stats);
+}
+
+static void _bench_startup()
+{
+    printf("Startup latency\n");
+    _run_startup("init (no cache)", CENVIRO_MODULE_DEFAULT, NULL, false);
+    _run_startup("init (cold cache)", CENVIRO_MODULE_DEFAULT, STARTUP_CACHE_FILE, true);
+    _run_startup("init (warm cache)", CENVIRO_MODULE_DEFAULT, STARTUP_CACHE_FILE, false);
+    _run_startup("init (light + led only)", CENVIRO_MODULE_LIGHT | CENVIRO_MODULE_LED, NULL, false);
+    remove(STARTUP_CACHE_FILE);
+    cenviro_set_calibration_cache(NULL);
+    printf("\n");
+}
+
+// lux conversion throughput - per-sample calls against batch kernels over the same archived-like data set
+static void _lux_result(const char *name, uint64_t elapsed, float checksum)
+{
+    printf("%-28s %8.2f Msamples/s (checksum %.0f)\n", name, LUX_SAMPLES * 1e3 / elapsed, checksum);
+}
+
+static void _bench_lux()
+{
+    const uint32_t integration_us = 24000;
+    const cenviro_light_gain_t gain = CENVIRO_LIGHT_GAIN_4X;
+    cenviro_crgb_t *samples = malloc(LUX_SAMPLES * sizeof(cenviro_crgb_t));
+    uint16_t *channels = malloc(4 * LUX_SAMPLES * sizeof(uint16_t));
+    float *lux = malloc(LUX_SAMPLES * sizeof(float));
+    float *cct = malloc(LUX_SAMPLES * sizeof(float));
+    int32_t *lux_q8 = malloc(LUX_SAMPLES * sizeof(int32_t));
+    int32_t *cct_k = malloc(LUX_SAMPLES * sizeof(int32_t));
+    if (!samples || !channels || !lux || !cct || !lux_q8 || !cct_k)
+    {
+        printf("Failed to allocate lux benchmark buffers\n");
+        goto cleanup;
+    }
+    uint16_t *clear = channels;
+    uint16_t *red = clear + LUX_SAMPLES;
+    uint16_t *green = red + LUX_SAMPLES;
+    uint16_t *blue = green + LUX_SAMPLES;
+
+    srand(1);
+    for (size_t i = 0; i < LUX_SAMPLES; ++i)
+    {
+        red[i] = samples[i].red = rand() % 3000;
+        green[i] = samples[i].green = rand() % 3000;
+        blue[i] = samples[i].blue = rand() % 3000;
+        clear[i] = samples[i].clear = red[i] + green[i] + blue[i] + rand() % 500;
+    }
+
+    printf("Lux conversion (%d samples)\n", LUX_SAMPLES);
+    float checksum = 0.0f;
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < LUX_SAMPLES; ++i)
+    {
+        cenviro_lux_t value = cenviro_light_lux_compute(samples[i], integration_us, gain);
+        lux[i] = value.lux;
+        cct[i] = value.cct;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    _lux_result("per-sample", elapsed, lux[LUX_SAMPLES - 1] + cct[LUX_SAMPLES - 1]);
+
+    start = bench_now_ns();
+    cenviro_light_lux_batch_crgb(samples, LUX_SAMPLES, integration_us, gain, lux, cct);
+    elapsed = bench_now_ns() - start;
+    _lux_result("batch (crgb array)", elapsed, lux[LUX_SAMPLES - 1] + cct[LUX_SAMPLES - 1]);
+
+    start = bench_now_ns();
+    cenviro_light_lux_batch(clear, red, green, blue, LUX_SAMPLES, integration_us, gain, lux, cct);
+    elapsed = bench_now_ns() - start;
+    _lux_result("batch (channel arrays)", elapsed, lux[LUX_SAMPLES - 1] + cct[LUX_SAMPLES - 1]);
+
+    start = bench_now_ns();
+    cenviro_light_lux_batch_fixed(clear, red, green, blue, LUX_SAMPLES, integration_us, gain, lux_q8, cct_k);
+    elapsed = bench_now_ns() - start;
+    checksum = lux_q8[LUX_SAMPLES - 1] / 256.0f + cct_k[LUX_SAMPLES - 1];
+    _lux_result("batch fixed-point", elapsed, checksum);
+    printf("\n");
+
+cleanup:
+    free(samples);
+    free(channels);
+    free(lux);
+    free(cct);
+    free(lux_q8);
+    free(cct_k);
+}
+
+// vibration analysis throughput - the same signal (two tones and noise) analyzed with common window sizes
+static void _bench_vibration()
+{
+    static const uint32_t sizes[] = {256, 1024, 4096};
+    float *signal = malloc(VIBRATION_SAMPLES * sizeof(float));
+    if (!signal)
+    {
+        printf("Failed to allocate vibration benchmark buffer\n");
+        return;
+    }
+    srand(1);
+    for (size_t i = 0; i < VIBRATION_SAMPLES; ++i)
+    {
+        double t = (double)i / VIBRATION_RATE_HZ;
+        signal[i] = 1.0f + 0.5f * sinf(2.0f * M_PI * 120.0 * t) + 0.1f * sinf(2.0f * M_PI * 410.0 * t) +
+                    0.05f * ((float)rand() / RAND_MAX - 0.5f);
+    }
+
+    printf("Vibration analysis (%d samples, %dHz)\n", VIBRATION_SAMPLES, VIBRATION_RATE_HZ);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        cenviro_vibration_config_t config = {.window_size = sizes[s],
+                                             .sample_rate_hz = VIBRATION_RATE_HZ,
+                                             .window = CENVIRO_WINDOW_HANN,
+                                             .band_count = 3,
+                                             .band_edges_hz = {10.0f, 100.0f, 300.0f, 800.0f}};
+        cenviro_vibration_t *analyzer = cenviro_vibration_create(&config);
+        if (!analyzer)
+        {
+            printf("Failed to create vibration analyzer\n");
+            break;
+        }
+        cenviro_vibration_result_t result = {0};
+        size_t windows = VIBRATION_SAMPLES / sizes[s];
+        uint64_t start = bench_now_ns();
+        for (size_t w = 0; w < windows; ++w)
+        {
+            cenviro_vibration_analyze(analyzer, signal + w * sizes[s], &result);
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+        printf("window %-21u %8.0f windows/s (%.2f Msamples/s, rms %.3fg, dominant %.1fHz)\n", sizes[s],
+               windows * 1e9 / elapsed, windows * sizes[s] * 1e3 / elapsed, result.rms, result.dominant_hz);
+        cenviro_vibration_destroy(analyzer);
+    }
+    printf("\n");
+    free(signal);
+}
+
+// contention benchmark - each thread reads all sensors in a loop
+typedef struct
+{
+    bool snapshot;
+    bench_stats_t stats;
+} bench_thread_t;
+
+static void *_contention_worker(void *params)
+{
+    bench_thread_t *thread = params;
+    for (size_t i = 0; i < _iterations; ++i)
+    {
+        uint64_t start = bench_now_ns();
+        if (thread->snapshot)
+        {
+            cenviro_weather_sample_t weather;
+            cenviro_light_sample_t light;
+            cenviro_motion_sample_t motion;
+            switch (i % 3)
+            {
+            case 0:
+                cenviro_sampler_weather(&weather);
+                break;
+            case 1:
+                cenviro_sampler_light(&light);
+                break;
+            default:
+                cenviro_sampler_motion(&motion);
+                break;
+            }
+        }
+        else
+        {
+            switch (i % 3)
+            {
+            case 0:
+                cenviro_weather_temperature();
+                break;
+            case 1:
+                cenviro_light_crgb_scaled();
+                break;
+            default:
+                cenviro_motion_temperature();
+                break;
+            }
+        }
+        bench_stats_add(&thread->stats, bench_now_ns() - start);
+    }
+    return NULL;
+}
+
+static void _run_contention(const char *name, bool snapshot)
+{
+    pthread_t ids[MAX_THREADS];
+    bench_thread_t threads[MAX_THREADS];
+    bench_stats_t total;
+    size_t started = 0;
+
+    if (!bench_stats_init(&total, _iterations * _threads))
+    {
+        return;
+    }
+    cenviro_stats_reset();
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < _threads; ++i)
+    {
+        threads[i].snapshot = snapshot;
+        if (!bench_stats_init(&threads[i].stats, _iterations))
+        {
+            break;
+        }
+        if (pthread_create(&ids[i], NULL, _contention_worker, &threads[i]) != 0)
+        {
+            bench_stats_free(&threads[i].stats);
+            break;
+        }
+        ++started;
+    }
+    for (size_t i = 0; i < started; ++i)
+    {
+        pthread_join(ids[i], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    for (size_t i = 0; i < started; ++i)
+    {
+        for (size_t j = 0; j < threads[i].stats.count; ++j)
+        {
+            bench_stats_add(&total, threads[i].stats.samples[j]);
+        }
+        bench_stats_free(&threads[i].stats);
+    }
+    bench_stats_print(name, &total);
+    printf("%-28s %.0f reads/s with %zu threads\n", "", total.count * 1e9 / elapsed, started);
+    _print_bus_stats();
+    bench_stats_free(&total);
+}
+
+static void _bench_contention()
+{
+    printf("Contention (%zu reader threads)\n", _threads);
+    _run_contention("direct reads", false);
+
+    cenviro_sampler_config_t sampler = {.weather_period_ms = 10, .light_period_ms = 10, .motion_period_ms = 10};
+    if (cenviro_sampler_start(&sampler))
+    {
+        _run_contention("sampler snapshot reads", true);
+        cenviro_sampler_stop();
+    }
+    printf("\n");
+}
+
+// LED pattern timing - lateness of LED changes of software PWM played by library thread, idle and with
+// CPU load (busy threads)
+static bool _load_stop = false;
+
+static void *_load_worker(void *params)
+{
+    while (!__atomic_load_n(&_load_stop, __ATOMIC_RELAXED))
+    {
+    }
+    return NULL;
+}
+
+static void _run_pattern(const char *name, size_t load_threads)
+{
+    pthread_t ids[MAX_THREADS];
+    size_t started = 0;
+    cenviro_led_pattern_t pattern;
+
+    __atomic_store_n(&_load_stop, false, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < load_threads; ++i)
+    {
+        if (pthread_create(&ids[i], NULL, _load_worker, NULL) != 0)
+        {
+            break;
+        }
+        ++started;
+    }
+    cenviro_led_pattern_pwm(&pattern, 50, PATTERN_PWM_HZ);
+    cenviro_led_timing(true);
+    if (cenviro_led_play(&pattern))
+    {
+        usleep(PATTERN_RUN_MS * 1000);
+        cenviro_led_stop();
+    }
+    cenviro_led_timing_t timing = cenviro_led_timing(true);
+    __atomic_store_n(&_load_stop, true, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < started; ++i)
+    {
+        pthread_join(ids[i], NULL);
+    }
+    printf("%-28s mean %8.1fus  stddev %8.1fus  max %8.1fus\n", name, timing.mean_ns / 1e3, timing.stddev_ns / 1e3,
+           timing.max_ns / 1e3);
+    printf("%-28s %llu changes, %llu missed steps\n", "", (unsigned long long)timing.changes,
+           (unsigned long long)timing.missed);
+}
+
+static void _bench_pattern()
+{
+    printf("LED pattern timing (%dHz PWM)\n", PATTERN_PWM_HZ);
+    _run_pattern("idle", 0);
+    char name[32];
+    snprintf(name, sizeof(name), "%zu busy threads", _threads);
+    _run_pattern(name, _threads);
+    printf("\n");
+}
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+
+// output line request done the same way as library does it on i2c-dev bus
+static int _request_led_line()
+{
+    int chip = open(_opt_led_chip, O_RDWR);
+    if (chip < 0)
+    {
+        return -1;
+    }
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = _opt_led_line;
+    request.num_lines = 1;
+    strncpy(request.consumer, "cenvirobench", GPIO_MAX_NAME_SIZE - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    int status = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+    close(chip);
+    return (status < 0) ? -1 : request.fd;
+}
+
+// LED on real GPIO line (ex. gpio-sim one) - line request, library LED init with application line request
+// (cenviro_set_led_fd()) and toggle latency of GPIO_V2_LINE_SET_VALUES_IOCTL path
+static void _bench_led_line()
+{
+    printf("LED GPIO line (%s, line %lu)\n", _opt_led_chip, _opt_led_line);
+    bench_stats_t stats;
+    if (!bench_stats_init(&stats, _iterations))
+    {
+        return;
+    }
+    for (size_t i = 0; i < _iterations; ++i)
+    {
+        uint64_t start = bench_now_ns();
+        int fd = _request_led_line();
+        bench_stats_add(&stats, bench_now_ns() - start);
+        if (fd < 0)
+        {
+            printf("Failed to request GPIO line\n");
+            bench_stats_free(&stats);
+            return;
+        }
+        close(fd);
+    }
+    bench_stats_print("line request", &stats);
+    bench_stats_free(&stats);
+
+    int fd = _request_led_line();
+    if (fd < 0 || !bench_stats_init(&stats, _iterations))
+    {
+        printf("Failed to request GPIO line\n");
+        return;
+    }
+    cenviro_set_led_fd(fd);
+    for (size_t i = 0; i < _iterations; ++i)
+    {
+        uint64_t start = bench_now_ns();
+        bool status = cenviro_init_modules(CENVIRO_MODULE_LED);
+        bench_stats_add(&stats, bench_now_ns() - start);
+        if (!status)
+        {
+            printf("Failed to initialize cenviro library\n");
+            break;
+        }
+        cenviro_deinit();
+    }
+    bench_stats_print("init (led, application fd)", &stats);
+    bench_stats_free(&stats);
+
+    if (cenviro_init_modules(CENVIRO_MODULE_LED))
+    {
+        BENCH_READ("led_set (line)", cenviro_led_set(i & 1));
+        // line value is read back - toggles really reached the line
+        struct gpio_v2_line_values values = {.bits = 0, .mask = 1};
+        cenviro_led_set(true);
+        bool on = ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0 && (values.bits & 1);
+        cenviro_led_set(false);
+        values.bits = 0;
+        bool off = ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0 && !(values.bits & 1);
+        printf("%-28s %s\n", "line value follows LED", (on && off) ? "yes" : "NO");
+        cenviro_deinit();
+    }
+    cenviro_set_led_fd(-1);
+    close(fd);
+    printf("\n");
+}
+
+#else
+
+static void _bench_led_line()
+{
+    printf("LED GPIO line benchmark needs kernel headers with GPIO v2 uAPI\n\n");
+}
+
+#endif // GPIO_V2_GET_LINE_IOCTL
+
+static void _print_help(const char *name)
+{
+    printf("Usage:\n");
+    printf("%s [OPTIONS]\n", name);
+    printf("\nAllowed options are:\n");
+    printf("-h\t\tprint this help message\n");
+    printf("-a\t\tlaunch all benchmarks\n");
+    printf("-r\t\tlaunch per-read latency benchmark\n");
+    printf("-m\t\tlaunch multi-thread contention benchmark\n");
+    printf("-s\t\tlaunch startup (init) latency benchmark with and without calibration cache\n");
+    printf("-x\t\tlaunch lux conversion throughput benchmark (per-sample and batch kernels)\n");
+    printf("-v\t\tlaunch vibration analysis (windowed FFT) throughput benchmark\n");
+    printf("-p\t\tlaunch LED pattern timing (jitter) benchmark, idle and with busy threads\n");
+    printf("-g chip line\tlaunch LED benchmark on GPIO line (ex. gpio-sim) passed with cenviro_set_led_fd()\n");
+    printf("-t threads\tnumber of threads for contention and pattern benchmarks (default %d)\n", DEFAULT_THREADS);
+    printf("-n count\tnumber of iterations (default %d)\n", DEFAULT_ITERATIONS);
+    printf("-l us\t\tsimulated latency of each bus transaction (default 0)\n");
+    printf("-c hz\t\tsimulated bus clock (default %d, 0 - no per-byte time)\n", DEFAULT_CLOCK_HZ);
+}
+
+static bool _parse_number(int argc, char *argv[], int *index, unsigned long *value)
+{
+    if (*index + 1 >= argc)
+    {
+        printf("Missing value for %s\n", argv[*index]);
+        return false;
+    }
+    ++(*index);
+    char *end = NULL;
+    *value = strtoul(argv[*index], &end, 10);
+    if (end == argv[*index] || *end != '\0')
+    {
+        printf("Invalid value: %s\n", argv[*index]);
+        return false;
+    }
+    return true;
+}
+
+static bool _parse_options(int argc, char *argv[])
+{
+    if (argc == 0 || !argv)
+    {
+        return false;
+    }
+    if (argc == 1)
+    {
+        _print_help(argv[0]);
+        return false;
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        unsigned long value = 0;
+        if (strncmp(argv[i], "-h", 2) == 0)
+        {
+            _print_help(argv[0]);
+            return false;
+        }
+        if (strncmp(argv[i], "-a", 2) == 0)
+        {
+            _opt_read = true;
+            _opt_contention = true;
+            _opt_startup = true;
+            _opt_lux = true;
+            _opt_vibration = true;
+            _opt_pattern = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-v", 2) == 0)
+        {
+            _opt_vibration = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-p", 2) == 0)
+        {
+            _opt_pattern = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-x", 2) == 0)
+        {
+            _opt_lux = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-s", 2) == 0)
+        {
+            _opt_startup = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-m", 2) == 0)
+        {
+            _opt_contention = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-g", 2) == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                printf("Missing value for %s\n", argv[i]);
+                return false;
+            }
+            _opt_led_chip = argv[++i];
+            if (!_parse_number(argc, argv, &i, &value))
+            {
+                return false;
+            }
+            _opt_led_line = value;
+            continue;
+        }
+        if (strncmp(argv[i], "-t", 2) == 0)
+        {
+            if (!_parse_number(argc, argv, &i, &value) || value == 0 || value > MAX_THREADS)
+            {
+                return false;
+            }
+            _threads = value;
+            continue;
+        }
+        if (strncmp(argv[i], "-r", 2) == 0)
+        {
+            _opt_read = true;
+            continue;
+        }
+        if (strncmp(argv[i], "-n", 2) == 0)
+        {
+            if (!_parse_number(argc, argv, &i, &value) || value == 0)
+            {
+                return false;
+            }
+            _iterations = value;
+            continue;
+        }
+        if (strncmp(argv[i], "-l", 2) == 0)
+        {
+            if (!_parse_number(argc, argv, &i, &value))
+            {
+                return false;
+            }
+            _sim_config.transfer_latency_us = value;
+            continue;
+        }
+        if (strncmp(argv[i], "-c", 2) == 0)
+        {
+            if (!_parse_number(argc, argv, &i, &value))
+            {
+                return false;
+            }
+            _sim_config.clock_hz = value;
+            continue;
+        }
+    }
+    return true;
+}
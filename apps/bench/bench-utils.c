@@ -0,0 +1,65 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench-utils.h"
+
+uint64_t bench_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+bool bench_stats_init(bench_stats_t *stats, size_t capacity)
+{
+    stats->samples = malloc(capacity * sizeof(uint64_t));
+    stats->count = 0;
+    stats->capacity = capacity;
+    return stats->samples != NULL;
+}
+
+void bench_stats_add(bench_stats_t *stats, uint64_t value)
+{
+    if (stats->count < stats->capacity)
+    {
+        stats->samples[stats->count++] = value;
+    }
+}
+
+static int _compare(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *)a;
+    uint64_t vb = *(const uint64_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+void bench_stats_print(const char *name, bench_stats_t *stats)
+{
+    if (stats->count == 0)
+    {
+        printf("%-28s no samples\n", name);
+        return;
+    }
+    qsort(stats->samples, stats->count, sizeof(uint64_t), _compare);
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < stats->count; ++i)
+    {
+        sum += stats->samples[i];
+    }
+    printf("%-28s mean %9.1fus  p50 %9.1fus  p99 %9.1fus  max %9.1fus\n", name,
+           (double)sum / stats->count / 1000.0,
+           stats->samples[stats->count / 2] / 1000.0,
+           stats->samples[(stats->count * 99) / 100] / 1000.0,
+           stats->samples[stats->count - 1] / 1000.0);
+}
+
+void bench_stats_free(bench_stats_t *stats)
+{
+    free(stats->samples);
+    stats->samples = NULL;
+    stats->count = 0;
+    stats->capacity = 0;
+}
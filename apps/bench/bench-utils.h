@@ -0,0 +1,26 @@
+#ifndef _BENCH_UTILS_H_
+#define _BENCH_UTILS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// latency statistics of single benchmark run (values in [ns])
+typedef struct
+{
+    uint64_t *samples;
+    size_t count;
+    size_t capacity;
+} bench_stats_t;
+
+uint64_t bench_now_ns();
+
+bool bench_stats_init(bench_stats_t *stats, size_t capacity);
+
+void bench_stats_add(bench_stats_t *stats, uint64_t value);
+
+void bench_stats_print(const char *name, bench_stats_t *stats);
+
+void bench_stats_free(bench_stats_t *stats);
+
+#endif // _BENCH_UTILS_H_
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include <cenviro.h>
+
+// Library checks run on simulated board (make check), exit status is the number of failed checks
+
+#define GRAVITY_TOLERANCE_G 0.05
+// accelerometer samples at 50Hz by default - a few samples let high-pass filter settle
+#define SETTLE_TIME_US 200000
+
+static int _failures = 0;
+
+static void _check(const char *name, bool passed)
+{
+    printf("%-56s %s\n", name, passed ? "ok" : "FAILED");
+    if (!passed)
+    {
+        ++_failures;
+    }
+}
+
+// wake-up interrupt uses high-pass filtered data, acceleration output has to keep gravity
+static void _check_motion_wakeup()
+{
+    cenviro_motion_irq_config_t irq = {
+        .int1_sources = CENVIRO_MOTION_INT_INERTIAL, .wakeup_threshold_g = 0.25, .wakeup_duration_ms = 0};
+
+    cenviro_vector_t acceleration = cenviro_motion_acceleration();
+    _check("motion: gravity on Z axis", fabs(acceleration.z - 1.0) < GRAVITY_TOLERANCE_G);
+
+    _check("motion: wake-up interrupt armed", cenviro_motion_set_interrupts(&irq));
+    usleep(SETTLE_TIME_US);
+    acceleration = cenviro_motion_acceleration();
+    _check("motion: gravity kept while wake-up interrupt is armed", fabs(acceleration.z - 1.0) < GRAVITY_TOLERANCE_G);
+
+    // no motion - gravity alone does not raise inertial event
+    unsigned sources = 0;
+    _check("motion: no wake-up event at rest", cenviro_motion_wait(CENVIRO_IRQ_MOTION1, 100, &sources) == 0);
+
+    // 0.5g step on X axis
+    const uint8_t step[2] = {0x00, 0x20};
+    cenviro_sim_poke(0x1d, 0x28, step, sizeof(step));
+    sources = 0;
+    _check("motion: wake-up event on acceleration step", cenviro_motion_wait(CENVIRO_IRQ_MOTION1, 1000, &sources) == 1 &&
+                                                         (sources & CENVIRO_MOTION_INT_INERTIAL));
+
+    cenviro_motion_clear_interrupts();
+}
+
+// comparator alerts come from conversions of monitored channel, not from stale conversion register
+static void _check_adc_comparator()
+{
+    cenviro_adc_alert_config_t alert = {
+        .mode = CENVIRO_ADC_ALERT_TRADITIONAL, .low_v = 0.5, .high_v = 1.0, .queue = 1, .latching = false, .channel = 0};
+    // AIN0 pseudo register - 12-bit counts left aligned (2mV per count in default +-4.096V range)
+    const uint8_t high_input[2] = {0x3e, 0x80}; // 2.0V
+    const uint8_t low_input[2] = {0x07, 0xd0};  // 0.25V
+
+    cenviro_sim_poke(0x49, 4, low_input, sizeof(low_input));
+    _check("adc: comparator armed", cenviro_adc_set_alert(&alert));
+    usleep(SETTLE_TIME_US / 10);
+    int16_t raw = 0;
+    _check("adc: no comparator alert below threshold", cenviro_adc_wait(100, &raw) == 0);
+
+    cenviro_sim_poke(0x49, 4, high_input, sizeof(high_input));
+    raw = 0;
+    _check("adc: comparator alert above threshold", cenviro_adc_wait(1000, &raw) == 1 && raw == 1000);
+    _check("adc: monitored channel read while comparator is armed", cenviro_adc_read(0, &raw) && raw == 1000);
+    _check("adc: other channel rejected while comparator is armed", !cenviro_adc_read(1, &raw));
+    _check("adc: scan rejected while comparator is armed", !cenviro_adc_scan_start(0x03));
+
+    alert.mode = CENVIRO_ADC_ALERT_DISABLED;
+    _check("adc: comparator disabled", cenviro_adc_set_alert(&alert));
+    cenviro_sim_poke(0x49, 4, low_input, sizeof(low_input));
+    _check("adc: single-shot read after comparator", cenviro_adc_read(0, &raw) && raw == 125);
+}
+
+// snapshot in forced mode carries fresh conversion, not stale or reset data registers
+static void _check_snapshot_forced()
+{
+    double temperature = 0.0;
+    double pressure = 0.0;
+    _check("snapshot: forced mode selected", cenviro_weather_set_forced_mode(true));
+    cenviro_snapshot_t snapshot = cenviro_read_all(CENVIRO_SENSOR_ALL);
+    _check("snapshot: forced weather read", cenviro_weather_read(&temperature, &pressure));
+    _check("snapshot: weather valid in forced mode", (snapshot.valid & CENVIRO_SENSOR_WEATHER) &&
+                                                        fabs(snapshot.temperature - temperature) < 0.01 &&
+                                                        fabs(snapshot.pressure - pressure) < 0.01);
+    _check("snapshot: normal mode restored", cenviro_weather_set_forced_mode(false));
+}
+
+// snapshot does not report light counts of integration cycle interrupted by configuration change
+static void _check_snapshot_light()
+{
+    cenviro_light_config_t config = {.integration_us = 24000, .gain = CENVIRO_LIGHT_GAIN_4X, .auto_range = false};
+    _check("snapshot: light configured", cenviro_light_configure(&config));
+    cenviro_snapshot_t snapshot = cenviro_read_all(CENVIRO_SENSOR_LIGHT);
+    _check("snapshot: light invalid during first cycle", !(snapshot.valid & CENVIRO_SENSOR_LIGHT));
+    usleep(config.integration_us + SETTLE_TIME_US / 10);
+    snapshot = cenviro_read_all(CENVIRO_SENSOR_LIGHT);
+    _check("snapshot: light valid after first cycle", (snapshot.valid & CENVIRO_SENSOR_LIGHT) &&
+                                                        snapshot.light_integration_us == 24000 &&
+                                                        snapshot.light_gain == CENVIRO_LIGHT_GAIN_4X);
+    config.gain = CENVIRO_LIGHT_GAIN_1X;
+    cenviro_light_configure(&config);
+}
+
+// cenviro_init() brings up default modules only, module which fails leaves the rest of library initialized
+static void _check_modules()
+{
+    _check("modules: default modules ready after init", cenviro_modules_ready() == CENVIRO_MODULE_DEFAULT);
+
+    // light sensor (0x29) does not respond on board of new context
+    cenviro_sim_config_t sim = {.absent_address = 0x29};
+    cenviro_sim_configure(&sim);
+    cenviro_config_t config = {.bus = CENVIRO_BUS_SIMULATED, .modules = CENVIRO_MODULE_WEATHER | CENVIRO_MODULE_LIGHT};
+    cenviro_ctx_t *ctx = cenviro_open(&config);
+    sim.absent_address = 0;
+    cenviro_sim_configure(&sim);
+    _check("modules: context opened with failed module", ctx != NULL);
+    if (ctx == NULL)
+    {
+        return;
+    }
+
+    double temperature = 0.0;
+    double pressure = 0.0;
+    _check("modules: failed module unavailable", cenviro_ctx_modules_ready(ctx) == CENVIRO_MODULE_WEATHER);
+    _check("modules: remaining module works", cenviro_ctx_weather_read(ctx, &temperature, &pressure) && pressure > 0.0);
+    _check("modules: failed module not retried", cenviro_ctx_light_crgb_raw(ctx).clear == 0 &&
+                                                    !(cenviro_ctx_modules_ready(ctx) & CENVIRO_MODULE_LIGHT));
+    cenviro_close(ctx);
+}
+
+// context handle works on its own board without changing context of calling thread
+static void _check_contexts()
+{
+    cenviro_config_t config = {.bus = CENVIRO_BUS_SIMULATED, .modules = CENVIRO_MODULE_WEATHER};
+    cenviro_ctx_t *second = cenviro_open(&config);
+    _check("contexts: second context opened", second != NULL);
+    if (second == NULL)
+    {
+        return;
+    }
+
+    cenviro_stats_t before;
+    cenviro_stats_t after;
+    cenviro_stats_t stats;
+    double temperature = 0.0;
+    double pressure = 0.0;
+    cenviro_stats_get(&before);
+    _check("contexts: read through handle", cenviro_ctx_weather_read(second, &temperature, &pressure) && pressure > 0.0);
+    cenviro_stats_get(&after);
+    _check("contexts: default context bus not used by handle", after.transactions == before.transactions);
+    _check("contexts: handle bus used", cenviro_ctx_stats_get(second, &stats) && stats.transactions != 0);
+    _check("contexts: second context closed", cenviro_close(second));
+}
+
+int main()
+{
+    cenviro_set_bus(CENVIRO_BUS_SIMULATED, NULL);
+    if (!cenviro_init())
+    {
+        printf("Failed to initialize cenviro library\n");
+        return 1;
+    }
+
+    _check_modules();
+    _check_motion_wakeup();
+    _check_adc_comparator();
+    _check_snapshot_forced();
+    _check_snapshot_light();
+    _check_contexts();
+
+    cenviro_deinit();
+    printf("%d check(s) failed\n", _failures);
+    return _failures;
+}
@@ -6,8 +6,10 @@
 #include <cenviro.h>
 
 #define BLINK_TIME 500
+#define BLINK_COUNT 5
 #define READ_WEATHER_DELAY 1000
 #define READ_MOTION_DELAY 1000
+#define READ_ADC_DELAY 1000
 
 // config flags
 static bool _opt_all = false;
@@ -17,6 +19,7 @@ static bool _opt_pressure = false;
 static bool _opt_light = false;
 static bool _opt_motion = false;
 static bool _opt_m_temp = false;
+static bool _opt_adc = false;
 
 static bool _parse_options(int argc, char *argv[]);
 
@@ -41,13 +44,27 @@ int main(int argc, char *argv[])
     {
         printf("Blink LEDs\n");
 
-        for (int i = 0; i < 5; ++i)
+        // blinks are played by library thread
+        cenviro_led_pattern_t blink = {
+            .steps = {{true, BLINK_TIME * 1000}, {false, BLINK_TIME * 1000}}, .count = 2, .repeat = BLINK_COUNT};
+        if (cenviro_led_play(&blink))
+        {
+            printf("- blink x%d -\n", BLINK_COUNT);
+            while (cenviro_led_playing())
+            {
+                usleep(BLINK_TIME * 1000);
+            }
+        }
+        else
         {
-            cenviro_led_set(true);
-            printf("- blink -\n");
-            usleep(BLINK_TIME * 1000);
-            cenviro_led_set(false);
-            usleep(BLINK_TIME * 1000);
+            for (int i = 0; i < BLINK_COUNT; ++i)
+            {
+                cenviro_led_set(true);
+                printf("- blink -\n");
+                usleep(BLINK_TIME * 1000);
+                cenviro_led_set(false);
+                usleep(BLINK_TIME * 1000);
+            }
         }
     }
 
@@ -134,11 +151,32 @@ int main(int argc, char *argv[])
         for (int i = 0; i < 5; ++i)
         {
             double temp = cenviro_motion_temperature();
+            cenviro_vector_t accel = cenviro_motion_acceleration();
+            cenviro_vector_t mag = cenviro_motion_magnetic();
+            double heading = cenviro_motion_heading(NULL);
             printf("- current temp is: %.1f [*C]\n", temp);
+            printf("  acceleration: %.3f %.3f %.3f [g], magnetic field: %.3f %.3f %.3f [gauss]\n",
+                   accel.x, accel.y, accel.z, mag.x, mag.y, mag.z);
+            printf("  heading (uncalibrated): %.1f [deg]\n", heading);
             usleep(READ_WEATHER_DELAY * 1000);
         }
     }
 
+    if (_opt_all || _opt_adc)
+    {
+        printf("Read analog inputs\n");
+        for (int i = 0; i < 5; ++i)
+        {
+            printf("-");
+            for (uint8_t channel = 0; channel < CENVIRO_ADC_CHANNELS; ++channel)
+            {
+                printf(" AIN%u: %.3f [V]", channel, cenviro_adc_voltage(channel));
+            }
+            printf("\n");
+            usleep(READ_ADC_DELAY * 1000);
+        }
+    }
+
     cenviro_deinit();
     return 0;
 }
@@ -156,6 +194,7 @@ void _print_help(const char *name)
     printf("-i\tlaunch light _i_ntensity reader\n");
     printf("-m\tlaunch _m_otion sensor reader\n");
     printf("-e\tlaunch t_e_mperature reader using motion sensor chip\n");
+    printf("-c\tlaunch analog to digital _c_onverter reader\n");
 }
 
 bool _parse_options(int argc, char *argv[])
@@ -214,6 +253,11 @@ bool _parse_options(int argc, char *argv[])
             _opt_m_temp = true;
             continue;
         }
+        if (strncmp(argv[i], "-c", 2) == 0)
+        {
+            _opt_adc = true;
+            continue;
+        }
     }
     return true;
 }
@@ -1,6 +1,5 @@
 #include <stdio.h>
 #include <unistd.h>
-#include <pthread.h>
 
 #include <cenviro.h>
 
@@ -10,55 +9,43 @@
 // message to be printed (in the same line - thus carriage return)
 static const char *_meteo_message = "\rTemperature:%4.1fC    Pressure:%6.1fhPa";
 
-// global variables for storing meteo data (asynchronously updated)
-static double temperature = 0.0;
-static double pressure = 0.0;
-
-// meteo data update thread
-static void *_meteo_fetcher(void *params);
-
 int main(int argc, char *argv[])
 {
     // screan cleaning
     printf("\033[2J\033[1;1H");
 
     printf("Sample METEO app for CEnviroLib\n\n");
-    pthread_t updater = 0;
 
-    bool status = cenviro_init();
+    bool status = cenviro_init_modules(CENVIRO_MODULE_WEATHER);
+    if (status && !(cenviro_modules_ready() & CENVIRO_MODULE_WEATHER))
+    {
+        cenviro_deinit();
+        status = false;
+    }
     if (!status)
     {
         printf("ERROR: Failed to initialize weather library - exiting\n");
         return 1;
     }
 
-    int result = pthread_create(&updater, NULL, _meteo_fetcher, NULL);
-    if (result != 0)
+    // meteo data is updated asynchronously by library sampler thread
+    cenviro_sampler_config_t sampler = {.weather_period_ms = DATA_RELOAD_DELAY};
+    if (!cenviro_sampler_start(&sampler))
     {
-        printf("ERROR: Failed to launch updater thread - exiting...\n");
+        printf("ERROR: Failed to launch sampler - exiting...\n");
+        cenviro_deinit();
         return 1;
     }
 
     while (true)
     {
-        printf(_meteo_message, temperature, pressure);
+        cenviro_weather_sample_t sample = {0};
+        cenviro_sampler_weather(&sample);
+        printf(_meteo_message, sample.temperature, sample.pressure);
         fflush(stdout);
         usleep(PRINT_REFRESH_TIME * 1000);
     }
 
-    pthread_join(updater, NULL);
-
     cenviro_deinit();
     return 0;
 }
-
-static void *_meteo_fetcher(void *params)
-{
-    while (true)
-    {
-        temperature = cenviro_weather_temperature();
-        pressure = cenviro_weather_pressure();
-        usleep(DATA_RELOAD_DELAY * 1000);
-    }
-    return NULL;
-}
@@ -4,18 +4,15 @@
 #include <stdbool.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
 
 #include <cenviro.h>
 
-#define DOT_TIME 300
-#define DOT_PAUSE 300
-#define DASH_TIME 800
-#define DASH_PAUSE 800
-#define CHAR_PAUSE 800
-#define MESSAGE_PAUSE 1200
+// Morse code unit (dot length) in [ms]
+#define UNIT_TIME 300
+#define PLAY_CHECK_DELAY 100
 
-static void _show_dot();
-static void _show_dash();
+static void _play_blocking(const cenviro_led_pattern_t *pattern);
 static void _print_help(const char *name);
 
 static void _signal_handler(int signal)
@@ -55,58 +52,51 @@ int main(int argc, char *argv[])
     }
 
     signal(SIGINT, _signal_handler);
-    status = cenviro_init();
+    status = cenviro_init_modules(CENVIRO_MODULE_LED);
+    if (status && !(cenviro_modules_ready() & CENVIRO_MODULE_LED))
+    {
+        cenviro_deinit();
+        status = false;
+    }
     if (!status)
     {
         printf("Initialization error...\n");
         return 1;
     }
 
-    do
-    {
-        for (int i = 0; i < 3; ++i)
-        {
-            _show_dot();
-        }
-
-        usleep(CHAR_PAUSE * 1000);
-        for (int i = 0; i < 3; ++i)
-        {
-            _show_dash();
-        }
-        usleep(CHAR_PAUSE * 1000);
+    cenviro_led_pattern_t pattern;
+    cenviro_led_pattern_morse(&pattern, "SOS", UNIT_TIME);
+    pattern.repeat = infinite ? 0 : 1;
 
-        for (int i = 0; i < 3; ++i)
+    printf("... --- ...\n");
+    if (!cenviro_led_play(&pattern))
+    {
+        // pattern player not available (thread unsafe version) - play it in this thread
+        do
         {
-            _show_dot();
-        }
-        usleep(MESSAGE_PAUSE * 1000);
-
-        printf("\n");
-    } while (infinite);
+            _play_blocking(&pattern);
+        } while (infinite);
+    }
+    // library thread plays pattern - this one only waits for its end (or SIGINT)
+    while (cenviro_led_playing())
+    {
+        usleep(PLAY_CHECK_DELAY * 1000);
+    }
 
     cenviro_deinit();
     return 0;
 }
 
-static void _show_dot()
-{
-    printf(".");
-    fflush(stdout);
-    cenviro_led_set(true);
-    usleep(DOT_TIME * 1000);
-    cenviro_led_set(false);
-    usleep(DOT_PAUSE * 1000);
-}
-
-static void _show_dash()
+static void _play_blocking(const cenviro_led_pattern_t *pattern)
 {
-    printf("-");
-    fflush(stdout);
-    cenviro_led_set(true);
-    usleep(DASH_TIME * 1000);
+    for (size_t i = 0; i < pattern->count; ++i)
+    {
+        uint32_t duration_us = pattern->steps[i].duration_us;
+        struct timespec delay = {.tv_sec = duration_us / 1000000, .tv_nsec = (duration_us % 1000000) * 1000};
+        cenviro_led_set(pattern->steps[i].on);
+        nanosleep(&delay, NULL);
+    }
     cenviro_led_set(false);
-    usleep(DASH_PAUSE * 1000);
 }
 
 static void _print_help(const char *name)
@@ -2,22 +2,175 @@
 #define _CENVIRO_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 bool cenviro_init();
 
+// library modules (sensor modules use the same bits as CENVIRO_SENSOR_* masks)
+#define CENVIRO_MODULE_WEATHER 0x01
+#define CENVIRO_MODULE_LIGHT 0x02
+#define CENVIRO_MODULE_MOTION 0x04
+#define CENVIRO_MODULE_LED 0x08
+#define CENVIRO_MODULE_ADC 0x10
+#define CENVIRO_MODULE_ALL (CENVIRO_MODULE_WEATHER | CENVIRO_MODULE_LIGHT | CENVIRO_MODULE_MOTION | CENVIRO_MODULE_LED | CENVIRO_MODULE_ADC)
+// modules initialized by cenviro_init()
+#define CENVIRO_MODULE_DEFAULT (CENVIRO_MODULE_WEATHER | CENVIRO_MODULE_LIGHT | CENVIRO_MODULE_MOTION | CENVIRO_MODULE_LED)
+
+// initialize only selected modules (in parallel), remaining ones are initialized on their first use
+// fails only if library itself cannot be initialized - modules which failed stay unavailable (not retried until
+// library is initialized again), cenviro_modules_ready() tells which ones are up
+bool cenviro_init_modules(unsigned module_mask);
+
+// mask of initialized modules
+unsigned cenviro_modules_ready();
+
 void cenviro_deinit();
 
+// sensor interrupt outputs
+typedef enum
+{
+    CENVIRO_IRQ_LIGHT = 0, // TCS3472 INT
+    CENVIRO_IRQ_MOTION1,   // LSM303D INT1
+    CENVIRO_IRQ_MOTION2,   // LSM303D INT2
+    CENVIRO_IRQ_ADC,       // ADS1015 ALERT/RDY
+    CENVIRO_IRQ_COUNT
+} cenviro_irq_line_t;
+
 // led module
 void cenviro_led_set(bool state);
 
+// LED patterns - sequences of steps played by library thread with absolute deadlines
+#define CENVIRO_LED_PATTERN_STEPS 128
+#define CENVIRO_LED_STEP_MIN_US 100
+
+typedef struct
+{
+    bool on;
+    uint32_t duration_us;
+} cenviro_led_step_t;
+
+typedef struct
+{
+    cenviro_led_step_t steps[CENVIRO_LED_PATTERN_STEPS];
+    size_t count;
+    uint32_t repeat; // 0 - until stopped or replaced
+} cenviro_led_pattern_t;
+
+// International Morse code (letters, digits and spaces), unit is dot length, message ends with word gap
+bool cenviro_led_pattern_morse(cenviro_led_pattern_t *pattern, const char *text, uint32_t unit_ms);
+
+// double pulse once per period (period_ms >= 400)
+bool cenviro_led_pattern_heartbeat(cenviro_led_pattern_t *pattern, uint32_t period_ms);
+
+// software PWM dimming - brightness in [%] of period (frequency_hz 1 - 1000)
+bool cenviro_led_pattern_pwm(cenviro_led_pattern_t *pattern, uint8_t brightness, uint32_t frequency_hz);
+
+// starts pattern or replaces currently played one (does not block), LED is switched off when pattern ends
+bool cenviro_led_play(const cenviro_led_pattern_t *pattern);
+
+void cenviro_led_stop();
+
+bool cenviro_led_playing();
+
+// achieved timing of LED changes against scheduled deadlines
+typedef struct
+{
+    uint64_t changes;  // steps played
+    uint64_t missed;   // steps skipped because player was late by more than step duration
+    uint32_t mean_ns;  // lateness of LED change
+    uint32_t stddev_ns;
+    uint32_t max_ns;
+} cenviro_led_timing_t;
+
+cenviro_led_timing_t cenviro_led_timing(bool reset);
+
 // weather module
 double cenviro_weather_temperature();
 
 double cenviro_weather_pressure();
 
+// temperature [*C] and pressure [hPa] from single measurement (one bus transaction)
+bool cenviro_weather_read(double *temperature, double *pressure);
+
+// read 'count' samples every 'interval_ms', returns number of stored samples (timestamps_ns can be NULL)
+size_t cenviro_weather_read_batch(double *temperatures, double *pressures, uint64_t *timestamps_ns, size_t count,
+                                  uint32_t interval_ms);
+
 uint8_t cenviro_weather_chip_id();
 
+// weather measurement configuration (BMP280 osrs_t, osrs_p, filter and t_sb fields)
+typedef enum
+{
+    CENVIRO_OVERSAMPLING_SKIP = 0,
+    CENVIRO_OVERSAMPLING_X1,
+    CENVIRO_OVERSAMPLING_X2,
+    CENVIRO_OVERSAMPLING_X4,
+    CENVIRO_OVERSAMPLING_X8,
+    CENVIRO_OVERSAMPLING_X16
+} cenviro_oversampling_t;
+
+typedef enum
+{
+    CENVIRO_FILTER_OFF = 0,
+    CENVIRO_FILTER_2,
+    CENVIRO_FILTER_4,
+    CENVIRO_FILTER_8,
+    CENVIRO_FILTER_16
+} cenviro_filter_t;
+
+typedef enum
+{
+    CENVIRO_STANDBY_0_5MS = 0,
+    CENVIRO_STANDBY_62_5MS,
+    CENVIRO_STANDBY_125MS,
+    CENVIRO_STANDBY_250MS,
+    CENVIRO_STANDBY_500MS,
+    CENVIRO_STANDBY_1000MS,
+    CENVIRO_STANDBY_2000MS,
+    CENVIRO_STANDBY_4000MS
+} cenviro_standby_t;
+
+typedef struct
+{
+    cenviro_oversampling_t osrs_t;
+    cenviro_oversampling_t osrs_p;
+    cenviro_filter_t filter;
+    cenviro_standby_t standby;
+} cenviro_weather_config_t;
+
+typedef enum
+{
+    CENVIRO_WEATHER_ULTRA_LOW_POWER = 0,
+    CENVIRO_WEATHER_STANDARD,
+    CENVIRO_WEATHER_HIGH_RESOLUTION,
+    CENVIRO_WEATHER_ULTRA_HIGH_RESOLUTION,
+    CENVIRO_WEATHER_INDOOR_NAVIGATION
+} cenviro_weather_profile_t;
+
+typedef struct
+{
+    uint32_t measurement_us; // maximum measurement time
+    uint32_t period_us;      // time between consecutive measurements in normal mode
+    double output_rate_hz;
+} cenviro_weather_timing_t;
+
+bool cenviro_weather_set_profile(cenviro_weather_profile_t profile);
+
+bool cenviro_weather_configure(const cenviro_weather_config_t *config);
+
+cenviro_weather_config_t cenviro_weather_config();
+
+cenviro_weather_timing_t cenviro_weather_timing();
+
+// forced mode - single on-demand conversion (does not change selected mode), chip sleeps between reads
+// when forced mode is selected
+bool cenviro_weather_read_forced(double *temperature, double *pressure);
+
+bool cenviro_weather_set_forced_mode(bool forced);
+
+bool cenviro_weather_forced_mode();
+
 // light module
 typedef struct
 {
@@ -35,9 +188,611 @@ uint8_t cenviro_light_chip_id();
 
 const char *cenviro_light_chip_name();
 
+// light measurement configuration (TCS3472 integration time and gain)
+typedef enum
+{
+    CENVIRO_LIGHT_GAIN_1X = 0,
+    CENVIRO_LIGHT_GAIN_4X,
+    CENVIRO_LIGHT_GAIN_16X,
+    CENVIRO_LIGHT_GAIN_60X
+} cenviro_light_gain_t;
+
+typedef struct
+{
+    uint32_t integration_us;   // rounded to 2.4ms integration cycles (2400 - 614400)
+    cenviro_light_gain_t gain; // initial gain in auto-range mode
+    bool auto_range;           // adjust gain and integration time (not shorter than integration_us) to clear channel level
+} cenviro_light_config_t;
+
+bool cenviro_light_configure(const cenviro_light_config_t *config);
+
+// currently used values (changed by auto-range mode)
+cenviro_light_config_t cenviro_light_config();
+
+// time between consecutive data-ready moments [us] - reads repeated faster return counts of the same cycle
+uint32_t cenviro_light_cycle_us();
+
+// clear channel interrupt - raised when clear count stays out of [low, high] range for 'persistence'
+// consecutive integration cycles (0 - after every cycle, up to 60, rounded up to value supported by chip)
+bool cenviro_light_set_thresholds(uint16_t low, uint16_t high, uint8_t persistence);
+
+bool cenviro_light_clear_thresholds();
+
+// wait for light interrupt (timeout_ms < 0 - no timeout), returns 1 and counts which raised it, 0 on timeout, -1 on error
+int cenviro_light_wait_threshold(int timeout_ms, cenviro_crgb_t *crgb);
+
+// descriptor for own poll() loop (POLLIN | POLLPRI) - call cenviro_light_wait_threshold(0, ...) when it is ready
+int cenviro_light_interrupt_fd();
+
+// light in physical units - illuminance and correlated colour temperature computed from counts with TCS3472
+// DN40 formulas (IR removal, open-air coefficients) for integration time and gain used for measurement
+typedef struct
+{
+    float lux; // -1 when clear channel is saturated
+    float cct; // [K], 0 when there is no red light left after IR removal
+} cenviro_lux_t;
+
+cenviro_lux_t cenviro_light_lux();
+
+cenviro_lux_t cenviro_light_lux_compute(cenviro_crgb_t crgb, uint32_t integration_us, cenviro_light_gain_t gain);
+
+// batch conversion of samples measured with the same integration time and gain - channels are passed
+// in separate arrays (struct-of-arrays), so conversion loop is vectorized by compiler
+bool cenviro_light_lux_batch(const uint16_t *clear, const uint16_t *red, const uint16_t *green, const uint16_t *blue,
+                             size_t count, uint32_t integration_us, cenviro_light_gain_t gain, float *lux, float *cct);
+
+// fixed-point variant for cores without FPU/SIMD - lux in 1/256 units (-256 when saturated), cct in [K]
+bool cenviro_light_lux_batch_fixed(const uint16_t *clear, const uint16_t *red, const uint16_t *green, const uint16_t *blue,
+                                   size_t count, uint32_t integration_us, cenviro_light_gain_t gain, int32_t *lux_q8, int32_t *cct);
+
+// batch conversion of cenviro_crgb_t array (split into channel arrays in blocks)
+bool cenviro_light_lux_batch_crgb(const cenviro_crgb_t *samples, size_t count, uint32_t integration_us,
+                                  cenviro_light_gain_t gain, float *lux, float *cct);
+
 // motion module
 double cenviro_motion_temperature();
 
 uint8_t cenviro_motion_chip_id();
 
+typedef struct
+{
+    double x;
+    double y;
+    double z;
+} cenviro_vector_t;
+
+// acceleration [g] and magnetic field [gauss] (LSM303D)
+cenviro_vector_t cenviro_motion_acceleration();
+
+cenviro_vector_t cenviro_motion_magnetic();
+
+// accelerometer and magnetometer configuration
+typedef enum
+{
+    CENVIRO_ACCEL_RANGE_2G = 0,
+    CENVIRO_ACCEL_RANGE_4G,
+    CENVIRO_ACCEL_RANGE_6G,
+    CENVIRO_ACCEL_RANGE_8G,
+    CENVIRO_ACCEL_RANGE_16G
+} cenviro_accel_range_t;
+
+typedef enum
+{
+    CENVIRO_MAG_RANGE_2GAUSS = 0,
+    CENVIRO_MAG_RANGE_4GAUSS,
+    CENVIRO_MAG_RANGE_8GAUSS,
+    CENVIRO_MAG_RANGE_12GAUSS
+} cenviro_mag_range_t;
+
+typedef struct
+{
+    uint32_t accel_rate_hz; // rounded up to supported data rate (3, 6, 12, 25, 50, 100, 200, 400, 800, 1600)
+    cenviro_accel_range_t accel_range;
+    cenviro_mag_range_t mag_range;
+} cenviro_motion_config_t;
+
+bool cenviro_motion_configure(const cenviro_motion_config_t *config);
+
+cenviro_motion_config_t cenviro_motion_config();
+
+// [g] per raw accelerometer count for current range
+double cenviro_motion_accel_scale();
+
+// accelerometer streaming through 32-sample hardware FIFO - samples are moved to application ring buffer
+// by cenviro_motion_stream_drain() with single burst read when FIFO level reaches watermark
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} cenviro_accel_raw_t;
+
+typedef struct
+{
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC time of FIFO level check - last sample of batch was measured before it
+    uint64_t first;        // stream position of first sample
+    uint32_t count;
+    bool overrun; // samples were lost before this batch (FIFO full or no space in ring)
+} cenviro_motion_batch_t;
+
+typedef struct
+{
+    cenviro_accel_raw_t *samples; // 'capacity' slots, sample at stream position p is stored in samples[p % capacity]
+    size_t capacity;
+    cenviro_motion_batch_t *batches; // optional (NULL) 'batch_capacity' slots indexed the same way, oldest are overwritten
+    size_t batch_capacity;
+    uint64_t written;         // stream position after last written sample (updated by library)
+    uint64_t read;            // stream position after last consumed sample (updated by application)
+    uint64_t batches_written; // number of batches written (updated by library)
+    uint64_t dropped;         // samples which did not fit into ring (updated by library)
+} cenviro_motion_ring_t;
+
+// watermark 1-31 samples, data rate is taken from configuration
+bool cenviro_motion_stream_start(uint8_t watermark);
+
+bool cenviro_motion_stream_stop();
+
+// time in which FIFO fills up to watermark [us]
+uint32_t cenviro_motion_stream_period_us();
+
+// returns number of samples moved to ring (0 - watermark not reached yet), -1 on error
+int cenviro_motion_stream_drain(cenviro_motion_ring_t *ring);
+
+// motion interrupt sources routed to INT1 (CENVIRO_IRQ_MOTION1) and INT2 (CENVIRO_IRQ_MOTION2) outputs
+#define CENVIRO_MOTION_INT_ACCEL_READY 0x01
+#define CENVIRO_MOTION_INT_MAG_READY 0x02
+#define CENVIRO_MOTION_INT_FIFO_WATERMARK 0x04 // INT2 only
+#define CENVIRO_MOTION_INT_INERTIAL 0x08       // wake-up - acceleration change above threshold on any axis
+
+typedef struct
+{
+    unsigned int1_sources;
+    unsigned int2_sources;
+    double wakeup_threshold_g;   // inertial event threshold (gravity removed by high-pass filter), 1/128 of range steps
+    uint32_t wakeup_duration_ms; // minimal event duration (rounded to accelerometer samples)
+} cenviro_motion_irq_config_t;
+
+bool cenviro_motion_set_interrupts(const cenviro_motion_irq_config_t *config);
+
+bool cenviro_motion_clear_interrupts();
+
+// wait for interrupt on CENVIRO_IRQ_MOTION1 or CENVIRO_IRQ_MOTION2 line (timeout_ms < 0 - no timeout), returns 1 and
+// active sources of this line, 0 on timeout, -1 on error (data-ready sources stay active until data is read)
+int cenviro_motion_wait(cenviro_irq_line_t line, int timeout_ms, unsigned *sources);
+
+// descriptor for own poll() loop (POLLIN | POLLPRI) - call cenviro_motion_wait(line, 0, ...) when it is ready
+int cenviro_motion_interrupt_fd(cenviro_irq_line_t line);
+
+// magnetometer hard-iron (offset) and soft-iron (per-axis scale) correction: corrected = (raw - offset) * scale
+// limitation: soft-iron correction is axis aligned - distortion rotated against sensor axes (ex. ferrous parts placed
+// diagonally on PCB) is corrected only partially, its off-diagonal (axis coupling) terms are neither fitted nor applied
+typedef struct
+{
+    cenviro_vector_t offset; // [gauss]
+    cenviro_vector_t scale;
+} cenviro_mag_calibration_t;
+
+// incremental calibration estimator - axis aligned ellipsoid fitted to magnetometer samples, only running sums are kept
+// (constant time and memory per sample), older samples are weighted down by decay factor (1.0 - no forgetting)
+typedef struct
+{
+    double decay;
+    double weight;   // effective number of samples
+    double sums[27]; // normal equations (internal)
+} cenviro_mag_estimator_t;
+
+void cenviro_mag_estimator_init(cenviro_mag_estimator_t *estimator, double decay);
+
+void cenviro_mag_estimator_add(cenviro_mag_estimator_t *estimator, cenviro_vector_t magnetic);
+
+// returns false until samples cover enough orientations to fit ellipsoid
+bool cenviro_mag_estimator_solve(const cenviro_mag_estimator_t *estimator, cenviro_mag_calibration_t *calibration);
+
+// calibration used by heading functions (default - no correction)
+void cenviro_motion_set_calibration(const cenviro_mag_calibration_t *calibration);
+
+cenviro_mag_calibration_t cenviro_motion_calibration();
+
+bool cenviro_motion_calibration_save(const char *path);
+
+bool cenviro_motion_calibration_load(const char *path);
+
+// tilt-compensated heading of X axis in degrees clockwise from magnetic north [0, 360), -1 on error
+double cenviro_heading_compute(cenviro_vector_t acceleration, cenviro_vector_t magnetic, const cenviro_mag_calibration_t *calibration);
+
+// reads both sensors in single transaction, raw magnetic sample is added to estimator (if given)
+double cenviro_motion_heading(cenviro_mag_estimator_t *estimator);
+
+// vibration analysis of accelerometer stream - each window of samples gives time domain features (mean removed)
+// and power in frequency bands (windowed real FFT)
+#define CENVIRO_VIBRATION_BANDS_MAX 8
+
+typedef enum
+{
+    CENVIRO_WINDOW_RECTANGULAR = 0,
+    CENVIRO_WINDOW_HANN,
+    CENVIRO_WINDOW_HAMMING
+} cenviro_window_t;
+
+typedef enum
+{
+    CENVIRO_AXIS_X = 0,
+    CENVIRO_AXIS_Y,
+    CENVIRO_AXIS_Z,
+    CENVIRO_AXIS_MAGNITUDE
+} cenviro_axis_t;
+
+typedef struct
+{
+    uint32_t window_size;    // samples per window (power of two, 16 - 8192)
+    uint32_t sample_rate_hz; // accelerometer data rate (0 - taken from motion configuration)
+    cenviro_window_t window;
+    cenviro_axis_t axis; // analysed signal when samples are taken from motion ring buffer
+    uint32_t band_count; // up to CENVIRO_VIBRATION_BANDS_MAX, band i covers [band_edges_hz[i], band_edges_hz[i + 1])
+    float band_edges_hz[CENVIRO_VIBRATION_BANDS_MAX + 1];
+} cenviro_vibration_config_t;
+
+typedef struct
+{
+    uint64_t first;    // stream position of first sample (ring buffer input)
+    float rms;         // [g]
+    float peak;        // [g]
+    float crest;       // peak / rms
+    float dominant_hz; // frequency of the strongest spectral line
+    float band_power[CENVIRO_VIBRATION_BANDS_MAX]; // mean square [g^2] (sum over all bands up to Nyquist equals rms^2)
+} cenviro_vibration_result_t;
+
+typedef struct cenviro_vibration cenviro_vibration_t;
+
+cenviro_vibration_t *cenviro_vibration_create(const cenviro_vibration_config_t *config);
+
+void cenviro_vibration_destroy(cenviro_vibration_t *analyzer);
+
+// analysis of single window (window_size samples in [g])
+bool cenviro_vibration_analyze(cenviro_vibration_t *analyzer, const float *samples, cenviro_vibration_result_t *result);
+
+// consume samples from motion ring buffer (advances ring->read), returns number of results stored (windows completed)
+// or -1 on error - incomplete window is kept for the next call
+int cenviro_vibration_process(cenviro_vibration_t *analyzer, cenviro_motion_ring_t *ring, cenviro_vibration_result_t *results,
+                              size_t max_results);
+
+// adc module (ADS1015, single ended inputs AIN0 - AIN3)
+#define CENVIRO_ADC_CHANNELS 4
+
+// full scale input range
+typedef enum
+{
+    CENVIRO_ADC_RANGE_6144MV = 0,
+    CENVIRO_ADC_RANGE_4096MV,
+    CENVIRO_ADC_RANGE_2048MV,
+    CENVIRO_ADC_RANGE_1024MV,
+    CENVIRO_ADC_RANGE_512MV,
+    CENVIRO_ADC_RANGE_256MV
+} cenviro_adc_range_t;
+
+typedef struct
+{
+    uint32_t rate_sps; // rounded up to supported data rate (128, 250, 490, 920, 1600, 2400, 3300)
+    cenviro_adc_range_t range;
+} cenviro_adc_config_t;
+
+bool cenviro_adc_configure(const cenviro_adc_config_t *config);
+
+cenviro_adc_config_t cenviro_adc_config();
+
+// [V] per raw count for current range
+double cenviro_adc_scale();
+
+// single-shot conversion, raw value is 12-bit signed result
+bool cenviro_adc_read(uint8_t channel, int16_t *raw);
+
+double cenviro_adc_voltage(uint8_t channel);
+
+typedef struct
+{
+    uint64_t timestamp_ns;
+    uint8_t channel;
+    int16_t raw;
+} cenviro_adc_sample_t;
+
+// continuous scan of channels selected by mask (bit per channel) in round-robin order
+bool cenviro_adc_scan_start(uint8_t channel_mask);
+
+bool cenviro_adc_scan_stop();
+
+// blocks until count conversions are done (paced by data rate), returns number of stored samples or -1 on error
+int cenviro_adc_scan_read(cenviro_adc_sample_t *samples, size_t count);
+
+// ALERT/RDY output function
+typedef enum
+{
+    CENVIRO_ADC_ALERT_DISABLED = 0,
+    CENVIRO_ADC_ALERT_READY,       // pulse at the end of every conversion
+    CENVIRO_ADC_ALERT_TRADITIONAL, // asserted above high threshold, released below low threshold
+    CENVIRO_ADC_ALERT_WINDOW       // asserted outside of [low, high] window
+} cenviro_adc_alert_mode_t;
+
+typedef struct
+{
+    cenviro_adc_alert_mode_t mode;
+    double low_v;  // comparator thresholds [V]
+    double high_v;
+    uint8_t queue;   // conversions beyond threshold required to assert comparator (1, 2 or 4)
+    bool latching;   // comparator stays asserted until result is read
+    uint8_t channel; // input converted continuously while comparator is armed (scans are rejected, reads of
+                     // other inputs fail)
+} cenviro_adc_alert_config_t;
+
+bool cenviro_adc_set_alert(const cenviro_adc_alert_config_t *config);
+
+// waits for ALERT/RDY and reads conversion result (comparator alerts are confirmed with result), returns 1 on alert,
+// 0 on timeout (negative - no timeout) and -1 on error
+int cenviro_adc_wait(int timeout_ms, int16_t *raw);
+
+// descriptor for own poll() loop (POLLIN | POLLPRI) - call cenviro_adc_wait(0, ...) when it is ready
+int cenviro_adc_interrupt_fd();
+
+// all sensors snapshot (single bus transaction, consistent timestamp) - in weather forced mode temperature and
+// pressure come from forced conversion done just before the transaction
+#define CENVIRO_SENSOR_WEATHER 0x01
+#define CENVIRO_SENSOR_LIGHT 0x02
+#define CENVIRO_SENSOR_MOTION 0x04
+#define CENVIRO_SENSOR_ALL (CENVIRO_SENSOR_WEATHER | CENVIRO_SENSOR_LIGHT | CENVIRO_SENSOR_MOTION)
+
+typedef struct
+{
+    unsigned valid;        // mask of sensors successfully read (light - only when integration cycle is complete)
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC
+    double temperature;
+    double pressure;
+    cenviro_crgb_t crgb;
+    uint32_t light_integration_us; // integration time and gain of crgb counts
+    cenviro_light_gain_t light_gain;
+    double motion_temperature;
+    cenviro_vector_t acceleration; // not read while accelerometer is streaming
+    cenviro_vector_t magnetic;
+} cenviro_snapshot_t;
+
+cenviro_snapshot_t cenviro_read_all(unsigned sensor_mask);
+
+// background sampler (latest values are read without touching the bus)
+typedef struct
+{
+    uint32_t weather_period_ms; // 0 - sensor not sampled
+    uint32_t light_period_ms;
+    uint32_t motion_period_ms;
+} cenviro_sampler_config_t;
+
+typedef struct
+{
+    double temperature;
+    double pressure;
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC
+} cenviro_weather_sample_t;
+
+typedef struct
+{
+    cenviro_crgb_t crgb;
+    uint64_t timestamp_ns;
+} cenviro_light_sample_t;
+
+typedef struct
+{
+    double temperature;
+    uint64_t timestamp_ns;
+} cenviro_motion_sample_t;
+
+bool cenviro_sampler_start(const cenviro_sampler_config_t *config);
+
+void cenviro_sampler_stop();
+
+bool cenviro_sampler_weather(cenviro_weather_sample_t *sample);
+
+bool cenviro_sampler_light(cenviro_light_sample_t *sample);
+
+bool cenviro_sampler_motion(cenviro_motion_sample_t *sample);
+
+// library diagnostics - records (format and binary arguments) are written to per-thread lock-free rings and
+// formatted by background thread started by cenviro_init(), so logging does not block calling thread
+typedef enum
+{
+    CENVIRO_LOG_NONE = 0,
+    CENVIRO_LOG_ERROR, // default level (CENVIRO_LOG_DEBUG in debug build)
+    CENVIRO_LOG_WARNING,
+    CENVIRO_LOG_INFO,
+    CENVIRO_LOG_DEBUG
+} cenviro_log_level_t;
+
+// messages of given level and more severe ones are recorded
+void cenviro_log_set_level(cenviro_log_level_t level);
+
+cenviro_log_level_t cenviro_log_level();
+
+// sink called from draining thread with formatted message (without new line)
+typedef void (*cenviro_log_sink_t)(cenviro_log_level_t level, uint64_t timestamp_ns, const char *message,
+                                   void *context);
+
+// NULL - default sink (standard error output)
+void cenviro_log_set_sink(cenviro_log_sink_t sink, void *context);
+
+// printf-like message - format has to outlive the record (ex. string literal, only pointer is stored), %s
+// arguments are copied (47 bytes in total), at most 8 arguments
+void cenviro_log(cenviro_log_level_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// passes all recorded messages to sink in calling thread
+void cenviro_log_flush();
+
+// bus statistics (always collected, latency histograms have log2 buckets - bucket i counts [2^i, 2^(i+1)) ns)
+#define CENVIRO_STATS_BUCKETS 32
+
+typedef enum
+{
+    CENVIRO_STATS_WEATHER = 0,
+    CENVIRO_STATS_LIGHT,
+    CENVIRO_STATS_MOTION,
+    CENVIRO_STATS_ADC,
+    CENVIRO_STATS_DEVICES
+} cenviro_stats_device_t;
+
+typedef struct
+{
+    uint64_t transactions;   // bus transactions addressing device
+    uint64_t bytes;          // bytes written and read (register addresses included)
+    uint64_t errors;         // failed transactions
+    uint64_t retries;        // repeated status polls (conversion not finished yet)
+    uint64_t ioctl_failures; // failures reported by bus driver (including slave selection)
+    int last_error;          // errno of last failed transaction (0 - none)
+} cenviro_device_stats_t;
+
+typedef struct
+{
+    uint64_t transactions; // all transactions (single one can address a few devices)
+    uint64_t transfer_total_ns;
+    uint64_t lock_wait_total_ns;
+    uint64_t transfer_ns[CENVIRO_STATS_BUCKETS];  // time spent in bus driver
+    uint64_t lock_wait_ns[CENVIRO_STATS_BUCKETS]; // time spent waiting for bus lock
+    cenviro_device_stats_t devices[CENVIRO_STATS_DEVICES];
+} cenviro_stats_t;
+
+bool cenviro_stats_get(cenviro_stats_t *stats);
+
+void cenviro_stats_reset();
+
+// upper bound [ns] of histogram bucket holding given fraction (ex. 0.99) of samples, 0 - empty histogram
+uint64_t cenviro_stats_percentile(const uint64_t *histogram, double fraction);
+
+// bus backend selection (has to be called before cenviro_init(), path is copied - at most 63 characters)
+typedef enum
+{
+    CENVIRO_BUS_I2C_DEV = 0, // kernel i2c-dev interface (default, path "/dev/i2c-1")
+    CENVIRO_BUS_SIMULATED    // in-process simulated Enviro pHat
+} cenviro_bus_type_t;
+
+bool cenviro_set_bus(cenviro_bus_type_t type, const char *path);
+
+// GPIO pins connected to sensor interrupt outputs (has to be called before cenviro_init(), -1 - not connected)
+// when line is not connected latched interrupt status is polled over the bus
+bool cenviro_set_irq_gpio(cenviro_irq_line_t line, int gpio);
+
+// pollable descriptor owned by application used as interrupt line instead of GPIO pin (ex. GPIO character
+// device line request, eventfd), has to be called before cenviro_init(), -1 - not used
+bool cenviro_set_irq_fd(cenviro_irq_line_t line, int fd);
+
+// LED line - GPIO character device and line offset (has to be called before cenviro_init(), NULL - "/dev/gpiochip0",
+// sysfs interface is used when line cannot be requested from character device)
+bool cenviro_set_led_gpio(const char *chip_path, int line);
+
+// output line request descriptor (GPIO_V2_GET_LINE_IOCTL) owned by application used instead of LED line, has to be
+// called before cenviro_init(), -1 - not used
+bool cenviro_set_led_fd(int fd);
+
+// calibration cache file - BMP280 trimming coefficients and detected chip ids kept between process launches
+// (has to be called before cenviro_init(), NULL disables cache)
+bool cenviro_set_calibration_cache(const char *path);
+
+// library contexts - every context owns its bus, sensor state and calibration, locks and background threads so
+// independent boards can be used in parallel; cenviro_ctx_*() functions work on given context, the rest of library
+// functions work on context selected by calling thread - threads which did not select any use default context
+// (configured with functions above)
+typedef struct cenviro_ctx cenviro_ctx_t;
+
+typedef struct
+{
+    cenviro_bus_type_t bus;
+    const char *bus_path;          // NULL - default path of bus type
+    unsigned modules;              // modules initialized at once (0 - CENVIRO_MODULE_DEFAULT)
+    const char *calibration_cache; // NULL - no cache
+    const char *led_chip;          // NULL - "/dev/gpiochip0"
+    int led_line;                  // 0 - default LED line
+} cenviro_config_t;
+
+// create and initialize context (NULL config - default i2c bus with default modules), NULL on failure
+// strings are copied, interrupt lines are not connected (latched status is polled)
+cenviro_ctx_t *cenviro_open(const cenviro_config_t *config);
+
+// deinitialize context and release it (calling thread falls back to default context if it was using it), fails
+// while any other thread still has context selected - every thread has to call cenviro_use(NULL) first
+bool cenviro_close(cenviro_ctx_t *ctx);
+
+// select context for calling thread (NULL - default context), returns previously selected one
+cenviro_ctx_t *cenviro_use(cenviro_ctx_t *ctx);
+
+// functions working on given context (NULL - default context), the same as ones without ctx_ prefix, context
+// selection of calling thread is not changed (one thread can use many boards)
+bool cenviro_ctx_init(cenviro_ctx_t *ctx);
+
+bool cenviro_ctx_init_modules(cenviro_ctx_t *ctx, unsigned module_mask);
+
+unsigned cenviro_ctx_modules_ready(cenviro_ctx_t *ctx);
+
+void cenviro_ctx_deinit(cenviro_ctx_t *ctx);
+
+double cenviro_ctx_weather_temperature(cenviro_ctx_t *ctx);
+
+double cenviro_ctx_weather_pressure(cenviro_ctx_t *ctx);
+
+bool cenviro_ctx_weather_read(cenviro_ctx_t *ctx, double *temperature, double *pressure);
+
+bool cenviro_ctx_weather_read_forced(cenviro_ctx_t *ctx, double *temperature, double *pressure);
+
+cenviro_crgb_t cenviro_ctx_light_crgb_raw(cenviro_ctx_t *ctx);
+
+cenviro_crgb_t cenviro_ctx_light_crgb_scaled(cenviro_ctx_t *ctx);
+
+cenviro_lux_t cenviro_ctx_light_lux(cenviro_ctx_t *ctx);
+
+double cenviro_ctx_motion_temperature(cenviro_ctx_t *ctx);
+
+cenviro_vector_t cenviro_ctx_motion_acceleration(cenviro_ctx_t *ctx);
+
+cenviro_vector_t cenviro_ctx_motion_magnetic(cenviro_ctx_t *ctx);
+
+double cenviro_ctx_motion_heading(cenviro_ctx_t *ctx, cenviro_mag_estimator_t *estimator);
+
+bool cenviro_ctx_adc_read(cenviro_ctx_t *ctx, uint8_t channel, int16_t *raw);
+
+double cenviro_ctx_adc_voltage(cenviro_ctx_t *ctx, uint8_t channel);
+
+cenviro_snapshot_t cenviro_ctx_read_all(cenviro_ctx_t *ctx, unsigned sensor_mask);
+
+bool cenviro_ctx_stats_get(cenviro_ctx_t *ctx, cenviro_stats_t *stats);
+
+bool cenviro_ctx_sampler_start(cenviro_ctx_t *ctx, const cenviro_sampler_config_t *config);
+
+void cenviro_ctx_sampler_stop(cenviro_ctx_t *ctx);
+
+bool cenviro_ctx_sampler_weather(cenviro_ctx_t *ctx, cenviro_weather_sample_t *sample);
+
+bool cenviro_ctx_sampler_light(cenviro_ctx_t *ctx, cenviro_light_sample_t *sample);
+
+bool cenviro_ctx_sampler_motion(cenviro_ctx_t *ctx, cenviro_motion_sample_t *sample);
+
+void cenviro_ctx_led_set(cenviro_ctx_t *ctx, bool state);
+
+bool cenviro_ctx_led_play(cenviro_ctx_t *ctx, const cenviro_led_pattern_t *pattern);
+
+void cenviro_ctx_led_stop(cenviro_ctx_t *ctx);
+
+bool cenviro_ctx_led_playing(cenviro_ctx_t *ctx);
+
+// simulated board configuration
+typedef struct
+{
+    uint32_t transfer_latency_us;   // fixed time spent in every bus transaction
+    uint32_t clock_hz;              // bus clock used to compute per-byte time (0 - no per-byte time)
+    uint32_t conversion_latency_us; // BMP280 forced conversion time (0 - computed from oversampling)
+    uint32_t fault_period;          // every n-th transaction fails (0 - no faults)
+    uint8_t absent_address;         // address of device not responding (0 - all devices present)
+    bool legacy_reads;              // register read as address write, 5ms wait and separate read (pre I2C_RDWR path)
+} cenviro_sim_config_t;
+
+void cenviro_sim_configure(const cenviro_sim_config_t *config);
+
+// overwrite simulated device registers (ADS1015 uses 16-bit registers, pseudo registers 4-7 are AIN0-AIN3 inputs)
+bool cenviro_sim_poke(uint8_t address, uint8_t reg, const uint8_t *data, size_t length);
+
+uint64_t cenviro_sim_transfers();
+
+bool cenviro_sim_led();
+
 #endif // _CENVIRO_H_
@@ -0,0 +1,719 @@
+#include <time.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// ADS1015 - 12-bit ADC with 16-bit big endian registers selected by pointer register (kept between transfers).
+// Single-shot conversion is started by OS bit of config register, its completion is reported by the same bit
+// or by ALERT/RDY output (conversion-ready mode is selected by MSB of Hi_thresh set and MSB of Lo_thresh cleared).
+// Scan of one channel uses continuous mode - pointer is left at conversion register, so every result is
+// plain 2-byte read. Scan of more channels switches mux in single-shot mode: each step is one transaction
+// which reads previous result and starts conversion of next channel (only mux bits of config word change).
+// Comparator alerts need results, so while comparator is armed its channel is converted continuously.
+
+#define ADS_POINTER_CONVERSION 0x00
+#define ADS_POINTER_CONFIG 0x01
+#define ADS_POINTER_LO_THRESH 0x02
+#define ADS_POINTER_HI_THRESH 0x03
+
+#define ADS_CONFIG_OS 0x8000
+#define ADS_CONFIG_MUX_SINGLE 0x4000 // AIN(n) against GND - MUX = 4 + n
+#define ADS_CONFIG_MUX_SHIFT 12
+#define ADS_CONFIG_PGA_SHIFT 9
+#define ADS_CONFIG_MODE_SINGLE 0x0100
+#define ADS_CONFIG_DR_SHIFT 5
+#define ADS_CONFIG_COMP_WINDOW 0x0010
+#define ADS_CONFIG_COMP_LAT 0x0004
+#define ADS_CONFIG_COMP_DISABLE 0x0003
+
+// threshold registers values for conversion-ready mode and reset values
+#define ADS_READY_LO_THRESH 0x0000
+#define ADS_READY_HI_THRESH 0x8000
+#define ADS_DEFAULT_LO_THRESH 0x8000
+#define ADS_DEFAULT_HI_THRESH 0x7fff
+
+// conversion time margin (internal oscillator accuracy is +-10%) and power-up time [us]
+#define ADS_TIME_MARGIN_PCT 10
+#define ADS_WAKEUP_US 25
+// single-shot completion checks before giving up
+#define ADS_POLL_RETRIES 8
+// minimal period of ALERT/RDY emulation when pin is not connected [us]
+#define ADS_IRQ_POLL_MIN 250
+
+// supported data rates [SPS] (DR values 0-6) and full scale ranges [mV]
+static const uint32_t _ads_rates[7] = {128, 250, 490, 920, 1600, 2400, 3300};
+static const uint32_t _ads_ranges_mv[6] = {6144, 4096, 2048, 1024, 512, 256};
+
+static bool _initialize_ADS();
+static uint16_t _config_word(const cenviro_adc_config_t *config, uint8_t channel, bool single);
+static bool _write_config(uint16_t value);
+static uint16_t _idle_config(const cenviro_adc_config_t *config);
+static bool _comparator_armed();
+static bool _write_alert(const cenviro_adc_config_t *config);
+static uint16_t _threshold_word(double voltage, const cenviro_adc_config_t *config);
+static bool _alert_active(int16_t raw);
+static uint32_t _interrupt_poll_period();
+static bool _ready_signal();
+static uint64_t _conversion_ns(const cenviro_adc_config_t *config, bool single);
+static uint8_t _rate_code(uint32_t rate_sps);
+static int16_t _decode_result(const uint8_t *data);
+static void _sleep_until(uint64_t deadline);
+
+bool cenviro_adc_init()
+{
+    if (!_cenviro_ctx->initialized)
+    {
+        LOG("Library not initialized exiting\n");
+        return false;
+    }
+
+    if (!cenviro_bus_probe(ADC_ADDR))
+    {
+        LOG("Failed to set ADC address\n");
+        return false;
+    }
+
+    if (!_initialize_ADS())
+    {
+        LOG("Failed to initialize ADC module\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool cenviro_adc_ready()
+{
+    return cenviro_module_ready(CENVIRO_MODULE_ADC);
+}
+
+bool cenviro_adc_configure(const cenviro_adc_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (config == NULL || config->rate_sps == 0 || config->rate_sps > 3300 || config->range > CENVIRO_ADC_RANGE_256MV)
+    {
+        LOG("Invalid ADC configuration\n");
+        return false;
+    }
+
+    // before library init configuration is only stored for cenviro_adc_init(), afterwards cenviro_adc_ready()
+    // brings ADC up on first use and new configuration is written at once
+    bool ready = cenviro_adc_ready();
+    CENVIRO_LOCK(&adc->state_lock);
+    if (adc->scan_count != 0)
+    {
+        LOG("ADC configuration cannot be changed while scanning\n");
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    // armed comparator thresholds are counts of current range - they are written again together with new range
+    if (ready && !(_comparator_armed() ? _write_alert(config) : _write_config(_idle_config(config))))
+    {
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    adc->config = *config;
+    CENVIRO_UNLOCK(&adc->state_lock);
+    return true;
+}
+
+cenviro_adc_config_t cenviro_adc_config()
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    CENVIRO_LOCK(&adc->state_lock);
+    cenviro_adc_config_t config = adc->config;
+    CENVIRO_UNLOCK(&adc->state_lock);
+    config.rate_sps = _ads_rates[_rate_code(config.rate_sps)];
+    return config;
+}
+
+double cenviro_adc_scale()
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    CENVIRO_LOCK(&adc->state_lock);
+    uint32_t range_mv = _ads_ranges_mv[adc->config.range];
+    CENVIRO_UNLOCK(&adc->state_lock);
+    // 12-bit signed result - full scale is 2048 counts
+    return range_mv / 2048000.0;
+}
+
+bool cenviro_adc_read(uint8_t channel, int16_t *raw)
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (channel >= CENVIRO_ADC_CHANNELS || raw == NULL || !cenviro_adc_ready())
+    {
+        return false;
+    }
+
+    bool ready_signal = _ready_signal();
+    if (ready_signal)
+    {
+        // pulse of conversion nobody waited for
+        cenviro_irq_wait(CENVIRO_IRQ_ADC, 0);
+    }
+
+    // conversion is held under state lock - device converts one input at a time
+    CENVIRO_LOCK(&adc->state_lock);
+    if (adc->scan_count != 0)
+    {
+        LOG("ADC is scanning - use scan results\n");
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    if (_comparator_armed())
+    {
+        // monitored channel is converted continuously - its latest result is read, other inputs are not available
+        uint8_t latest[2];
+        bool status = channel == adc->alert.channel && cenviro_bus_read(ADC_ADDR, ADS_POINTER_CONVERSION, latest, 2);
+        CENVIRO_UNLOCK(&adc->state_lock);
+        if (!status)
+        {
+            LOG("ADC comparator is armed - only its channel can be read\n");
+            return false;
+        }
+        *raw = _decode_result(latest);
+        return true;
+    }
+    uint16_t config = _config_word(&adc->config, channel, true);
+    uint64_t conversion_ns = _conversion_ns(&adc->config, true);
+    if (!_write_config(config | ADS_CONFIG_OS))
+    {
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    if (!ready_signal)
+    {
+        _sleep_until(cenviro_monotonic_ns() + conversion_ns);
+    }
+
+    uint8_t config_reg = ADS_POINTER_CONFIG;
+    uint8_t conversion_reg = ADS_POINTER_CONVERSION;
+    uint8_t status[2];
+    uint8_t result[2];
+    cenviro_bus_msg_t messages[4] = {
+        {.address = ADC_ADDR, .read = false, .length = 1, .data = &config_reg},
+        {.address = ADC_ADDR, .read = true, .length = 2, .data = status},
+        {.address = ADC_ADDR, .read = false, .length = 1, .data = &conversion_reg},
+        {.address = ADC_ADDR, .read = true, .length = 2, .data = result}};
+    bool done = false;
+    if (ready_signal)
+    {
+        // result is read once, when conversion-ready pulse arrives
+        int timeout_ms = conversion_ns * ADS_POLL_RETRIES / 1000000 + 1;
+        done = cenviro_irq_wait(CENVIRO_IRQ_ADC, timeout_ms) > 0 && cenviro_bus_transfer(&messages[2], 2);
+    }
+    for (int retry = 0; retry < ADS_POLL_RETRIES && !done && !ready_signal; ++retry)
+    {
+        if (retry > 0)
+        {
+            cenviro_stats_retry(ADC_ADDR);
+            _sleep_until(cenviro_monotonic_ns() + conversion_ns / 4);
+        }
+        // status and result in single transaction - result is valid when OS bit reports finished conversion
+        if (!cenviro_bus_transfer(messages, 4))
+        {
+            LOG("Failed to read ADC conversion\n");
+            break;
+        }
+        done = (status[0] << 8) & ADS_CONFIG_OS;
+    }
+    CENVIRO_UNLOCK(&adc->state_lock);
+    if (!done)
+    {
+        LOG("ADC conversion not finished\n");
+        return false;
+    }
+    *raw = _decode_result(result);
+    return true;
+}
+
+double cenviro_adc_voltage(uint8_t channel)
+{
+    CENVIRO_PROBE_API();
+    int16_t raw = 0;
+    if (!cenviro_adc_read(channel, &raw))
+    {
+        return 0.0;
+    }
+    return raw * cenviro_adc_scale();
+}
+
+bool cenviro_adc_scan_start(uint8_t channel_mask)
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (channel_mask == 0 || channel_mask >= (1 << CENVIRO_ADC_CHANNELS))
+    {
+        LOG("Invalid ADC channel mask\n");
+        return false;
+    }
+    if (!cenviro_adc_ready())
+    {
+        return false;
+    }
+
+    CENVIRO_LOCK(&adc->state_lock);
+    if (_comparator_armed())
+    {
+        LOG("ADC cannot scan while comparator is armed\n");
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    uint8_t count = 0;
+    for (uint8_t channel = 0; channel < CENVIRO_ADC_CHANNELS; ++channel)
+    {
+        if (channel_mask & (1 << channel))
+        {
+            adc->scan_channels[count++] = channel;
+        }
+    }
+
+    bool status = false;
+    if (count == 1)
+    {
+        // continuous mode, pointer is left at conversion register for all following reads
+        uint16_t config = _config_word(&adc->config, adc->scan_channels[0], false);
+        uint8_t data[3] = {ADS_POINTER_CONFIG, config >> 8, config & 0xff};
+        uint8_t conversion_reg = ADS_POINTER_CONVERSION;
+        cenviro_bus_msg_t messages[2] = {
+            {.address = ADC_ADDR, .read = false, .length = 3, .data = data},
+            {.address = ADC_ADDR, .read = false, .length = 1, .data = &conversion_reg}};
+        status = cenviro_bus_transfer(messages, 2);
+    }
+    else
+    {
+        status = _write_config(_config_word(&adc->config, adc->scan_channels[0], true) | ADS_CONFIG_OS);
+    }
+    if (!status)
+    {
+        LOG("Failed to start ADC scan\n");
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    adc->scan_count = count;
+    adc->scan_position = 0;
+    adc->scan_deadline = cenviro_monotonic_ns() + _conversion_ns(&adc->config, count > 1);
+    CENVIRO_UNLOCK(&adc->state_lock);
+    return true;
+}
+
+bool cenviro_adc_scan_stop()
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (!cenviro_adc_ready())
+    {
+        return false;
+    }
+    CENVIRO_LOCK(&adc->state_lock);
+    // back to single-shot mode (device powers down after current conversion)
+    bool status = _write_config(_idle_config(&adc->config));
+    adc->scan_count = 0;
+    CENVIRO_UNLOCK(&adc->state_lock);
+    return status;
+}
+
+int cenviro_adc_scan_read(cenviro_adc_sample_t *samples, size_t count)
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (samples == NULL || !cenviro_adc_ready())
+    {
+        return -1;
+    }
+
+    // conversion-ready signal on connected pin replaces timing - results are read exactly when they are ready
+    bool ready_signal = _ready_signal();
+    CENVIRO_LOCK(&adc->state_lock);
+    int signal_timeout_ms = _conversion_ns(&adc->config, true) * ADS_POLL_RETRIES / 1000000 + 1;
+    CENVIRO_UNLOCK(&adc->state_lock);
+
+    size_t stored = 0;
+    while (stored < count)
+    {
+        CENVIRO_LOCK(&adc->state_lock);
+        uint64_t deadline = adc->scan_deadline;
+        bool scanning = adc->scan_count != 0;
+        CENVIRO_UNLOCK(&adc->state_lock);
+        if (!scanning)
+        {
+            LOG("ADC scan not started\n");
+            break;
+        }
+        if (!ready_signal)
+        {
+            _sleep_until(deadline);
+        }
+        else if (cenviro_irq_wait(CENVIRO_IRQ_ADC, signal_timeout_ms) <= 0)
+        {
+            LOG("ADC conversion ready signal missing\n");
+            return (stored > 0) ? (int)stored : -1;
+        }
+
+        CENVIRO_LOCK(&adc->state_lock);
+        if (adc->scan_count == 0)
+        {
+            CENVIRO_UNLOCK(&adc->state_lock);
+            break;
+        }
+        uint8_t channel = adc->scan_channels[adc->scan_position];
+        uint8_t next = (adc->scan_position + 1) % adc->scan_count;
+        uint16_t config = _config_word(&adc->config, adc->scan_channels[next], true) | ADS_CONFIG_OS;
+        uint8_t conversion_reg = ADS_POINTER_CONVERSION;
+        uint8_t start[3] = {ADS_POINTER_CONFIG, config >> 8, config & 0xff};
+        uint8_t result[2];
+        cenviro_bus_msg_t messages[3] = {
+            {.address = ADC_ADDR, .read = false, .length = 1, .data = &conversion_reg},
+            {.address = ADC_ADDR, .read = true, .length = 2, .data = result},
+            {.address = ADC_ADDR, .read = false, .length = 3, .data = start}};
+
+        uint64_t now = cenviro_monotonic_ns();
+        // continuous mode - result read only, otherwise result of current channel and start of next one
+        bool status = (adc->scan_count == 1) ? cenviro_bus_transfer(&messages[1], 1) : cenviro_bus_transfer(messages, 3);
+        if (!status)
+        {
+            LOG("Failed to read ADC scan result\n");
+            CENVIRO_UNLOCK(&adc->state_lock);
+            return (stored > 0) ? (int)stored : -1;
+        }
+        adc->scan_position = next;
+        // absolute deadlines - scan does not drift with read time, after missed period it restarts from now
+        uint64_t period_ns = _conversion_ns(&adc->config, adc->scan_count > 1);
+        adc->scan_deadline += period_ns;
+        if (adc->scan_deadline < now)
+        {
+            adc->scan_deadline = now + period_ns;
+        }
+        CENVIRO_UNLOCK(&adc->state_lock);
+
+        samples[stored].timestamp_ns = now;
+        samples[stored].channel = channel;
+        samples[stored].raw = _decode_result(result);
+        ++stored;
+    }
+    return (int)stored;
+}
+
+bool cenviro_adc_set_alert(const cenviro_adc_alert_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (config == NULL || config->mode > CENVIRO_ADC_ALERT_WINDOW)
+    {
+        LOG("Invalid ADC alert configuration\n");
+        return false;
+    }
+    bool comparator = config->mode == CENVIRO_ADC_ALERT_TRADITIONAL || config->mode == CENVIRO_ADC_ALERT_WINDOW;
+    if (comparator && ((config->queue != 1 && config->queue != 2 && config->queue != 4) || config->low_v > config->high_v ||
+                       config->channel >= CENVIRO_ADC_CHANNELS))
+    {
+        LOG("Invalid ADC comparator settings\n");
+        return false;
+    }
+    if (!cenviro_adc_ready())
+    {
+        return false;
+    }
+
+    CENVIRO_LOCK(&adc->state_lock);
+    if (adc->scan_count != 0)
+    {
+        LOG("ADC alert cannot be changed while scanning\n");
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    cenviro_adc_alert_config_t previous = adc->alert;
+    adc->alert = *config;
+    if (!_write_alert(&adc->config))
+    {
+        adc->alert = previous;
+        CENVIRO_UNLOCK(&adc->state_lock);
+        return false;
+    }
+    CENVIRO_UNLOCK(&adc->state_lock);
+    return true;
+}
+
+int cenviro_adc_wait(int timeout_ms, int16_t *raw)
+{
+    CENVIRO_PROBE_API();
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (!cenviro_adc_ready())
+    {
+        return -1;
+    }
+    CENVIRO_LOCK(&adc->state_lock);
+    cenviro_adc_alert_mode_t mode = adc->alert.mode;
+    CENVIRO_UNLOCK(&adc->state_lock);
+    if (mode == CENVIRO_ADC_ALERT_DISABLED || cenviro_adc_interrupt_fd() < 0)
+    {
+        LOG("ADC alert not enabled\n");
+        return -1;
+    }
+
+    uint8_t conversion_reg = ADS_POINTER_CONVERSION;
+    uint8_t result[2];
+    cenviro_bus_msg_t messages[2] = {
+        {.address = ADC_ADDR, .read = false, .length = 1, .data = &conversion_reg},
+        {.address = ADC_ADDR, .read = true, .length = 2, .data = result}};
+
+    uint64_t deadline = cenviro_monotonic_ns() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0) * 1000000;
+    // comparator output is a level (possibly latched before this call) so result is checked before first wait,
+    // conversion-ready pulse has no state to check
+    bool event = mode != CENVIRO_ADC_ALERT_READY;
+    while (true)
+    {
+        if (event)
+        {
+            if (!cenviro_bus_transfer(messages, 2))
+            {
+                LOG("Failed to read ADC conversion\n");
+                return -1;
+            }
+            int16_t value = _decode_result(result);
+            if (_alert_active(value))
+            {
+                if (raw != NULL)
+                {
+                    *raw = value;
+                }
+                return 1;
+            }
+        }
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0)
+        {
+            uint64_t now = cenviro_monotonic_ns();
+            wait_ms = (now < deadline) ? (int)((deadline - now + 999999) / 1000000) : 0;
+        }
+        int status = cenviro_irq_wait(CENVIRO_IRQ_ADC, wait_ms);
+        if (status < 0)
+        {
+            return -1;
+        }
+        if (status == 0 && timeout_ms >= 0 && cenviro_monotonic_ns() >= deadline)
+        {
+            return 0;
+        }
+        event = status > 0;
+    }
+}
+
+int cenviro_adc_interrupt_fd()
+{
+    CENVIRO_PROBE_API();
+    if (!cenviro_adc_ready())
+    {
+        return -1;
+    }
+    return cenviro_irq_fd(CENVIRO_IRQ_ADC, ADC_ADDR, _interrupt_poll_period());
+}
+
+static bool _initialize_ADS()
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    CENVIRO_LOCK(&adc->state_lock);
+    // scan and ALERT/RDY function have to be set again after library initialization
+    adc->scan_count = 0;
+    adc->alert = (cenviro_adc_alert_config_t){.mode = CENVIRO_ADC_ALERT_DISABLED};
+    uint16_t config = _config_word(&adc->config, 0, true);
+    bool status = _write_config(config);
+    CENVIRO_UNLOCK(&adc->state_lock);
+    if (!status)
+    {
+        LOG("Failed to write config\n");
+        return false;
+    }
+
+    // there is no chip id - written config is read back instead (OS bit reports conversion state)
+    uint8_t readback[2];
+    if (!cenviro_bus_read(ADC_ADDR, ADS_POINTER_CONFIG, readback, 2))
+    {
+        LOG("Failed to read ADC config\n");
+        return false;
+    }
+    if ((((readback[0] << 8) | readback[1]) & ~ADS_CONFIG_OS) != config)
+    {
+        LOG("Unexpected ADC config read from device\n");
+        return false;
+    }
+    return true;
+}
+
+// config register value for single ended input with current ALERT/RDY function (state lock has to be held)
+static uint16_t _config_word(const cenviro_adc_config_t *config, uint8_t channel, bool single)
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    uint16_t comparator = ADS_CONFIG_COMP_DISABLE;
+    if (adc->alert.mode == CENVIRO_ADC_ALERT_READY)
+    {
+        // assert after one conversion, not latched
+        comparator = 0;
+    }
+    else if (adc->alert.mode != CENVIRO_ADC_ALERT_DISABLED)
+    {
+        comparator = (adc->alert.queue == 4) ? 2 : adc->alert.queue - 1;
+        comparator |= (adc->alert.mode == CENVIRO_ADC_ALERT_WINDOW) ? ADS_CONFIG_COMP_WINDOW : 0;
+        comparator |= adc->alert.latching ? ADS_CONFIG_COMP_LAT : 0;
+    }
+    return ADS_CONFIG_MUX_SINGLE | (uint16_t)channel << ADS_CONFIG_MUX_SHIFT | (uint16_t)config->range << ADS_CONFIG_PGA_SHIFT |
+           (single ? ADS_CONFIG_MODE_SINGLE : 0) | (uint16_t)_rate_code(config->rate_sps) << ADS_CONFIG_DR_SHIFT | comparator;
+}
+
+// config register value while no read or scan is running - continuous conversion of channel watched by armed
+// comparator, otherwise single-shot mode (device powered down) - state lock has to be held
+static uint16_t _idle_config(const cenviro_adc_config_t *config)
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    if (_comparator_armed())
+    {
+        return _config_word(config, adc->alert.channel, false);
+    }
+    return _config_word(config, 0, true);
+}
+
+// state lock has to be held
+static bool _comparator_armed()
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    return adc->alert.mode == CENVIRO_ADC_ALERT_TRADITIONAL || adc->alert.mode == CENVIRO_ADC_ALERT_WINDOW;
+}
+
+// thresholds of current ALERT/RDY function (counts of given range) and config word in single transaction
+// (state lock has to be held)
+static bool _write_alert(const cenviro_adc_config_t *config)
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    uint16_t low = ADS_DEFAULT_LO_THRESH;
+    uint16_t high = ADS_DEFAULT_HI_THRESH;
+    if (adc->alert.mode == CENVIRO_ADC_ALERT_READY)
+    {
+        low = ADS_READY_LO_THRESH;
+        high = ADS_READY_HI_THRESH;
+    }
+    else if (_comparator_armed())
+    {
+        low = _threshold_word(adc->alert.low_v, config);
+        high = _threshold_word(adc->alert.high_v, config);
+    }
+    uint16_t control = _idle_config(config);
+
+    uint8_t low_data[3] = {ADS_POINTER_LO_THRESH, low >> 8, low & 0xff};
+    uint8_t high_data[3] = {ADS_POINTER_HI_THRESH, high >> 8, high & 0xff};
+    uint8_t config_data[3] = {ADS_POINTER_CONFIG, control >> 8, control & 0xff};
+    cenviro_bus_msg_t messages[3] = {
+        {.address = ADC_ADDR, .read = false, .length = 3, .data = low_data},
+        {.address = ADC_ADDR, .read = false, .length = 3, .data = high_data},
+        {.address = ADC_ADDR, .read = false, .length = 3, .data = config_data}};
+    if (!cenviro_bus_transfer(messages, 3))
+    {
+        LOG("Failed to write ADC alert configuration\n");
+        return false;
+    }
+    return true;
+}
+
+// comparator threshold in result register format (12-bit value left aligned)
+static uint16_t _threshold_word(double voltage, const cenviro_adc_config_t *config)
+{
+    double counts = voltage * 2048000.0 / _ads_ranges_mv[config->range];
+    int32_t raw = (int32_t)(counts + (counts < 0.0 ? -0.5 : 0.5));
+    raw = (raw < -2048) ? -2048 : ((raw > 2047) ? 2047 : raw);
+    return (uint16_t)(raw * 16);
+}
+
+// software check of comparator condition (alert is confirmed with result, also when pin is not connected)
+static bool _alert_active(int16_t raw)
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    CENVIRO_LOCK(&adc->state_lock);
+    cenviro_adc_alert_config_t alert = adc->alert;
+    cenviro_adc_config_t config = adc->config;
+    CENVIRO_UNLOCK(&adc->state_lock);
+
+    int16_t low = (int16_t)_threshold_word(alert.low_v, &config) / 16;
+    int16_t high = (int16_t)_threshold_word(alert.high_v, &config) / 16;
+    switch (alert.mode)
+    {
+    case CENVIRO_ADC_ALERT_READY:
+        return true;
+    case CENVIRO_ADC_ALERT_TRADITIONAL:
+        return raw > high;
+    case CENVIRO_ADC_ALERT_WINDOW:
+        return raw > high || raw < low;
+    default:
+        return false;
+    }
+}
+
+// ALERT/RDY cannot be asserted more often than once per conversion
+static uint32_t _interrupt_poll_period()
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    CENVIRO_LOCK(&adc->state_lock);
+    uint32_t period_us = _conversion_ns(&adc->config, false) / 1000;
+    CENVIRO_UNLOCK(&adc->state_lock);
+    return (period_us > ADS_IRQ_POLL_MIN) ? period_us : ADS_IRQ_POLL_MIN;
+}
+
+// conversion-ready mode with ALERT/RDY pin connected (state lock cannot be held)
+static bool _ready_signal()
+{
+    adc_state_t *adc = &_cenviro_ctx->adc;
+    CENVIRO_LOCK(&adc->state_lock);
+    bool ready = adc->alert.mode == CENVIRO_ADC_ALERT_READY;
+    CENVIRO_UNLOCK(&adc->state_lock);
+    return ready && cenviro_adc_interrupt_fd() >= 0 && !cenviro_irq_polled(CENVIRO_IRQ_ADC);
+}
+
+static bool _write_config(uint16_t value)
+{
+    uint8_t data[2] = {value >> 8, value & 0xff};
+    if (!cenviro_bus_write(ADC_ADDR, ADS_POINTER_CONFIG, data, 2))
+    {
+        LOG("Failed to write ADC config\n");
+        return false;
+    }
+    return true;
+}
+
+// single-shot conversion has to be finished when result is read, continuous mode is paced with nominal data rate
+static uint64_t _conversion_ns(const cenviro_adc_config_t *config, bool single)
+{
+    uint32_t rate = _ads_rates[_rate_code(config->rate_sps)];
+    if (!single)
+    {
+        return 1000000000ULL / rate;
+    }
+    return 1000000000ULL * (100 + ADS_TIME_MARGIN_PCT) / 100 / rate + ADS_WAKEUP_US * 1000;
+}
+
+// DR value of the lowest supported rate not lower than requested one
+static uint8_t _rate_code(uint32_t rate_sps)
+{
+    uint8_t code = 0;
+    while (code < 6 && _ads_rates[code] < rate_sps)
+    {
+        ++code;
+    }
+    return code;
+}
+
+// result is left aligned in 16-bit register (4 lowest bits are zero)
+static int16_t _decode_result(const uint8_t *data)
+{
+    return (int16_t)(data[0] << 8 | data[1]) / 16;
+}
+
+static void _sleep_until(uint64_t deadline)
+{
+    struct timespec until = {.tv_sec = deadline / 1000000000ULL, .tv_nsec = deadline % 1000000000ULL};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+}
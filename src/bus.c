@@ -0,0 +1,145 @@
+#include <string.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// maximum number of data bytes in single register write
+#define BUS_WRITE_MAX 31
+
+bool cenviro_set_bus(cenviro_bus_type_t type, const char *path)
+{
+    CENVIRO_PROBE_API();
+    cenviro_bus_t *bus = &_cenviro_ctx->bus;
+    if (_cenviro_ctx->initialized)
+    {
+        LOG("Bus cannot be changed while library is initialized\n");
+        return false;
+    }
+
+    const cenviro_bus_backend_t *backend;
+    switch (type)
+    {
+    case CENVIRO_BUS_I2C_DEV:
+        backend = &cenviro_bus_i2cdev;
+        path = (path != NULL) ? path : I2C_BUS_FILE;
+        break;
+    case CENVIRO_BUS_SIMULATED:
+        backend = &cenviro_bus_sim;
+        path = (path != NULL) ? path : "sim";
+        break;
+    default:
+        LOG("Unknown bus type\n");
+        return false;
+    }
+    if (strlen(path) >= BUS_PATH_MAX)
+    {
+        LOG("Bus path too long\n");
+        return false;
+    }
+    bus->backend = backend;
+    strcpy(bus->path, path);
+    return true;
+}
+
+bool cenviro_bus_open()
+{
+    cenviro_bus_t *bus = &_cenviro_ctx->bus;
+    bus->handle = bus->backend->open(bus->path);
+    if (bus->handle == NULL)
+    {
+        LOG("Failed to open bus\n");
+        return false;
+    }
+    return true;
+}
+
+void cenviro_bus_close()
+{
+    cenviro_bus_t *bus = &_cenviro_ctx->bus;
+    if (bus->handle == NULL)
+    {
+        return;
+    }
+    bus->backend->close(bus->handle);
+    bus->handle = NULL;
+}
+
+bool cenviro_bus_probe(uint8_t address)
+{
+    return _cenviro_ctx->bus.backend->select_slave(_cenviro_ctx->bus.handle, address);
+}
+
+bool cenviro_bus_simulated()
+{
+    return _cenviro_ctx->bus.backend == &cenviro_bus_sim;
+}
+
+bool cenviro_bus_transfer(cenviro_bus_msg_t *messages, size_t count)
+{
+    cenviro_bus_t *bus = &_cenviro_ctx->bus;
+#ifdef CENVIRO_PROBES
+    // register is the first byte of register write (or register address write before read)
+    uint8_t address = (count > 0) ? messages[0].address : 0;
+    int reg = (count > 0 && !messages[0].read && messages[0].length > 0) ? messages[0].data[0] : -1;
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        bytes += messages[i].length;
+    }
+#endif
+    CENVIRO_PROBE4(bus__transfer__start, address, reg, bytes, count);
+
+    // uncontended lock is taken without second clock read (lock probes fire only when caller has to wait)
+    uint64_t start = cenviro_monotonic_ns();
+    uint64_t locked = start;
+    if (!CENVIRO_TRYLOCK(&bus->lock))
+    {
+        CENVIRO_LOCK(&bus->lock);
+        locked = cenviro_monotonic_ns();
+    }
+    bool status = bus->backend->transfer(bus->handle, messages, count);
+    cenviro_stats_transfer(messages, count, status, locked - start, cenviro_monotonic_ns() - locked);
+    CENVIRO_UNLOCK(&bus->lock);
+
+    CENVIRO_PROBE4(bus__transfer__done, address, reg, bytes, status);
+    return status;
+}
+
+// register read is done as single combined transaction (write register address, repeated start, read data)
+// so no delay between command and data phase is needed
+bool cenviro_bus_read(uint8_t address, uint8_t reg, uint8_t *data, size_t length)
+{
+    cenviro_bus_msg_t messages[2] = {
+        {.address = address, .read = false, .length = 1, .data = &reg},
+        {.address = address, .read = true, .length = (uint16_t)length, .data = data}};
+
+    if (!cenviro_bus_transfer(messages, 2))
+    {
+        LOG("Failed to read register 0x%02x of device 0x%02x\n", reg, address);
+        return false;
+    }
+    return true;
+}
+
+bool cenviro_bus_write(uint8_t address, uint8_t reg, const uint8_t *data, size_t length)
+{
+    uint8_t buffer[BUS_WRITE_MAX + 1];
+    if (length > BUS_WRITE_MAX)
+    {
+        LOG("Register write too long (%zu bytes)\n", length);
+        return false;
+    }
+    buffer[0] = reg;
+    memcpy(&buffer[1], data, length);
+
+    cenviro_bus_msg_t message = {.address = address, .read = false, .length = (uint16_t)(length + 1), .data = buffer};
+
+    if (!cenviro_bus_transfer(&message, 1))
+    {
+        LOG("Failed to write register 0x%02x of device 0x%02x\n", reg, address);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// Calibration cache: chip ids and calibration data of detected devices are stored in a file, so next
+// process launch validates all of them with one combined transaction (chip id registers and first bytes of
+// calibration data, which tell apart units of the same chip) instead of walking every calibration PROM.
+
+#define CALCACHE_MAGIC 0x43454343 // "CECC"
+#define CALCACHE_VERSION 2
+
+static void _calcache_validate();
+static calcache_entry_t *_calcache_find(uint8_t address);
+
+bool cenviro_set_calibration_cache(const char *path)
+{
+    CENVIRO_PROBE_API();
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    if (_cenviro_ctx->initialized)
+    {
+        LOG("Calibration cache cannot be changed while library is initialized\n");
+        return false;
+    }
+    if (path != NULL && strlen(path) >= CALCACHE_FILE_PATH_MAX)
+    {
+        LOG("Calibration cache path too long\n");
+        return false;
+    }
+    strcpy(calcache->path, (path != NULL) ? path : "");
+    return true;
+}
+
+void cenviro_calcache_load()
+{
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    memset(&calcache->cache, 0, sizeof(calcache->cache));
+    calcache->cache.magic = CALCACHE_MAGIC;
+    calcache->cache.version = CALCACHE_VERSION;
+    strncpy(calcache->cache.bus_path, _cenviro_ctx->bus.path, CALCACHE_BUS_PATH_MAX - 1);
+    calcache->dirty = false;
+
+    if (calcache->path[0] == '\0')
+    {
+        return;
+    }
+    FILE *file = fopen(calcache->path, "rb");
+    if (file == NULL)
+    {
+        LOG_INFO("No calibration cache file\n");
+        calcache->dirty = true;
+        return;
+    }
+    calcache_file_t stored;
+    size_t length = fread(&stored, 1, sizeof(stored), file);
+    fclose(file);
+
+    if (length != sizeof(stored) || stored.magic != CALCACHE_MAGIC || stored.version != CALCACHE_VERSION ||
+        stored.count > CALCACHE_ENTRIES_MAX || strncmp(stored.bus_path, calcache->cache.bus_path, CALCACHE_BUS_PATH_MAX) != 0)
+    {
+        LOG_INFO("Calibration cache invalid or created for other bus\n");
+        calcache->dirty = true;
+        return;
+    }
+    calcache->cache = stored;
+    _calcache_validate();
+}
+
+bool cenviro_calcache_get(uint8_t address, uint8_t *chip_id, uint8_t *data, size_t length)
+{
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    CENVIRO_LOCK(&calcache->lock);
+    calcache_entry_t *entry = _calcache_find(address);
+    bool found = entry != NULL && entry->length == length;
+    if (found)
+    {
+        *chip_id = entry->chip_id;
+        if (length != 0)
+        {
+            memcpy(data, entry->data, length);
+        }
+    }
+    CENVIRO_UNLOCK(&calcache->lock);
+    return found;
+}
+
+void cenviro_calcache_put(uint8_t address, uint8_t id_reg, uint8_t chip_id, uint8_t data_reg, const uint8_t *data,
+                          size_t length)
+{
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    if (calcache->path[0] == '\0' || length > CALCACHE_DATA_MAX)
+    {
+        return;
+    }
+    CENVIRO_LOCK(&calcache->lock);
+    calcache_entry_t *entry = _calcache_find(address);
+    if (entry == NULL)
+    {
+        if (calcache->cache.count == CALCACHE_ENTRIES_MAX)
+        {
+            LOG("Calibration cache full\n");
+            CENVIRO_UNLOCK(&calcache->lock);
+            return;
+        }
+        entry = &calcache->cache.entries[calcache->cache.count++];
+    }
+    memset(entry, 0, sizeof(*entry));
+    entry->address = address;
+    entry->id_reg = id_reg;
+    entry->chip_id = chip_id;
+    entry->data_reg = data_reg;
+    entry->length = (uint8_t)length;
+    if (length != 0)
+    {
+        memcpy(entry->data, data, length);
+    }
+    calcache->dirty = true;
+    CENVIRO_UNLOCK(&calcache->lock);
+}
+
+void cenviro_calcache_save()
+{
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    CENVIRO_LOCK(&calcache->lock);
+    if (calcache->path[0] == '\0' || !calcache->dirty)
+    {
+        CENVIRO_UNLOCK(&calcache->lock);
+        return;
+    }
+    // write to temporary file and rename it, so concurrently starting process never sees partial file
+    char temporary[CALCACHE_FILE_PATH_MAX + 4];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", calcache->path);
+
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL)
+    {
+        LOG("Failed to create calibration cache file\n");
+        CENVIRO_UNLOCK(&calcache->lock);
+        return;
+    }
+    bool written = fwrite(&calcache->cache, 1, sizeof(calcache->cache), file) == sizeof(calcache->cache);
+    if (fclose(file) != 0 || !written || rename(temporary, calcache->path) != 0)
+    {
+        LOG("Failed to write calibration cache file\n");
+        remove(temporary);
+        CENVIRO_UNLOCK(&calcache->lock);
+        return;
+    }
+    calcache->dirty = false;
+    CENVIRO_UNLOCK(&calcache->lock);
+}
+
+// read chip id registers and data fingerprints of all cached devices in single transaction, entries of devices
+// which do not match are dropped (whole cache when transaction fails)
+static void _calcache_validate()
+{
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    cenviro_bus_msg_t messages[4 * CALCACHE_ENTRIES_MAX];
+    uint8_t chip_ids[CALCACHE_ENTRIES_MAX];
+    uint8_t fingerprints[CALCACHE_ENTRIES_MAX][CALCACHE_FINGERPRINT_LEN];
+    size_t count = 0;
+
+    if (calcache->cache.count == 0)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < calcache->cache.count; ++i)
+    {
+        calcache_entry_t *entry = &calcache->cache.entries[i];
+        size_t length = (entry->length < CALCACHE_FINGERPRINT_LEN) ? entry->length : CALCACHE_FINGERPRINT_LEN;
+        messages[count++] = (cenviro_bus_msg_t){.address = entry->address, .read = false, .length = 1, .data = &entry->id_reg};
+        messages[count++] = (cenviro_bus_msg_t){.address = entry->address, .read = true, .length = 1, .data = &chip_ids[i]};
+        if (length != 0)
+        {
+            messages[count++] = (cenviro_bus_msg_t){.address = entry->address, .read = false, .length = 1, .data = &entry->data_reg};
+            messages[count++] = (cenviro_bus_msg_t){.address = entry->address, .read = true, .length = length, .data = fingerprints[i]};
+        }
+    }
+    if (!cenviro_bus_transfer(messages, count))
+    {
+        LOG_INFO("Calibration cache does not match connected devices\n");
+        calcache->cache.count = 0;
+        calcache->dirty = true;
+        return;
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < calcache->cache.count; ++i)
+    {
+        calcache_entry_t *entry = &calcache->cache.entries[i];
+        size_t length = (entry->length < CALCACHE_FINGERPRINT_LEN) ? entry->length : CALCACHE_FINGERPRINT_LEN;
+        if (chip_ids[i] != entry->chip_id || memcmp(fingerprints[i], entry->data, length) != 0)
+        {
+            LOG_INFO("Calibration cache entry of device 0x%02x does not match connected unit\n", entry->address);
+            calcache->dirty = true;
+            continue;
+        }
+        calcache->cache.entries[kept++] = *entry;
+    }
+    calcache->cache.count = kept;
+}
+
+static calcache_entry_t *_calcache_find(uint8_t address)
+{
+    calcache_state_t *calcache = &_cenviro_ctx->calcache;
+    for (uint32_t i = 0; i < calcache->cache.count; ++i)
+    {
+        if (calcache->cache.entries[i].address == address)
+        {
+            return &calcache->cache.entries[i];
+        }
+    }
+    return NULL;
+}
@@ -1,95 +1,373 @@
-#include <linux/i2c-dev.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "cenviro.h"
-
+#include "context.h"
 #include "internal.h"
 #include "logs.h"
 
-int _cenviro_bus_fd = 0;
-bool _cenviro_initialized = false;
-uint8_t _cenviro_buffer[SHARED_BUFFER_LEN];
+// context used by threads which did not select any (library functions called without cenviro_open())
+cenviro_ctx_t _cenviro_default_ctx = CENVIRO_CTX_INITIALIZER;
+__thread cenviro_ctx_t *_cenviro_ctx = &_cenviro_default_ctx;
 
-#ifndef DISABLE_THREADSAFE
-#include <pthread.h>
-pthread_mutex_t _cenviro_lock = PTHREAD_MUTEX_INITIALIZER;
-#endif // DISABLE_THREADSAFE
+#define MODULES_COUNT 5
+
+typedef struct
+{
+    unsigned mask;
+    bool (*init)();
+} cenviro_module_t;
+
+static const cenviro_module_t _modules[MODULES_COUNT] = {
+    {CENVIRO_MODULE_WEATHER, cenviro_weather_init},
+    {CENVIRO_MODULE_LIGHT, cenviro_light_init},
+    {CENVIRO_MODULE_MOTION, cenviro_motion_init},
+    {CENVIRO_MODULE_LED, cenviro_led_init},
+    {CENVIRO_MODULE_ADC, cenviro_adc_init}};
+
+static unsigned _modules_start(unsigned modules);
+static void _ctx_locks(cenviro_ctx_t *ctx, bool destroy);
 
 bool cenviro_init()
 {
-    CENVIRO_LOCK_MUTEX();
-    int bus_file = 0;
-    bool status = false;
+    CENVIRO_PROBE_API();
+    return cenviro_init_modules(CENVIRO_MODULE_DEFAULT);
+}
 
-    status = cenviro_led_init();
-    if (!status)
+bool cenviro_init_modules(unsigned module_mask)
+{
+    CENVIRO_PROBE_API();
+    cenviro_ctx_t *ctx = _cenviro_ctx;
+    CENVIRO_LOCK(&ctx->lock);
+    if (ctx->initialized)
     {
-        LOG("Failed to init led module\n");
-        CENVIRO_UNLOCK_MUTEX();
+        LOG_ERROR("Library already initialized\n");
+        CENVIRO_UNLOCK(&ctx->lock);
         return false;
     }
+    cenviro_log_start();
 
-    bus_file = open(I2C_BUS_FILE, O_RDWR);
-    if (bus_file < 0)
+    if (!cenviro_bus_open())
     {
-        LOG("Failed to open i2c bus\n");
-        goto err_led;
+        LOG_ERROR("Failed to open i2c bus\n");
+        CENVIRO_UNLOCK(&ctx->lock);
+        cenviro_log_stop();
+        return false;
     }
 
-    _cenviro_bus_fd = bus_file;
-    _cenviro_initialized = true;
+    // known devices are validated at once, cached ones skip calibration reads
+    cenviro_calcache_load();
 
-    status = false;
-    status = cenviro_weather_init();
+    ctx->initialized = true;
 
-    if (!status)
+    module_mask &= CENVIRO_MODULE_ALL;
+    CENVIRO_LOCK(&ctx->modules_lock);
+    unsigned ready = _modules_start(module_mask);
+    // failed modules stay unavailable, the rest of library keeps working
+    ctx->modules_failed = module_mask & ~ready;
+    __atomic_store_n(&ctx->modules_ready, ready, __ATOMIC_RELEASE);
+    CENVIRO_UNLOCK(&ctx->modules_lock);
+
+    if (ready != module_mask)
     {
-        LOG("Failed to init weather module\n");
-        goto err_i2c;
+        LOG_ERROR("Failed to init requested modules (requested 0x%02x, ready 0x%02x)\n", module_mask, ready);
     }
 
-    status = cenviro_light_init();
-    if (!status)
+    cenviro_calcache_save();
+
+    CENVIRO_UNLOCK(&ctx->lock);
+    return true;
+}
+
+void cenviro_deinit()
+{
+    CENVIRO_PROBE_API();
+    cenviro_ctx_t *ctx = _cenviro_ctx;
+    // sampler and LED pattern threads use public API so they have to be stopped before taking the lock
+    cenviro_sampler_stop();
+    cenviro_led_stop();
+
+    CENVIRO_LOCK(&ctx->lock);
+    if (!ctx->initialized)
     {
-        LOG("Failed to init light module\n");
-        goto err_i2c;
+        CENVIRO_UNLOCK(&ctx->lock);
+        return;
     }
+    ctx->initialized = false;
+
+    CENVIRO_LOCK(&ctx->modules_lock);
+    __atomic_store_n(&ctx->modules_ready, 0, __ATOMIC_RELEASE);
+    CENVIRO_UNLOCK(&ctx->modules_lock);
+    cenviro_led_deinit();
+    cenviro_irq_close_all();
+
+    cenviro_bus_close();
+    CENVIRO_UNLOCK(&ctx->lock);
+    // messages recorded so far are passed to sink
+    cenviro_log_stop();
+}
 
-    status = cenviro_motion_init();
+bool cenviro_module_ready(unsigned module)
+{
+    cenviro_ctx_t *ctx = _cenviro_ctx;
+    if (__atomic_load_n(&ctx->modules_ready, __ATOMIC_ACQUIRE) & module)
+    {
+        return true;
+    }
+    if (!ctx->initialized)
+    {
+        return false;
+    }
+
+    // first use of module not selected in cenviro_init_modules()
+    CENVIRO_LOCK(&ctx->modules_lock);
+    bool status = (ctx->modules_ready & module) != 0;
+    if (!status && !(ctx->modules_failed & module))
+    {
+        for (size_t i = 0; i < MODULES_COUNT; ++i)
+        {
+            if (_modules[i].mask == module)
+            {
+                status = _modules[i].init();
+                break;
+            }
+        }
+        if (status)
+        {
+            __atomic_or_fetch(&ctx->modules_ready, module, __ATOMIC_RELEASE);
+            cenviro_calcache_save();
+        }
+        else
+        {
+            LOG_ERROR("Lazy module initialization failed (module 0x%02x)\n", module);
+            ctx->modules_failed |= module;
+        }
+    }
+    CENVIRO_UNLOCK(&ctx->modules_lock);
+    return status;
+}
+
+unsigned cenviro_modules_ready()
+{
+    CENVIRO_PROBE_API();
+    return __atomic_load_n(&_cenviro_ctx->modules_ready, __ATOMIC_ACQUIRE);
+}
+
+bool cenviro_module_active(unsigned module)
+{
+    return (__atomic_load_n(&_cenviro_ctx->modules_ready, __ATOMIC_ACQUIRE) & module) != 0;
+}
+
+cenviro_ctx_t *cenviro_open(const cenviro_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    static const cenviro_config_t defaults = {.bus = CENVIRO_BUS_I2C_DEV};
+    if (config == NULL)
+    {
+        config = &defaults;
+    }
+
+    void *memory = NULL;
+    // sampler slots are cache line aligned
+    if (posix_memalign(&memory, CACHE_LINE, sizeof(cenviro_ctx_t)) != 0)
+    {
+        LOG_ERROR("Failed to allocate library context\n");
+        return NULL;
+    }
+    cenviro_ctx_t *ctx = memory;
+    *ctx = (cenviro_ctx_t)CENVIRO_CTX_INITIALIZER;
+    _ctx_locks(ctx, false);
+    ctx->opened = true;
+
+    // context is configured and initialized with the same functions which configure default one
+    cenviro_ctx_t *previous = cenviro_ctx_select(ctx);
+    bool status = cenviro_set_bus(config->bus, config->bus_path) &&
+                  cenviro_set_calibration_cache(config->calibration_cache) &&
+                  cenviro_set_led_gpio(config->led_chip, (config->led_line != 0) ? config->led_line : LED_PIN) &&
+                  cenviro_init_modules((config->modules != 0) ? config->modules : CENVIRO_MODULE_DEFAULT);
+    cenviro_ctx_select(previous);
     if (!status)
     {
-        LOG("Failed to init motion module\n");
-        goto err_i2c;
+        LOG_ERROR("Failed to open library context\n");
+        _ctx_locks(ctx, true);
+        free(ctx);
+        return NULL;
     }
+    return ctx;
+}
 
-    CENVIRO_UNLOCK_MUTEX();
+bool cenviro_close(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    if (ctx == NULL)
+    {
+        return true;
+    }
+    cenviro_ctx_t *previous = cenviro_ctx_select(ctx);
+    // calling thread is the only user left - other threads still selecting context would use released memory
+    if (ctx->opened && __atomic_load_n(&ctx->users, __ATOMIC_ACQUIRE) > 1)
+    {
+        LOG_ERROR("Library context is still used by other thread\n");
+        cenviro_ctx_select(previous);
+        return false;
+    }
+    cenviro_deinit();
+    cenviro_ctx_select((previous != ctx) ? previous : NULL);
+    if (ctx->opened)
+    {
+        _ctx_locks(ctx, true);
+        free(ctx);
+    }
     return true;
+}
 
-err_i2c:
-    close(_cenviro_bus_fd);
-err_led:
-    cenviro_led_deinit();
-    _cenviro_initialized = false;
-    CENVIRO_UNLOCK_MUTEX();
-    return false;
+cenviro_ctx_t *cenviro_use(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    return cenviro_ctx_select(ctx);
 }
 
-void cenviro_deinit()
+cenviro_ctx_t *cenviro_ctx_select(cenviro_ctx_t *ctx)
 {
-    CENVIRO_LOCK_MUTEX();
-    if (!_cenviro_initialized)
+    cenviro_ctx_t *previous = _cenviro_ctx;
+    _cenviro_ctx = (ctx != NULL) ? ctx : &_cenviro_default_ctx;
+    if (_cenviro_ctx == previous)
     {
-        CENVIRO_UNLOCK_MUTEX();
-        return;
+        return previous;
     }
-    _cenviro_initialized = false;
-    cenviro_led_deinit();
+    if (_cenviro_ctx->opened)
+    {
+        __atomic_add_fetch(&_cenviro_ctx->users, 1, __ATOMIC_ACQ_REL);
+    }
+    if (previous->opened)
+    {
+        __atomic_sub_fetch(&previous->users, 1, __ATOMIC_ACQ_REL);
+    }
+    return previous;
+}
+
+uint64_t cenviro_monotonic_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#ifndef DISABLE_THREADSAFE
+
+typedef struct
+{
+    const cenviro_module_t *module;
+    cenviro_ctx_t *ctx;
+    bool status;
+} module_job_t;
 
-    if (_cenviro_bus_fd != 0)
+static void *_module_init_thread(void *params)
+{
+    module_job_t *job = params;
+    // module is initialized in context of thread calling cenviro_init()
+    _cenviro_ctx = job->ctx;
+    job->status = job->module->init();
+    return NULL;
+}
+
+// modules drive independent devices - bus lock serializes single transfers only, so waiting
+// parts of initialization (ex. GPIO export retries) overlap and startup takes as long as the slowest module
+static unsigned _modules_start(unsigned modules)
+{
+    pthread_t threads[MODULES_COUNT];
+    bool started[MODULES_COUNT] = {false};
+    module_job_t jobs[MODULES_COUNT];
+    const cenviro_module_t *inline_module = NULL;
+    unsigned ready = 0;
+
+    for (size_t i = 0; i < MODULES_COUNT; ++i)
+    {
+        jobs[i].module = &_modules[i];
+        jobs[i].ctx = _cenviro_ctx;
+        jobs[i].status = false;
+        if (!(modules & _modules[i].mask))
+        {
+            continue;
+        }
+        if (inline_module == NULL)
+        {
+            // first selected module is initialized by calling thread
+            inline_module = &_modules[i];
+            continue;
+        }
+        started[i] = pthread_create(&threads[i], NULL, _module_init_thread, &jobs[i]) == 0;
+        if (!started[i])
+        {
+            _module_init_thread(&jobs[i]);
+        }
+    }
+    if (inline_module != NULL)
     {
-        close(_cenviro_bus_fd);
-        _cenviro_bus_fd = 0;
+        _module_init_thread(&jobs[inline_module - _modules]);
     }
-    CENVIRO_UNLOCK_MUTEX();
+    for (size_t i = 0; i < MODULES_COUNT; ++i)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+        if (jobs[i].status)
+        {
+            ready |= _modules[i].mask;
+        }
+    }
+    return ready;
 }
+
+// locks of allocated context (static initializers are valid for statically allocated mutexes only)
+static void _ctx_locks(cenviro_ctx_t *ctx, bool destroy)
+{
+    pthread_mutex_t *locks[] = {&ctx->bus.lock,
+                                &ctx->lock,
+                                &ctx->modules_lock,
+                                &ctx->calcache.lock,
+                                &ctx->weather.state_lock,
+                                &ctx->weather.conversion_lock,
+                                &ctx->light.state_lock,
+                                &ctx->motion.state_lock,
+                                &ctx->compass.lock,
+                                &ctx->adc.state_lock,
+                                &ctx->irq.lock,
+                                &ctx->sampler.lock,
+                                &ctx->pattern.lock};
+    for (size_t i = 0; i < sizeof(locks) / sizeof(locks[0]); ++i)
+    {
+        if (destroy)
+        {
+            pthread_mutex_destroy(locks[i]);
+        }
+        else
+        {
+            pthread_mutex_init(locks[i], NULL);
+        }
+    }
+}
+
+#else
+
+static unsigned _modules_start(unsigned modules)
+{
+    unsigned ready = 0;
+    for (size_t i = 0; i < MODULES_COUNT; ++i)
+    {
+        if ((modules & _modules[i].mask) && _modules[i].init())
+        {
+            ready |= _modules[i].mask;
+        }
+    }
+    return ready;
+}
+
+static void _ctx_locks(cenviro_ctx_t *ctx, bool destroy)
+{
+    (void)ctx;
+    (void)destroy;
+}
+
+#endif // DISABLE_THREADSAFE
@@ -0,0 +1,340 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// Compass: tilt-compensated heading and magnetometer calibration.
+// Heading uses vector products only (no pitch/roll angles): with U - acceleration (points up at rest) and
+// M - corrected magnetic field, East = M x U and North = U x East, heading of X axis is atan2(East.x, North.x).
+// Calibration fits axis aligned ellipsoid A*x^2 + B*y^2 + C*z^2 + D*x + E*y + F*z = 1 by least squares -
+// estimator keeps normal equations (sums of products of 6 terms), so adding sample and solving take constant time.
+
+#define COMPASS_FILE_MAGIC 0x43454d43 // "CEMC"
+#define COMPASS_FILE_VERSION 1
+// ellipsoid terms - estimator stores 21 sums of upper triangle of normal matrix and 6 of right-hand side
+#define COMPASS_TERMS 6
+// minimal effective number of samples and relative pivot limit for fit
+#define COMPASS_SAMPLES_MIN 20
+#define COMPASS_PIVOT_MIN 1e-9
+
+#define RAD_TO_DEG (180.0 / M_PI)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    cenviro_mag_calibration_t calibration;
+} compass_file_t;
+
+static void _compass_terms(cenviro_vector_t magnetic, double *terms);
+static bool _compass_solve(double matrix[COMPASS_TERMS][COMPASS_TERMS + 1], double *solution);
+static bool _compass_calibration_valid(const cenviro_mag_calibration_t *calibration);
+
+void cenviro_mag_estimator_init(cenviro_mag_estimator_t *estimator, double decay)
+{
+    CENVIRO_PROBE_API();
+    if (estimator == NULL)
+    {
+        return;
+    }
+    memset(estimator, 0, sizeof(*estimator));
+    estimator->decay = (decay > 0.0 && decay <= 1.0) ? decay : 1.0;
+}
+
+void cenviro_mag_estimator_add(cenviro_mag_estimator_t *estimator, cenviro_vector_t magnetic)
+{
+    CENVIRO_PROBE_API();
+    double terms[COMPASS_TERMS];
+    const double decay = estimator->decay;
+
+    _compass_terms(magnetic, terms);
+    double *sum = estimator->sums;
+    for (int i = 0; i < COMPASS_TERMS; ++i)
+    {
+        for (int j = i; j < COMPASS_TERMS; ++j)
+        {
+            *sum = *sum * decay + terms[i] * terms[j];
+            ++sum;
+        }
+    }
+    // right-hand side (fitted value is 1)
+    for (int i = 0; i < COMPASS_TERMS; ++i)
+    {
+        *sum = *sum * decay + terms[i];
+        ++sum;
+    }
+    estimator->weight = estimator->weight * decay + 1.0;
+}
+
+bool cenviro_mag_estimator_solve(const cenviro_mag_estimator_t *estimator, cenviro_mag_calibration_t *calibration)
+{
+    CENVIRO_PROBE_API();
+    double matrix[COMPASS_TERMS][COMPASS_TERMS + 1];
+    double solution[COMPASS_TERMS];
+
+    if (estimator == NULL || calibration == NULL || estimator->weight < COMPASS_SAMPLES_MIN)
+    {
+        return false;
+    }
+    const double *sum = estimator->sums;
+    for (int i = 0; i < COMPASS_TERMS; ++i)
+    {
+        for (int j = i; j < COMPASS_TERMS; ++j)
+        {
+            matrix[i][j] = matrix[j][i] = *sum++;
+        }
+    }
+    for (int i = 0; i < COMPASS_TERMS; ++i)
+    {
+        matrix[i][COMPASS_TERMS] = *sum++;
+    }
+    if (!_compass_solve(matrix, solution))
+    {
+        LOG_DEBUG("Magnetometer samples do not cover enough orientations\n");
+        return false;
+    }
+
+    // A, B, C have to be positive for ellipsoid, centre is -D / 2A (and similar), radius^2 is G / A
+    const double *quadratic = solution;
+    const double *linear = solution + 3;
+    double centre[3];
+    double radius[3];
+    double g = 1.0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (quadratic[axis] <= 0.0)
+        {
+            LOG("Magnetometer samples do not fit ellipsoid\n");
+            return false;
+        }
+        centre[axis] = -linear[axis] / (2.0 * quadratic[axis]);
+        g += linear[axis] * linear[axis] / (4.0 * quadratic[axis]);
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        radius[axis] = sqrt(g / quadratic[axis]);
+    }
+    // axes are scaled to common (geometric mean) radius, so corrected field keeps its strength in [gauss]
+    double mean_radius = cbrt(radius[0] * radius[1] * radius[2]);
+
+    calibration->offset = (cenviro_vector_t){centre[0], centre[1], centre[2]};
+    calibration->scale =
+        (cenviro_vector_t){mean_radius / radius[0], mean_radius / radius[1], mean_radius / radius[2]};
+    return true;
+}
+
+void cenviro_motion_set_calibration(const cenviro_mag_calibration_t *calibration)
+{
+    CENVIRO_PROBE_API();
+    compass_state_t *compass = &_cenviro_ctx->compass;
+    static const cenviro_mag_calibration_t identity = {.offset = {0.0, 0.0, 0.0}, .scale = {1.0, 1.0, 1.0}};
+
+    CENVIRO_LOCK(&compass->lock);
+    compass->calibration = (calibration != NULL) ? *calibration : identity;
+    CENVIRO_UNLOCK(&compass->lock);
+}
+
+cenviro_mag_calibration_t cenviro_motion_calibration()
+{
+    CENVIRO_PROBE_API();
+    compass_state_t *compass = &_cenviro_ctx->compass;
+    CENVIRO_LOCK(&compass->lock);
+    cenviro_mag_calibration_t calibration = compass->calibration;
+    CENVIRO_UNLOCK(&compass->lock);
+    return calibration;
+}
+
+bool cenviro_motion_calibration_save(const char *path)
+{
+    CENVIRO_PROBE_API();
+    compass_file_t stored = {.magic = COMPASS_FILE_MAGIC, .version = COMPASS_FILE_VERSION};
+    char temporary[256];
+
+    if (path == NULL || snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary))
+    {
+        LOG("Invalid calibration file path\n");
+        return false;
+    }
+    stored.calibration = cenviro_motion_calibration();
+
+    // the same as calibration cache - temporary file is renamed, so reader never sees partial file
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL)
+    {
+        LOG("Failed to create magnetometer calibration file\n");
+        return false;
+    }
+    bool written = fwrite(&stored, 1, sizeof(stored), file) == sizeof(stored);
+    if (fclose(file) != 0 || !written || rename(temporary, path) != 0)
+    {
+        LOG("Failed to write magnetometer calibration file\n");
+        remove(temporary);
+        return false;
+    }
+    return true;
+}
+
+bool cenviro_motion_calibration_load(const char *path)
+{
+    CENVIRO_PROBE_API();
+    compass_file_t stored;
+
+    if (path == NULL)
+    {
+        return false;
+    }
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        LOG_INFO("No magnetometer calibration file\n");
+        return false;
+    }
+    size_t length = fread(&stored, 1, sizeof(stored), file);
+    fclose(file);
+
+    if (length != sizeof(stored) || stored.magic != COMPASS_FILE_MAGIC || stored.version != COMPASS_FILE_VERSION ||
+        !_compass_calibration_valid(&stored.calibration))
+    {
+        LOG("Invalid magnetometer calibration file\n");
+        return false;
+    }
+    cenviro_motion_set_calibration(&stored.calibration);
+    return true;
+}
+
+double cenviro_heading_compute(cenviro_vector_t acceleration, cenviro_vector_t magnetic, const cenviro_mag_calibration_t *calibration)
+{
+    CENVIRO_PROBE_API();
+    if (calibration != NULL)
+    {
+        magnetic.x = (magnetic.x - calibration->offset.x) * calibration->scale.x;
+        magnetic.y = (magnetic.y - calibration->offset.y) * calibration->scale.y;
+        magnetic.z = (magnetic.z - calibration->offset.z) * calibration->scale.z;
+    }
+    const cenviro_vector_t up = acceleration;
+    cenviro_vector_t east = {magnetic.y * up.z - magnetic.z * up.y, magnetic.z * up.x - magnetic.x * up.z,
+                             magnetic.x * up.y - magnetic.y * up.x};
+    // only X components of north are needed
+    double north_x = up.y * east.z - up.z * east.y;
+
+    if (east.x == 0.0 && north_x == 0.0)
+    {
+        // free fall or field parallel to gravity
+        return -1.0;
+    }
+    double heading = atan2(east.x, north_x) * RAD_TO_DEG;
+    return (heading < 0.0) ? heading + 360.0 : heading;
+}
+
+double cenviro_motion_heading(cenviro_mag_estimator_t *estimator)
+{
+    CENVIRO_PROBE_API();
+    uint8_t magnetic_reg = MOTION_BLOCK_REG;
+    uint8_t accel_reg = MOTION_ACCEL_BLOCK_REG;
+    uint8_t magnetic_block[MOTION_BLOCK_LEN];
+    uint8_t accel_block[MOTION_ACCEL_BLOCK_LEN];
+    cenviro_bus_msg_t messages[4] = {
+        {.address = MOTION_ADDR, .read = false, .length = 1, .data = &magnetic_reg},
+        {.address = MOTION_ADDR, .read = true, .length = MOTION_BLOCK_LEN, .data = magnetic_block},
+        {.address = MOTION_ADDR, .read = false, .length = 1, .data = &accel_reg},
+        {.address = MOTION_ADDR, .read = true, .length = MOTION_ACCEL_BLOCK_LEN, .data = accel_block}};
+
+    if (!cenviro_motion_ready())
+    {
+        return -1.0;
+    }
+    if (cenviro_motion_streaming())
+    {
+        LOG("Accelerometer is streaming - heading is not available\n");
+        return -1.0;
+    }
+    if (!cenviro_bus_transfer(messages, 4))
+    {
+        LOG("Failed to read LSM heading data\n");
+        return -1.0;
+    }
+    double temperature = 0.0;
+    cenviro_vector_t magnetic;
+    cenviro_motion_decode(magnetic_block, &temperature, &magnetic);
+    cenviro_vector_t acceleration = cenviro_motion_decode_acceleration(accel_block);
+
+    if (estimator != NULL)
+    {
+        cenviro_mag_estimator_add(estimator, magnetic);
+    }
+    cenviro_mag_calibration_t calibration = cenviro_motion_calibration();
+    return cenviro_heading_compute(acceleration, magnetic, &calibration);
+}
+
+static void _compass_terms(cenviro_vector_t magnetic, double *terms)
+{
+    terms[0] = magnetic.x * magnetic.x;
+    terms[1] = magnetic.y * magnetic.y;
+    terms[2] = magnetic.z * magnetic.z;
+    terms[3] = magnetic.x;
+    terms[4] = magnetic.y;
+    terms[5] = magnetic.z;
+}
+
+// Gaussian elimination with partial pivoting of augmented 6x7 matrix
+static bool _compass_solve(double matrix[COMPASS_TERMS][COMPASS_TERMS + 1], double *solution)
+{
+    double largest = 0.0;
+    for (int i = 0; i < COMPASS_TERMS; ++i)
+    {
+        largest = (fabs(matrix[i][i]) > largest) ? fabs(matrix[i][i]) : largest;
+    }
+
+    for (int column = 0; column < COMPASS_TERMS; ++column)
+    {
+        int pivot = column;
+        for (int row = column + 1; row < COMPASS_TERMS; ++row)
+        {
+            pivot = (fabs(matrix[row][column]) > fabs(matrix[pivot][column])) ? row : pivot;
+        }
+        if (fabs(matrix[pivot][column]) <= COMPASS_PIVOT_MIN * largest)
+        {
+            return false;
+        }
+        if (pivot != column)
+        {
+            for (int k = column; k <= COMPASS_TERMS; ++k)
+            {
+                double swap = matrix[column][k];
+                matrix[column][k] = matrix[pivot][k];
+                matrix[pivot][k] = swap;
+            }
+        }
+        for (int row = column + 1; row < COMPASS_TERMS; ++row)
+        {
+            double factor = matrix[row][column] / matrix[column][column];
+            for (int k = column; k <= COMPASS_TERMS; ++k)
+            {
+                matrix[row][k] -= factor * matrix[column][k];
+            }
+        }
+    }
+    for (int row = COMPASS_TERMS - 1; row >= 0; --row)
+    {
+        double value = matrix[row][COMPASS_TERMS];
+        for (int k = row + 1; k < COMPASS_TERMS; ++k)
+        {
+            value -= matrix[row][k] * solution[k];
+        }
+        solution[row] = value / matrix[row][row];
+    }
+    return true;
+}
+
+static bool _compass_calibration_valid(const cenviro_mag_calibration_t *calibration)
+{
+    const cenviro_vector_t *offset = &calibration->offset;
+    const cenviro_vector_t *scale = &calibration->scale;
+    // scale factors have to be positive, all values finite
+    return isfinite(offset->x) && isfinite(offset->y) && isfinite(offset->z) && isfinite(scale->x) && isfinite(scale->y) &&
+           isfinite(scale->z) && scale->x > 0.0 && scale->y > 0.0 && scale->z > 0.0;
+}
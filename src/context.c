@@ -0,0 +1,185 @@
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+
+// Functions taking context handle - context is selected for the time of the call (and counted as used, so it
+// cannot be closed meanwhile) and the same function which works on context selected by thread is called.
+
+#define CTX_CALL(ctx, type, call)                           \
+    cenviro_ctx_t *previous = cenviro_ctx_select(ctx);      \
+    type result = call;                                     \
+    cenviro_ctx_select(previous);                           \
+    return result
+
+#define CTX_CALL_VOID(ctx, call)                            \
+    cenviro_ctx_t *previous = cenviro_ctx_select(ctx);      \
+    call;                                                   \
+    cenviro_ctx_select(previous)
+
+bool cenviro_ctx_init(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_init_modules(CENVIRO_MODULE_DEFAULT));
+}
+
+bool cenviro_ctx_init_modules(cenviro_ctx_t *ctx, unsigned module_mask)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_init_modules(module_mask));
+}
+
+unsigned cenviro_ctx_modules_ready(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, unsigned, cenviro_modules_ready());
+}
+
+void cenviro_ctx_deinit(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL_VOID(ctx, cenviro_deinit());
+}
+
+double cenviro_ctx_weather_temperature(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, double, cenviro_weather_temperature());
+}
+
+double cenviro_ctx_weather_pressure(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, double, cenviro_weather_pressure());
+}
+
+bool cenviro_ctx_weather_read(cenviro_ctx_t *ctx, double *temperature, double *pressure)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_weather_read(temperature, pressure));
+}
+
+bool cenviro_ctx_weather_read_forced(cenviro_ctx_t *ctx, double *temperature, double *pressure)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_weather_read_forced(temperature, pressure));
+}
+
+cenviro_crgb_t cenviro_ctx_light_crgb_raw(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, cenviro_crgb_t, cenviro_light_crgb_raw());
+}
+
+cenviro_crgb_t cenviro_ctx_light_crgb_scaled(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, cenviro_crgb_t, cenviro_light_crgb_scaled());
+}
+
+cenviro_lux_t cenviro_ctx_light_lux(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, cenviro_lux_t, cenviro_light_lux());
+}
+
+double cenviro_ctx_motion_temperature(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, double, cenviro_motion_temperature());
+}
+
+cenviro_vector_t cenviro_ctx_motion_acceleration(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, cenviro_vector_t, cenviro_motion_acceleration());
+}
+
+cenviro_vector_t cenviro_ctx_motion_magnetic(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, cenviro_vector_t, cenviro_motion_magnetic());
+}
+
+double cenviro_ctx_motion_heading(cenviro_ctx_t *ctx, cenviro_mag_estimator_t *estimator)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, double, cenviro_motion_heading(estimator));
+}
+
+bool cenviro_ctx_adc_read(cenviro_ctx_t *ctx, uint8_t channel, int16_t *raw)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_adc_read(channel, raw));
+}
+
+double cenviro_ctx_adc_voltage(cenviro_ctx_t *ctx, uint8_t channel)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, double, cenviro_adc_voltage(channel));
+}
+
+cenviro_snapshot_t cenviro_ctx_read_all(cenviro_ctx_t *ctx, unsigned sensor_mask)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, cenviro_snapshot_t, cenviro_read_all(sensor_mask));
+}
+
+bool cenviro_ctx_stats_get(cenviro_ctx_t *ctx, cenviro_stats_t *stats)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_stats_get(stats));
+}
+
+bool cenviro_ctx_sampler_start(cenviro_ctx_t *ctx, const cenviro_sampler_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_sampler_start(config));
+}
+
+void cenviro_ctx_sampler_stop(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL_VOID(ctx, cenviro_sampler_stop());
+}
+
+bool cenviro_ctx_sampler_weather(cenviro_ctx_t *ctx, cenviro_weather_sample_t *sample)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_sampler_weather(sample));
+}
+
+bool cenviro_ctx_sampler_light(cenviro_ctx_t *ctx, cenviro_light_sample_t *sample)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_sampler_light(sample));
+}
+
+bool cenviro_ctx_sampler_motion(cenviro_ctx_t *ctx, cenviro_motion_sample_t *sample)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_sampler_motion(sample));
+}
+
+void cenviro_ctx_led_set(cenviro_ctx_t *ctx, bool state)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL_VOID(ctx, cenviro_led_set(state));
+}
+
+bool cenviro_ctx_led_play(cenviro_ctx_t *ctx, const cenviro_led_pattern_t *pattern)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_led_play(pattern));
+}
+
+void cenviro_ctx_led_stop(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL_VOID(ctx, cenviro_led_stop());
+}
+
+bool cenviro_ctx_led_playing(cenviro_ctx_t *ctx)
+{
+    CENVIRO_PROBE_API();
+    CTX_CALL(ctx, bool, cenviro_led_playing());
+}
@@ -0,0 +1,386 @@
+#ifndef _CENVIRO_CONTEXT_H_
+#define _CENVIRO_CONTEXT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cenviro.h"
+#include "internal.h"
+
+// Library context: state of single board - bus, sensor configuration and calibration, interrupt lines, LED,
+// calibration cache, statistics and background threads. Library functions work on context selected by calling
+// thread (cenviro_use()), threads which did not select any use default context. Threads started by library
+// (module initialization, sampler, LED pattern player) inherit context of thread which started them.
+
+#define CACHE_LINE 64
+
+// weather sensor (BMP280) trimming parameters
+typedef struct
+{
+    uint16_t T1;
+    int16_t T2;
+    int16_t T3;
+    uint16_t P1;
+    int16_t P2;
+    int16_t P3;
+    int16_t P4;
+    int16_t P5;
+    int16_t P6;
+    int16_t P7;
+    int16_t P8;
+    int16_t P9;
+} weather_calibration_t;
+
+typedef struct
+{
+    // measurement configuration (power-on defaults: x1 oversampling, no filter, 0.5ms standby)
+    cenviro_weather_config_t config;
+    // forced mode - chip sleeps between on-demand conversions
+    bool forced;
+    weather_calibration_t calibration;
+    // sensor state lock (protects measurement configuration and mode)
+    cenviro_mutex_t state_lock;
+    // only one forced conversion can be running at a time
+    cenviro_mutex_t conversion_lock;
+} weather_state_t;
+
+#define WEATHER_STATE_INITIALIZER                     \
+    {                                                 \
+        .config = {.osrs_t = CENVIRO_OVERSAMPLING_X1, \
+                   .osrs_p = CENVIRO_OVERSAMPLING_X1, \
+                   .filter = CENVIRO_FILTER_OFF,      \
+                   .standby = CENVIRO_STANDBY_0_5MS}, \
+        .forced = false,                              \
+        .state_lock = CENVIRO_MUTEX_INITIALIZER,      \
+        .conversion_lock = CENVIRO_MUTEX_INITIALIZER  \
+    }
+
+typedef struct
+{
+    uint8_t chip_id;
+    // requested configuration (default 24ms integration, 1x gain)
+    cenviro_light_config_t config;
+    // currently programmed integration cycles and gain (changed by auto-range)
+    uint32_t cycles;
+    cenviro_light_gain_t gain;
+    // first data-ready moment after last (re)configuration - earlier data comes from incomplete cycle
+    uint64_t valid_ns;
+    // clear channel interrupt enabled and its persistence filter [cycles]
+    bool interrupt;
+    uint32_t persistence;
+    cenviro_mutex_t state_lock;
+} light_state_t;
+
+#define LIGHT_STATE_INITIALIZER                                                                  \
+    {                                                                                            \
+        .chip_id = 0x0,                                                                          \
+        .config = {.integration_us = 24000, .gain = CENVIRO_LIGHT_GAIN_1X, .auto_range = false}, \
+        .cycles = 10,                                                                            \
+        .gain = CENVIRO_LIGHT_GAIN_1X,                                                           \
+        .valid_ns = 0,                                                                           \
+        .interrupt = false,                                                                      \
+        .persistence = 0,                                                                        \
+        .state_lock = CENVIRO_MUTEX_INITIALIZER                                                  \
+    }
+
+typedef struct
+{
+    uint8_t chip_id;
+    // requested configuration (default 50Hz, +-2g, +-4gauss)
+    cenviro_motion_config_t config;
+    // accelerometer streaming state (FIFO watermark, 0 - not streaming)
+    uint8_t watermark;
+    // interrupt sources of INT1/INT2 and inertial event settings
+    cenviro_motion_irq_config_t irq;
+    cenviro_mutex_t state_lock;
+} motion_state_t;
+
+#define MOTION_STATE_INITIALIZER                                                                                       \
+    {                                                                                                                  \
+        .chip_id = 0x0,                                                                                                \
+        .config = {.accel_rate_hz = 50, .accel_range = CENVIRO_ACCEL_RANGE_2G, .mag_range = CENVIRO_MAG_RANGE_4GAUSS}, \
+        .watermark = 0,                                                                                                \
+        .irq = {0},                                                                                                    \
+        .state_lock = CENVIRO_MUTEX_INITIALIZER                                                                        \
+    }
+
+// magnetometer hard and soft iron calibration of board
+typedef struct
+{
+    cenviro_mag_calibration_t calibration;
+    cenviro_mutex_t lock;
+} compass_state_t;
+
+#define COMPASS_STATE_INITIALIZER                                             \
+    {                                                                         \
+        .calibration = {.offset = {0.0, 0.0, 0.0}, .scale = {1.0, 1.0, 1.0}}, \
+        .lock = CENVIRO_MUTEX_INITIALIZER                                     \
+    }
+
+typedef struct
+{
+    // default configuration (1600SPS, +-4.096V)
+    cenviro_adc_config_t config;
+    // scan state (channel order, 0 channels - not scanning), next result time
+    uint8_t scan_channels[CENVIRO_ADC_CHANNELS];
+    uint8_t scan_count;
+    uint8_t scan_position;
+    uint64_t scan_deadline;
+    // ALERT/RDY function
+    cenviro_adc_alert_config_t alert;
+    cenviro_mutex_t state_lock;
+} adc_state_t;
+
+#define ADC_STATE_INITIALIZER                                            \
+    {                                                                    \
+        .config = {.rate_sps = 1600, .range = CENVIRO_ADC_RANGE_4096MV}, \
+        .scan_count = 0,                                                 \
+        .scan_position = 0,                                              \
+        .scan_deadline = 0,                                              \
+        .alert = {.mode = CENVIRO_ADC_ALERT_DISABLED},                   \
+        .state_lock = CENVIRO_MUTEX_INITIALIZER                          \
+    }
+
+typedef enum
+{
+    LED_CLOSED = 0,
+    LED_SIM,
+    LED_CHIP,
+    LED_EXTERNAL,
+    LED_SYSFS
+} led_backend_t;
+
+typedef struct
+{
+    led_backend_t backend;
+    int fd;
+    char chip_path[LED_CHIP_PATH_MAX];
+    int line;
+    int external; // line request descriptor of application (not closed by library)
+} led_state_t;
+
+#define LED_STATE_INITIALIZER      \
+    {                              \
+        .backend = LED_CLOSED,     \
+        .fd = -1,                  \
+        .chip_path = LED_GPIOCHIP, \
+        .line = LED_PIN,           \
+        .external = -1             \
+    }
+
+typedef enum
+{
+    IRQ_CLOSED = 0,
+    IRQ_GPIO,
+    IRQ_SIM,
+    IRQ_TIMER,
+    IRQ_EXTERNAL
+} irq_kind_t;
+
+typedef struct
+{
+    int gpio;
+    int external; // application descriptor (not closed by library)
+    uint8_t output; // interrupt output of device (simulated board)
+    irq_kind_t kind;
+    int fd;
+} irq_line_t;
+
+typedef struct
+{
+    irq_line_t lines[CENVIRO_IRQ_COUNT];
+    cenviro_mutex_t lock;
+} irq_state_t;
+
+#define IRQ_LINE_INITIALIZER(line_output) \
+    {                                     \
+        .gpio = -1,                       \
+        .external = -1,                   \
+        .output = (line_output),          \
+        .kind = IRQ_CLOSED,               \
+        .fd = -1                          \
+    }
+#define IRQ_STATE_INITIALIZER                                      \
+    {                                                              \
+        .lines = {[CENVIRO_IRQ_LIGHT] = IRQ_LINE_INITIALIZER(0),   \
+                  [CENVIRO_IRQ_MOTION1] = IRQ_LINE_INITIALIZER(0), \
+                  [CENVIRO_IRQ_MOTION2] = IRQ_LINE_INITIALIZER(1), \
+                  [CENVIRO_IRQ_ADC] = IRQ_LINE_INITIALIZER(0)},    \
+        .lock = CENVIRO_MUTEX_INITIALIZER                          \
+    }
+
+// calibration cache file layout
+#define CALCACHE_BUS_PATH_MAX BUS_PATH_MAX
+#define CALCACHE_FILE_PATH_MAX 256
+#define CALCACHE_ENTRIES_MAX 4
+// leading data bytes read back on validation (BMP280 dig_T1..dig_T3 differ between units)
+#define CALCACHE_FINGERPRINT_LEN 6
+
+typedef struct
+{
+    uint8_t address;
+    uint8_t id_reg; // register used for validation
+    uint8_t chip_id;
+    uint8_t data_reg;
+    uint8_t length;
+    uint8_t data[CALCACHE_DATA_MAX];
+} calcache_entry_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    char bus_path[CALCACHE_BUS_PATH_MAX];
+    uint32_t count;
+    calcache_entry_t entries[CALCACHE_ENTRIES_MAX];
+} calcache_file_t;
+
+typedef struct
+{
+    // empty - cache disabled
+    char path[CALCACHE_FILE_PATH_MAX];
+    calcache_file_t cache;
+    bool dirty;
+    // modules can be initialized in parallel
+    cenviro_mutex_t lock;
+} calcache_state_t;
+
+#define CALCACHE_STATE_INITIALIZER        \
+    {                                     \
+        .path = "",                       \
+        .dirty = false,                   \
+        .lock = CENVIRO_MUTEX_INITIALIZER \
+    }
+
+// background sampler - single writer / many readers sequence lock (odd sequence - write in progress)
+#define SEQLOCK_WORDS 8
+
+typedef struct
+{
+    uint32_t sequence;
+    uint64_t data[SEQLOCK_WORDS];
+} __attribute__((aligned(CACHE_LINE))) sampler_seqlock_t;
+
+typedef struct
+{
+    sampler_seqlock_t weather_slot;
+    sampler_seqlock_t light_slot;
+    sampler_seqlock_t motion_slot;
+#ifndef DISABLE_THREADSAFE
+    pthread_t thread;
+    bool running;
+    bool stop;
+    cenviro_sampler_config_t config;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+#endif // DISABLE_THREADSAFE
+} sampler_state_t;
+
+#ifndef DISABLE_THREADSAFE
+#define SAMPLER_STATE_INITIALIZER         \
+    {                                     \
+        .running = false,                 \
+        .stop = false,                    \
+        .lock = PTHREAD_MUTEX_INITIALIZER \
+    }
+#else
+#define SAMPLER_STATE_INITIALIZER {{0}}
+#endif // DISABLE_THREADSAFE
+
+// LED pattern player
+typedef struct
+{
+#ifndef DISABLE_THREADSAFE
+    pthread_t thread;
+    int timer;
+    bool running; // thread exists
+    bool active;  // pattern is played
+    bool pending;
+    bool exit;
+    cenviro_led_pattern_t next;
+    pthread_mutex_t lock;
+    // lateness statistics (updated by player thread under lock)
+    uint64_t timing_changes;
+    uint64_t timing_missed;
+    double timing_sum;
+    double timing_sum_sq;
+    uint64_t timing_max;
+#else
+    int unused;
+#endif // DISABLE_THREADSAFE
+} pattern_state_t;
+
+#ifndef DISABLE_THREADSAFE
+#define PATTERN_STATE_INITIALIZER         \
+    {                                     \
+        .timer = -1,                      \
+        .running = false,                 \
+        .active = false,                  \
+        .pending = false,                 \
+        .exit = false,                    \
+        .lock = PTHREAD_MUTEX_INITIALIZER \
+    }
+#else
+#define PATTERN_STATE_INITIALIZER {0}
+#endif // DISABLE_THREADSAFE
+
+struct cenviro_ctx
+{
+    cenviro_bus_t bus;
+    bool initialized;
+    // library (init/deinit) lock
+    cenviro_mutex_t lock;
+    // mask of initialized modules (read without lock on every API call)
+    unsigned modules_ready;
+    // mask of modules which failed initialization (not retried until next cenviro_init())
+    unsigned modules_failed;
+    // serializes module initialization (eager and lazy)
+    cenviro_mutex_t modules_lock;
+    // context allocated by cenviro_open()
+    bool opened;
+    // application threads which selected context or are inside cenviro_ctx_*() call (counted for opened contexts)
+    unsigned users;
+
+    cenviro_stats_t stats;
+    calcache_state_t calcache;
+    weather_state_t weather;
+    light_state_t light;
+    motion_state_t motion;
+    compass_state_t compass;
+    adc_state_t adc;
+    led_state_t led;
+    irq_state_t irq;
+    sampler_state_t sampler;
+    pattern_state_t pattern;
+};
+
+#define CENVIRO_CTX_INITIALIZER                                                                                           \
+    {                                                                                                                     \
+        .bus = {.backend = &cenviro_bus_i2cdev, .path = I2C_BUS_FILE, .handle = NULL, .lock = CENVIRO_MUTEX_INITIALIZER}, \
+        .initialized = false,                                                                                             \
+        .lock = CENVIRO_MUTEX_INITIALIZER,                                                                                \
+        .modules_ready = 0,                                                                                               \
+        .modules_failed = 0,                                                                                              \
+        .modules_lock = CENVIRO_MUTEX_INITIALIZER,                                                                        \
+        .opened = false,                                                                                                  \
+        .users = 0,                                                                                                       \
+        .calcache = CALCACHE_STATE_INITIALIZER,                                                                           \
+        .weather = WEATHER_STATE_INITIALIZER,                                                                             \
+        .light = LIGHT_STATE_INITIALIZER,                                                                                 \
+        .motion = MOTION_STATE_INITIALIZER,                                                                               \
+        .compass = COMPASS_STATE_INITIALIZER,                                                                             \
+        .adc = ADC_STATE_INITIALIZER,                                                                                     \
+        .led = LED_STATE_INITIALIZER,                                                                                     \
+        .irq = IRQ_STATE_INITIALIZER,                                                                                     \
+        .sampler = SAMPLER_STATE_INITIALIZER,                                                                             \
+        .pattern = PATTERN_STATE_INITIALIZER                                                                              \
+    }
+
+extern cenviro_ctx_t _cenviro_default_ctx;
+// context of calling thread (never NULL)
+extern __thread cenviro_ctx_t *_cenviro_ctx;
+
+// select context for calling thread (NULL - default context) and update user counts, returns previous one
+cenviro_ctx_t *cenviro_ctx_select(cenviro_ctx_t *ctx);
+
+#endif // _CENVIRO_CONTEXT_H_
@@ -0,0 +1,93 @@
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "internal.h"
+#include "logs.h"
+
+// maximum number of messages in single transaction (kernel limit is 42)
+#define I2CDEV_MESSAGES_MAX 8
+
+typedef struct
+{
+    int fd;
+} i2cdev_handle_t;
+
+static void *_i2cdev_open(const char *path)
+{
+    i2cdev_handle_t *handle = malloc(sizeof(i2cdev_handle_t));
+    if (handle == NULL)
+    {
+        return NULL;
+    }
+
+    handle->fd = open(path, O_RDWR);
+    if (handle->fd < 0)
+    {
+        LOG_ERROR("Failed to open i2c bus %s\n", path);
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+static bool _i2cdev_select_slave(void *handle, uint8_t address)
+{
+    i2cdev_handle_t *dev = handle;
+    if (ioctl(dev->fd, I2C_SLAVE, address) < 0)
+    {
+        LOG("Failed to set slave address 0x%02x\n", address);
+        cenviro_stats_ioctl_failure(address);
+        return false;
+    }
+    return true;
+}
+
+static bool _i2cdev_transfer(void *handle, cenviro_bus_msg_t *messages, size_t count)
+{
+    i2cdev_handle_t *dev = handle;
+    struct i2c_msg i2c_messages[I2CDEV_MESSAGES_MAX];
+
+    if (count == 0 || count > I2CDEV_MESSAGES_MAX)
+    {
+        LOG("Invalid number of messages\n");
+        errno = EINVAL;
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        i2c_messages[i].addr = messages[i].address;
+        i2c_messages[i].flags = messages[i].read ? I2C_M_RD : 0;
+        i2c_messages[i].len = messages[i].length;
+        i2c_messages[i].buf = messages[i].data;
+    }
+
+    struct i2c_rdwr_ioctl_data transaction = {.msgs = i2c_messages, .nmsgs = count};
+    if (ioctl(dev->fd, I2C_RDWR, &transaction) != (int)count)
+    {
+        int error = errno;
+        LOG("I2C_RDWR transaction failed (errno %d)\n", error);
+        cenviro_stats_transfer_failure(messages, count);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+static void _i2cdev_close(void *handle)
+{
+    i2cdev_handle_t *dev = handle;
+    close(dev->fd);
+    free(dev);
+}
+
+const cenviro_bus_backend_t cenviro_bus_i2cdev = {
+    .name = "i2c-dev",
+    .open = _i2cdev_open,
+    .select_slave = _i2cdev_select_slave,
+    .transfer = _i2cdev_transfer,
+    .close = _i2cdev_close};
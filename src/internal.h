@@ -2,12 +2,20 @@
 #define _CENVIRO_INTERNAL_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-// GPIO pin number for LED control
+#include "cenviro.h"
+#include "probes.h"
+
+// GPIO pin number for LED control (line offset of GPIO character device)
 #define LED_PIN 4
+#define LED_GPIOCHIP "/dev/gpiochip0"
+#define LED_CHIP_PATH_MAX 64
 
 // i2c device file (based on RPi Zero)
 #define I2C_BUS_FILE "/dev/i2c-1"
+#define BUS_PATH_MAX 64
 
 // i2c addresses of Enviro pHat sensors
 #define WEATHER_ADDR 0x77 // temperature and pressure
@@ -15,31 +23,149 @@
 #define MOTION_ADDR 0x1d  // position and movement
 #define ADC_ADDR 0x49     // analog to digital converter
 
-// wating time between i2c commads (ex. between write() and read() )
-#define COMMAND_WAIT 5
+// single bus message (equivalent of kernel's struct i2c_msg)
+typedef struct
+{
+    uint8_t address;
+    bool read;
+    uint16_t length;
+    uint8_t *data;
+} cenviro_bus_msg_t;
 
-// variables shared between different library files
-extern int _cenviro_bus_fd;
-extern bool _cenviro_initialized;
-#define SHARED_BUFFER_LEN 32
-extern uint8_t _cenviro_buffer[SHARED_BUFFER_LEN]; // 32 bytes should be enough
+// bus backend interface
+typedef struct
+{
+    const char *name;
+    // open bus and return backend specific handle (NULL on failure)
+    void *(*open)(const char *path);
+    // check if slave device with given address can be addressed
+    bool (*select_slave)(void *handle, uint8_t address);
+    // execute all messages as single combined transaction
+    bool (*transfer)(void *handle, cenviro_bus_msg_t *messages, size_t count);
+    void (*close)(void *handle);
+} cenviro_bus_backend_t;
 
 #ifndef DISABLE_THREADSAFE
 #include <pthread.h>
-extern pthread_mutex_t _cenviro_lock;
-// define helper macros for easier mutex lock/unlock in multithread code
-#define CENVIRO_LOCK_MUTEX() pthread_mutex_lock(&_cenviro_lock)
-#define CENVIRO_UNLOCK_MUTEX() pthread_mutex_unlock(&_cenviro_lock)
+typedef pthread_mutex_t cenviro_mutex_t;
+#define CENVIRO_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+// helper macros for short critical sections protecting single resource (bus, sensor state)
+#define CENVIRO_LOCK(mutex)                       \
+    do                                            \
+    {                                             \
+        CENVIRO_PROBE1(lock__acquire, (mutex));   \
+        pthread_mutex_lock(mutex);                \
+        CENVIRO_PROBE1(lock__acquired, (mutex));  \
+    } while (0)
+#define CENVIRO_TRYLOCK(mutex) (pthread_mutex_trylock(mutex) == 0)
+#define CENVIRO_UNLOCK(mutex) pthread_mutex_unlock(mutex)
 #else
-#define CENVIRO_LOCK_MUTEX()
-#define CENVIRO_UNLOCK_MUTEX()
+typedef int cenviro_mutex_t;
+#define CENVIRO_MUTEX_INITIALIZER 0
+#define CENVIRO_LOCK(mutex) ((void)(mutex))
+#define CENVIRO_TRYLOCK(mutex) ((void)(mutex), true)
+#define CENVIRO_UNLOCK(mutex) ((void)(mutex))
 #endif // DISABLE_THREADSAFE
 
+typedef struct
+{
+    const cenviro_bus_backend_t *backend;
+    // copy of path given to cenviro_set_bus() (used again by calibration cache and re-initialization)
+    char path[BUS_PATH_MAX];
+    void *handle;
+    // bus arbitration - held only for the time of single transfer
+    cenviro_mutex_t lock;
+} cenviro_bus_t;
+
+// available backends
+extern const cenviro_bus_backend_t cenviro_bus_i2cdev;
+extern const cenviro_bus_backend_t cenviro_bus_sim;
+
+// lazy module initialization - returns true if module is (or has just been) initialized
+bool cenviro_module_ready(unsigned module);
+// check module state without initializing it
+bool cenviro_module_active(unsigned module);
+
 // functions used interally only
 bool cenviro_weather_init();
 bool cenviro_led_init();
 void cenviro_led_deinit();
 bool cenviro_light_init();
 bool cenviro_motion_init();
+bool cenviro_adc_init();
+
+// bus transactions (register read is done as single repeated-start transfer)
+bool cenviro_bus_open();
+void cenviro_bus_close();
+bool cenviro_bus_probe(uint8_t address);
+bool cenviro_bus_simulated();
+bool cenviro_bus_transfer(cenviro_bus_msg_t *messages, size_t count);
+bool cenviro_bus_read(uint8_t address, uint8_t reg, uint8_t *data, size_t length);
+bool cenviro_bus_write(uint8_t address, uint8_t reg, const uint8_t *data, size_t length);
+
+// bus statistics - transfer is recorded by caller holding bus lock, retries and driver failures can be
+// reported from any context
+void cenviro_stats_transfer(const cenviro_bus_msg_t *messages, size_t count, bool status, uint64_t lock_wait_ns,
+                            uint64_t transfer_ns);
+void cenviro_stats_retry(uint8_t address);
+void cenviro_stats_ioctl_failure(uint8_t address);
+// failure of combined transaction reported by bus driver (every addressed device is counted once)
+void cenviro_stats_transfer_failure(const cenviro_bus_msg_t *messages, size_t count);
+
+// calibration cache (entries are keyed by bus path, slave address and chip id, data read from data_reg is
+// validated with its first bytes - chip id is the same for every unit of given device)
+#define CALCACHE_DATA_MAX 24
+void cenviro_calcache_load();
+bool cenviro_calcache_get(uint8_t address, uint8_t *chip_id, uint8_t *data, size_t length);
+void cenviro_calcache_put(uint8_t address, uint8_t id_reg, uint8_t chip_id, uint8_t data_reg, const uint8_t *data,
+                          size_t length);
+void cenviro_calcache_save();
+
+// burst data blocks (register address with auto-increment flag and length) read by cenviro_read_all()
+#define WEATHER_BLOCK_REG 0xf7 // press_msb .. temp_xlsb
+#define WEATHER_BLOCK_LEN 6
+#define LIGHT_BLOCK_REG 0xb3 // command | auto-increment | status, cdatal .. bdatah
+#define LIGHT_BLOCK_LEN 9
+#define MOTION_BLOCK_REG 0x85 // auto-increment | temp_out_l .. out_z_h_m
+#define MOTION_BLOCK_LEN 9
+#define MOTION_ACCEL_BLOCK_REG 0xa8 // auto-increment | out_x_l_a .. out_z_h_a
+#define MOTION_ACCEL_BLOCK_LEN 6
+
+// decoding of burst data blocks
+bool cenviro_weather_ready();
+void cenviro_weather_decode(const uint8_t *block, double *temperature, double *pressure);
+bool cenviro_light_ready();
+cenviro_crgb_t cenviro_light_decode(const uint8_t *block);
+// read counts together with integration time and gain they were measured with
+bool cenviro_light_read(cenviro_crgb_t *crgb, uint32_t *integration_us, cenviro_light_gain_t *gain);
+// integration settings and end of first cycle with them (taken before burst read of status and data block)
+void cenviro_light_cycle(uint64_t *valid_ns, uint32_t *integration_us, cenviro_light_gain_t *gain);
+// counts of status and data block read at timestamp_ns (auto-range step is taken), false when cycle is not complete
+bool cenviro_light_decode_status(const uint8_t *block, uint64_t valid_ns, uint64_t timestamp_ns, cenviro_crgb_t *crgb);
+bool cenviro_motion_ready();
+// temperature read reporting bus failures (public getter returns 0.0 on failure)
+bool cenviro_motion_read_temperature(double *temperature);
+double cenviro_motion_decode_temperature(const uint8_t *block);
+void cenviro_motion_decode(const uint8_t *block, double *temperature, cenviro_vector_t *magnetic);
+cenviro_vector_t cenviro_motion_decode_acceleration(const uint8_t *block);
+bool cenviro_adc_ready();
+// accelerometer registers are FIFO output while streaming (reading them would consume stream samples)
+bool cenviro_motion_streaming();
+
+// sensor interrupt lines - descriptor is opened on first use (poll period is used when line is not connected)
+int cenviro_irq_fd(cenviro_irq_line_t line, uint8_t address, uint32_t poll_period_us);
+// wait for interrupt line event, returns 1 on event, 0 on timeout, -1 on error
+int cenviro_irq_wait(cenviro_irq_line_t line, int timeout_ms);
+// line is not connected (events are periodic status polls)
+bool cenviro_irq_polled(cenviro_irq_line_t line);
+void cenviro_irq_close_all();
+
+// simulated board helpers
+void cenviro_sim_led_set(bool state);
+// stand-in interrupt line of simulated device (output - INT1/INT2 pin index)
+int cenviro_sim_irq_fd(uint8_t address, uint8_t output);
+
+// monotonic clock in [ns]
+uint64_t cenviro_monotonic_ns();
 
 #endif // _CENVIRO_INTERNAL_H_
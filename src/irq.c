@@ -0,0 +1,245 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// Sensor interrupt lines. Each line is represented by a file descriptor which can be used in poll():
+// - descriptor supplied by application,
+// - GPIO value file (sysfs, edge triggered) when line is connected to GPIO pin,
+// - stand-in timerfd provided by simulated board,
+// - periodic timerfd when line is not connected (latched interrupt status is polled over the bus).
+
+#define IRQ_PATH_MAX 48
+// decimal int with sign and terminating zero (INT_MIN)
+#define IRQ_NUMBER_MAX 12
+
+static int _irq_open_gpio(int gpio);
+static bool _irq_sysfs_write(const char *path, const char *value);
+
+bool cenviro_set_irq_gpio(cenviro_irq_line_t line, int gpio)
+{
+    CENVIRO_PROBE_API();
+    irq_state_t *irq_state = &_cenviro_ctx->irq;
+    if (_cenviro_ctx->initialized)
+    {
+        LOG("Interrupt lines cannot be changed while library is initialized\n");
+        return false;
+    }
+    if (line >= CENVIRO_IRQ_COUNT)
+    {
+        LOG("Unknown interrupt line\n");
+        return false;
+    }
+    irq_state->lines[line].gpio = gpio;
+    return true;
+}
+
+bool cenviro_set_irq_fd(cenviro_irq_line_t line, int fd)
+{
+    CENVIRO_PROBE_API();
+    irq_state_t *irq_state = &_cenviro_ctx->irq;
+    if (_cenviro_ctx->initialized)
+    {
+        LOG("Interrupt lines cannot be changed while library is initialized\n");
+        return false;
+    }
+    if (line >= CENVIRO_IRQ_COUNT)
+    {
+        LOG("Unknown interrupt line\n");
+        return false;
+    }
+    irq_state->lines[line].external = fd;
+    return true;
+}
+
+int cenviro_irq_fd(cenviro_irq_line_t line, uint8_t address, uint32_t poll_period_us)
+{
+    irq_state_t *irq_state = &_cenviro_ctx->irq;
+    if (line >= CENVIRO_IRQ_COUNT)
+    {
+        return -1;
+    }
+    irq_line_t *irq = &irq_state->lines[line];
+
+    CENVIRO_LOCK(&irq_state->lock);
+    if (irq->kind == IRQ_CLOSED)
+    {
+        if (irq->external >= 0)
+        {
+            irq->fd = irq->external;
+            irq->kind = IRQ_EXTERNAL;
+        }
+        else if (cenviro_bus_simulated())
+        {
+            irq->fd = cenviro_sim_irq_fd(address, irq->output);
+            irq->kind = IRQ_SIM;
+        }
+        else if (irq->gpio >= 0)
+        {
+            irq->fd = _irq_open_gpio(irq->gpio);
+            irq->kind = IRQ_GPIO;
+        }
+        else
+        {
+            irq->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            irq->kind = IRQ_TIMER;
+        }
+        if (irq->fd < 0)
+        {
+            LOG("Failed to open interrupt line\n");
+            irq->kind = IRQ_CLOSED;
+        }
+    }
+    if (irq->kind == IRQ_TIMER)
+    {
+        struct itimerspec timer = {0};
+        timer.it_interval.tv_sec = poll_period_us / 1000000;
+        timer.it_interval.tv_nsec = (poll_period_us % 1000000) * 1000;
+        timer.it_value = timer.it_interval;
+        timerfd_settime(irq->fd, 0, &timer, NULL);
+    }
+    int fd = irq->fd;
+    CENVIRO_UNLOCK(&irq_state->lock);
+    return fd;
+}
+
+int cenviro_irq_wait(cenviro_irq_line_t line, int timeout_ms)
+{
+    irq_state_t *irq_state = &_cenviro_ctx->irq;
+    irq_line_t *irq = &irq_state->lines[line];
+    struct pollfd descriptor = {.fd = irq->fd, .events = (irq->kind == IRQ_GPIO) ? POLLPRI : POLLIN};
+    if (irq->kind == IRQ_EXTERNAL)
+    {
+        descriptor.events = POLLIN | POLLPRI;
+    }
+
+    int result = poll(&descriptor, 1, timeout_ms);
+    if (result < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    if (result == 0)
+    {
+        return 0;
+    }
+
+    // consume the event (edge for GPIO, expirations for timers, counter or line events for application descriptor)
+    if (irq->kind == IRQ_GPIO || (irq->kind == IRQ_EXTERNAL && (descriptor.revents & POLLPRI)))
+    {
+        char value[2];
+        lseek(irq->fd, 0, SEEK_SET);
+        if (read(irq->fd, value, sizeof(value)) < 0)
+        {
+            LOG("Failed to read interrupt line value\n");
+        }
+    }
+    else if (irq->kind == IRQ_EXTERNAL)
+    {
+        uint8_t event[64];
+        if (read(irq->fd, event, sizeof(event)) < 0 && errno != EAGAIN)
+        {
+            LOG("Failed to read interrupt descriptor\n");
+        }
+    }
+    else
+    {
+        uint64_t expirations = 0;
+        if (read(irq->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        {
+            LOG("Failed to read interrupt timer\n");
+        }
+    }
+    return 1;
+}
+
+bool cenviro_irq_polled(cenviro_irq_line_t line)
+{
+    irq_state_t *irq_state = &_cenviro_ctx->irq;
+    CENVIRO_LOCK(&irq_state->lock);
+    bool polled = line < CENVIRO_IRQ_COUNT && irq_state->lines[line].kind == IRQ_TIMER;
+    CENVIRO_UNLOCK(&irq_state->lock);
+    return polled;
+}
+
+void cenviro_irq_close_all()
+{
+    irq_state_t *irq_state = &_cenviro_ctx->irq;
+    CENVIRO_LOCK(&irq_state->lock);
+    for (int i = 0; i < CENVIRO_IRQ_COUNT; ++i)
+    {
+        irq_line_t *irq = &irq_state->lines[i];
+        if (irq->kind == IRQ_GPIO || irq->kind == IRQ_TIMER)
+        {
+            // simulated lines are owned (and closed) by simulator
+            close(irq->fd);
+        }
+        irq->kind = IRQ_CLOSED;
+        irq->fd = -1;
+    }
+    CENVIRO_UNLOCK(&irq_state->lock);
+}
+
+// sensor interrupt outputs are active low (open drain) - wait for falling edge
+static int _irq_open_gpio(int gpio)
+{
+    char path[IRQ_PATH_MAX];
+    char number[IRQ_NUMBER_MAX];
+    struct stat file_check;
+
+    snprintf(path, IRQ_PATH_MAX, "/sys/class/gpio/gpio%d", gpio);
+    snprintf(number, sizeof(number), "%d", gpio);
+    if (stat(path, &file_check) != 0 && !_irq_sysfs_write("/sys/class/gpio/export", number))
+    {
+        LOG("Failed to export interrupt GPIO\n");
+        return -1;
+    }
+
+    snprintf(path, IRQ_PATH_MAX, "/sys/class/gpio/gpio%d/direction", gpio);
+    if (!_irq_sysfs_write(path, "in"))
+    {
+        return -1;
+    }
+    snprintf(path, IRQ_PATH_MAX, "/sys/class/gpio/gpio%d/edge", gpio);
+    if (!_irq_sysfs_write(path, "falling"))
+    {
+        return -1;
+    }
+
+    snprintf(path, IRQ_PATH_MAX, "/sys/class/gpio/gpio%d/value", gpio);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        LOG("Failed to open interrupt GPIO value file\n");
+        return -1;
+    }
+    // initial read - poll() reports only edges which happen after it
+    char value[2];
+    if (read(fd, value, sizeof(value)) < 0)
+    {
+        LOG("Failed to read interrupt GPIO value\n");
+    }
+    return fd;
+}
+
+static bool _irq_sysfs_write(const char *path, const char *value)
+{
+    int fd = open(path, O_WRONLY);
+    if (fd < 0)
+    {
+        LOG("Failed to open GPIO sysfs file\n");
+        return false;
+    }
+    ssize_t length = strlen(value);
+    bool status = write(fd, value, length) == length;
+    close(fd);
+    return status;
+}
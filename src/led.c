@@ -2,31 +2,99 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <linux/gpio.h>
 
 #include "cenviro.h"
+#include "context.h"
 #include "internal.h"
 #include "logs.h"
 
+// LED backends:
+// - line request of GPIO character device (line is acquired once, every change is single ioctl),
+// - line request descriptor supplied by application,
+// - sysfs /sys/class/gpio files (fallback for kernels without v2 uAPI of character device),
+// - simulated board.
+
 // number of retrials when accessing /sys/class/gpio/*
 #define RETRIAL_COUNT 3
 // time for delay between retrials (in [ms])
 #define DELAY_TIME 100
 
-static bool _led_initialized = false;
-static int _led_fd = 0;
-
-#define DATA_BUFFER_MAX 3
+#define DATA_BUFFER_MAX 8
 #define PATH_BUFFER_MAX 40
 
+static int _chip_request_line();
+static bool _chip_set_value(bool value);
 static bool _gpio_export();
 static bool _gpio_set_output();
 static bool _gpio_open_output_file();
 static bool _gpio_set_value(bool value);
 static bool _gpio_unexport();
 
+bool cenviro_set_led_gpio(const char *chip_path, int line)
+{
+    CENVIRO_PROBE_API();
+    led_state_t *led = &_cenviro_ctx->led;
+    if (_cenviro_ctx->initialized)
+    {
+        LOG("LED line cannot be changed while library is initialized\n");
+        return false;
+    }
+    if (line < 0)
+    {
+        LOG("Invalid LED line\n");
+        return false;
+    }
+    chip_path = (chip_path != NULL) ? chip_path : LED_GPIOCHIP;
+    if (strlen(chip_path) >= LED_CHIP_PATH_MAX)
+    {
+        LOG("LED GPIO chip path too long\n");
+        return false;
+    }
+    strcpy(led->chip_path, chip_path);
+    led->line = line;
+    return true;
+}
+
+bool cenviro_set_led_fd(int fd)
+{
+    CENVIRO_PROBE_API();
+    led_state_t *led = &_cenviro_ctx->led;
+    if (_cenviro_ctx->initialized)
+    {
+        LOG("LED line cannot be changed while library is initialized\n");
+        return false;
+    }
+    led->external = fd;
+    return true;
+}
+
 bool cenviro_led_init()
 {
+    led_state_t *led = &_cenviro_ctx->led;
+    if (led->external >= 0)
+    {
+        led->fd = led->external;
+        led->backend = LED_EXTERNAL;
+        return true;
+    }
+    if (cenviro_bus_simulated())
+    {
+        // simulated board has no GPIO - LED state is kept by the simulator
+        led->backend = LED_SIM;
+        return true;
+    }
+    led->fd = _chip_request_line();
+    if (led->fd >= 0)
+    {
+        led->backend = LED_CHIP;
+        return true;
+    }
+
+    LOG_INFO("Falling back to sysfs GPIO interface\n");
     if (!_gpio_export())
     {
         LOG("GPIO export failed\n");
@@ -43,17 +111,35 @@ bool cenviro_led_init()
         LOG("LED GPIO ouptup file opening failed\n");
         return false;
     }
-    _led_initialized = true;
+    led->backend = LED_SYSFS;
     return true;
 }
 
 void cenviro_led_set(bool state)
 {
-    if (!_led_initialized)
+    CENVIRO_PROBE_API();
+    led_state_t *led = &_cenviro_ctx->led;
+    if (!cenviro_module_ready(CENVIRO_MODULE_LED))
     {
         return;
     }
-    if (!_gpio_set_value(state))
+    bool status = true;
+    switch (led->backend)
+    {
+    case LED_SIM:
+        cenviro_sim_led_set(state);
+        break;
+    case LED_CHIP:
+    case LED_EXTERNAL:
+        status = _chip_set_value(state);
+        break;
+    case LED_SYSFS:
+        status = _gpio_set_value(state);
+        break;
+    default:
+        break;
+    }
+    if (!status)
     {
         LOG("GPIO value set failed\n");
     }
@@ -61,31 +147,88 @@ void cenviro_led_set(bool state)
 
 void cenviro_led_deinit()
 {
-    if (!_led_initialized)
+    led_state_t *led = &_cenviro_ctx->led;
+    if (led->backend == LED_CHIP)
     {
-        return;
+        // releasing line request returns line to the kernel
+        close(led->fd);
+    }
+    else if (led->backend == LED_SYSFS)
+    {
+        _gpio_unexport();
+        close(led->fd);
+    }
+    led->fd = -1;
+    led->backend = LED_CLOSED;
+}
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+// output line request with LED switched off, returns line request descriptor
+static int _chip_request_line()
+{
+    led_state_t *led = &_cenviro_ctx->led;
+    int chip = open(led->chip_path, O_RDWR);
+    if (chip < 0)
+    {
+        LOG_INFO("Failed to open GPIO character device\n");
+        return -1;
     }
-    _gpio_unexport();
-    if (_led_fd != 0)
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = led->line;
+    request.num_lines = 1;
+    strncpy(request.consumer, "cenviro-led", GPIO_MAX_NAME_SIZE - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    request.config.num_attrs = 1;
+    request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    request.config.attrs[0].attr.values = 0;
+    request.config.attrs[0].mask = 1;
+
+    int status = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+    // line request stays valid after chip descriptor is closed
+    close(chip);
+    if (status < 0)
     {
-        close(_led_fd);
-        _led_fd = 0;
+        LOG_INFO("Failed to request LED GPIO line\n");
+        return -1;
     }
-    _led_initialized = false;
+    return request.fd;
+}
+
+static bool _chip_set_value(bool value)
+{
+    led_state_t *led = &_cenviro_ctx->led;
+    struct gpio_v2_line_values values = {.bits = value ? 1 : 0, .mask = 1};
+    return ioctl(led->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) == 0;
+}
+#else
+// kernel headers without v2 uAPI - only sysfs interface is used
+static int _chip_request_line()
+{
+    return -1;
+}
+
+static bool _chip_set_value(bool value)
+{
+    (void)value;
+    return false;
 }
+#endif // GPIO_V2_GET_LINE_IOCTL
 
-bool _gpio_export()
+static bool _gpio_export()
 {
+    led_state_t *led = &_cenviro_ctx->led;
     // first check if already exported (pin ready to use)
     struct stat file_check;
     char buffer[PATH_BUFFER_MAX];
-    snprintf(buffer, PATH_BUFFER_MAX, "/sys/class/gpio/gpio%d", LED_PIN);
+    snprintf(buffer, PATH_BUFFER_MAX, "/sys/class/gpio/gpio%d", led->line);
     int result = stat(buffer, &file_check);
     if (result == 0)
     {
         if (S_ISDIR(file_check.st_mode))
         {
-            LOG("LED GPIO pin already exported\n");
+            LOG_INFO("LED GPIO pin already exported\n");
             return true;
         }
         else
@@ -105,7 +248,7 @@ bool _gpio_export()
     }
 
     ssize_t string_len = 0;
-    string_len = snprintf(buffer, DATA_BUFFER_MAX, "%d", LED_PIN);
+    string_len = snprintf(buffer, DATA_BUFFER_MAX, "%d", led->line);
     ssize_t retval = write(fd, buffer, string_len);
     if (retval != string_len)
     {
@@ -119,14 +262,15 @@ bool _gpio_export()
 
 static bool _gpio_set_output()
 {
+    led_state_t *led = &_cenviro_ctx->led;
     char path[PATH_BUFFER_MAX];
     int fd = 0;
     int retrial_left = RETRIAL_COUNT;
 
-    snprintf(path, PATH_BUFFER_MAX, "/sys/class/gpio/gpio%d/direction", LED_PIN);
+    snprintf(path, PATH_BUFFER_MAX, "/sys/class/gpio/gpio%d/direction", led->line);
     while (retrial_left > 0)
     {
-        LOG("Trying to open direction file\n");
+        LOG_DEBUG("Trying to open direction file\n");
         fd = open(path, O_WRONLY);
         if (fd >= 0)
         {
@@ -146,7 +290,7 @@ static bool _gpio_set_output()
     retrial_left = RETRIAL_COUNT;
     while (retrial_left > 0)
     {
-        LOG("Trying to write direction\n");
+        LOG_DEBUG("Trying to write direction\n");
         ssize_t retval = write(fd, "out", 3);
         if (3 == retval)
         {
@@ -167,14 +311,15 @@ static bool _gpio_set_output()
 
 static bool _gpio_open_output_file()
 {
+    led_state_t *led = &_cenviro_ctx->led;
     char path[PATH_BUFFER_MAX];
     int fd = 0;
     int retrial_left = RETRIAL_COUNT;
 
-    snprintf(path, PATH_BUFFER_MAX, "/sys/class/gpio/gpio%d/value", LED_PIN);
+    snprintf(path, PATH_BUFFER_MAX, "/sys/class/gpio/gpio%d/value", led->line);
     while (retrial_left > 0)
     {
-        LOG("Trying to open value file\n");
+        LOG_DEBUG("Trying to open value file\n");
         fd = open(path, O_WRONLY);
         if (fd >= 0)
         {
@@ -191,19 +336,20 @@ static bool _gpio_open_output_file()
         --retrial_left;
     }
 
-    _led_fd = fd;
+    led->fd = fd;
     return true;
 }
 
 static bool _gpio_set_value(bool value)
 {
+    led_state_t *led = &_cenviro_ctx->led;
     static const char s_values_str[] = "01";
     int retrial_left = RETRIAL_COUNT;
 
     while (retrial_left > 0)
     {
-        LOG("Trying to write value\n");
-        ssize_t retval = write(_led_fd, &s_values_str[value == true ? 1 : 0], 1);
+        LOG_DEBUG("Trying to write value\n");
+        ssize_t retval = write(led->fd, &s_values_str[value == true ? 1 : 0], 1);
         if (1 == retval)
         {
             // write succeeded - break the loop
@@ -221,8 +367,9 @@ static bool _gpio_set_value(bool value)
     return true;
 }
 
-bool _gpio_unexport()
+static bool _gpio_unexport()
 {
+    led_state_t *led = &_cenviro_ctx->led;
     char buffer[DATA_BUFFER_MAX];
     ssize_t bytes_written;
     int fd;
@@ -234,7 +381,7 @@ bool _gpio_unexport()
         return false;
     }
 
-    bytes_written = snprintf(buffer, DATA_BUFFER_MAX, "%d", LED_PIN);
+    bytes_written = snprintf(buffer, DATA_BUFFER_MAX, "%d", led->line);
     write(fd, buffer, bytes_written);
     close(fd);
 
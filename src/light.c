@@ -1,9 +1,7 @@
-#include <linux/i2c-dev.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
 
 #include "cenviro.h"
+#include "context.h"
 #include "internal.h"
 #include "logs.h"
 
@@ -13,34 +11,59 @@
 
 // addresses of used TCS3472 registers
 #define TCS_ADDRESS_ENABLE 0x00
+#define TCS_ADDRESS_ATIME 0x01
+#define TCS_ADDRESS_AILTL 0x04 // low threshold, followed by high one (AIHTL, AIHTH)
+#define TCS_ADDRESS_PERS 0x0c
+#define TCS_ADDRESS_CONTROL 0x0f
 #define TCS_ADDRESS_ID 0x12
+#define TCS_ADDRESS_STATUS 0x13
+
+#define TCS_ENABLE_PON 0x01
+#define TCS_ENABLE_AEN 0x02
+#define TCS_ENABLE_AIEN 0x10
+#define TCS_STATUS_AVALID 0x01
+#define TCS_STATUS_AINT 0x10
+// special function command clearing interrupt
+#define TCS_SPECIAL_INT_CLEAR 0x66
 
 // clear, red, green, blue data addesses
 #define TCS_ADDRESS_CLEAR_L 0x14
 #define TCS_ADDRESS_CLEAR_H 0x15
-#define TCS_ADDRESS_RED_L 0x14
-#define TCS_ADDRESS_RED_H 0x15
-#define TCS_ADDRESS_GREEN_L 0x14
-#define TCS_ADDRESS_GREEN_H 0x15
-#define TCS_ADDRESS_BLUE_L 0x14
-#define TCS_ADDRESS_BLUE_H 0x15
+#define TCS_ADDRESS_RED_L 0x16
+#define TCS_ADDRESS_RED_H 0x17
+#define TCS_ADDRESS_GREEN_L 0x18
+#define TCS_ADDRESS_GREEN_H 0x19
+#define TCS_ADDRESS_BLUE_L 0x1a
+#define TCS_ADDRESS_BLUE_H 0x1b
+
+// integration cycle length [us] and maximal number of cycles (ATIME = 0x00)
+#define TCS_CYCLE_US 2400
+#define TCS_CYCLES_MAX 256
+// number of status polls (every quarter of cycle) when data is not valid at expected time
+#define TCS_READY_POLLS 8
+// minimal period of interrupt status polling when INT pin is not connected [us]
+#define TCS_IRQ_POLL_MIN 100000
 
-static bool _l_initialized = false;
-static uint8_t _l_chip_id = 0x0;
+// number of out-of-range cycles for PERS register values
+static const uint8_t _tcs_persistence[16] = {0, 1, 2, 3, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60};
 
 // internal functions forward declaration
 static bool _initiaze_TCS();
+static bool _apply_TCS_config(uint32_t cycles, cenviro_light_gain_t gain);
+static void _auto_range(uint16_t clear, uint64_t valid_ns);
+static uint32_t _integration_cycles(uint32_t integration_us);
+static uint32_t _interrupt_poll_period();
 
 bool cenviro_light_init()
 {
 
-    if (!_cenviro_initialized)
+    if (!_cenviro_ctx->initialized)
     {
         LOG("Library not initialized exiting\n");
         return false;
     }
 
-    if (ioctl(_cenviro_bus_fd, I2C_SLAVE, LIGHT_ADDR) < 0)
+    if (!cenviro_bus_probe(LIGHT_ADDR))
     {
         LOG("Failed to set light sensor address\n");
         return false;
@@ -52,61 +75,110 @@ bool cenviro_light_init()
         return false;
     }
 
-    _l_initialized = true;
     return true;
 }
 
 cenviro_crgb_t cenviro_light_crgb_raw()
 {
+    CENVIRO_PROBE_API();
     cenviro_crgb_t result = {.clear = 0, .red = 0, .green = 0, .blue = 0};
-    if (!_l_initialized)
+    cenviro_light_read(&result, NULL, NULL);
+    return result;
+}
+
+bool cenviro_light_read(cenviro_crgb_t *crgb, uint32_t *integration_us, cenviro_light_gain_t *gain)
+{
+    if (!cenviro_light_ready())
     {
-        // return empty (zeroed) result
-        return result;
+        return false;
     }
-    CENVIRO_LOCK_MUTEX();
-    if (ioctl(_cenviro_bus_fd, I2C_SLAVE, LIGHT_ADDR) < 0)
+
+    uint64_t valid_ns = 0;
+    uint32_t cycle_us = 0;
+    cenviro_light_gain_t cycle_gain = CENVIRO_LIGHT_GAIN_1X;
+    cenviro_light_cycle(&valid_ns, &cycle_us, &cycle_gain);
+
+    // do not read before first integration cycle with current configuration ends
+    uint64_t now = cenviro_monotonic_ns();
+    if (now < valid_ns)
     {
-        LOG("Failed to set light sensor address\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return result;
+        usleep((valid_ns - now) / 1000 + 1);
     }
 
-    ssize_t count = 0;
-
-    // set command
-    _cenviro_buffer[0] = TCS_COMMAND | TCS_AUTOINCREMENT | TCS_ADDRESS_CLEAR_L;
+    uint8_t buffer[LIGHT_BLOCK_LEN];
+    for (int poll = 0;; ++poll)
+    {
+        if (!cenviro_bus_read(LIGHT_ADDR, LIGHT_BLOCK_REG, buffer, LIGHT_BLOCK_LEN))
+        {
+            LOG("Failed to read crgb data\n");
+            return false;
+        }
+        if (buffer[0] & TCS_STATUS_AVALID)
+        {
+            break;
+        }
+        if (poll == TCS_READY_POLLS)
+        {
+            LOG("Light data not ready\n");
+            return false;
+        }
+        usleep(cycle_us / 4);
+    }
 
-    // send config
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    *crgb = cenviro_light_decode(&buffer[1]);
+    // counts come from cycle integrated with settings valid before auto-range step below
+    if (integration_us != NULL)
     {
-        LOG("Failed to send crgb data request\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return result;
+        *integration_us = cycle_us;
+    }
+    if (gain != NULL)
+    {
+        *gain = cycle_gain;
     }
-    usleep(COMMAND_WAIT * 1000);
+    _auto_range(crgb->clear, valid_ns);
+    return true;
+}
+
+void cenviro_light_cycle(uint64_t *valid_ns, uint32_t *integration_us, cenviro_light_gain_t *gain)
+{
+    light_state_t *light = &_cenviro_ctx->light;
+    CENVIRO_LOCK(&light->state_lock);
+    *valid_ns = light->valid_ns;
+    *integration_us = light->cycles * TCS_CYCLE_US;
+    *gain = light->gain;
+    CENVIRO_UNLOCK(&light->state_lock);
+}
 
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 8);
-    if (count != 8)
+bool cenviro_light_decode_status(const uint8_t *block, uint64_t valid_ns, uint64_t timestamp_ns, cenviro_crgb_t *crgb)
+{
+    // counts are valid when first cycle with current configuration ended
+    if (!(block[0] & TCS_STATUS_AVALID) || timestamp_ns < valid_ns)
     {
-        LOG("Failed to read crgb data\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return result;
+        return false;
     }
+    *crgb = cenviro_light_decode(&block[1]);
+    _auto_range(crgb->clear, valid_ns);
+    return true;
+}
 
-    result.clear = ((uint16_t)_cenviro_buffer[1]) << 8 | _cenviro_buffer[0];
-    result.red = ((uint16_t)_cenviro_buffer[3]) << 8 | _cenviro_buffer[2];
-    result.green = ((uint16_t)_cenviro_buffer[5]) << 8 | _cenviro_buffer[4];
-    result.blue = ((uint16_t)_cenviro_buffer[7]) << 8 | _cenviro_buffer[6];
+bool cenviro_light_ready()
+{
+    return cenviro_module_ready(CENVIRO_MODULE_LIGHT);
+}
 
-    // now result should have necessary data
-    CENVIRO_UNLOCK_MUTEX();
+cenviro_crgb_t cenviro_light_decode(const uint8_t *block)
+{
+    cenviro_crgb_t result;
+    result.clear = ((uint16_t)block[1]) << 8 | block[0];
+    result.red = ((uint16_t)block[3]) << 8 | block[2];
+    result.green = ((uint16_t)block[5]) << 8 | block[4];
+    result.blue = ((uint16_t)block[7]) << 8 | block[6];
     return result;
 }
 
 cenviro_crgb_t cenviro_light_crgb_scaled()
 {
+    CENVIRO_PROBE_API();
     cenviro_crgb_t result = cenviro_light_crgb_raw();
     if (result.clear == 0)
     {
@@ -122,16 +194,20 @@ cenviro_crgb_t cenviro_light_crgb_scaled()
 
 uint8_t cenviro_light_chip_id()
 {
-    if (!_l_initialized)
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    if (!cenviro_light_ready())
     {
         return 0x00;
     }
-    return _l_chip_id;
+    return light->chip_id;
 }
 
 const char *cenviro_light_chip_name()
 {
-    switch (_l_chip_id)
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    switch (light->chip_id)
     {
     case 0x44:
         return "TCS34725";
@@ -144,41 +220,311 @@ const char *cenviro_light_chip_name()
     }
 }
 
-bool _initiaze_TCS()
+bool cenviro_light_configure(const cenviro_light_config_t *config)
 {
-#define ENABLE_DATA 0x03
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    if (config == NULL || config->gain > CENVIRO_LIGHT_GAIN_60X || config->integration_us == 0 ||
+        config->integration_us > TCS_CYCLES_MAX * TCS_CYCLE_US)
+    {
+        LOG("Invalid light configuration\n");
+        return false;
+    }
 
-    _cenviro_buffer[0] = TCS_COMMAND | TCS_ADDRESS_ENABLE;
-    _cenviro_buffer[1] = ENABLE_DATA;
+    // gain and integration time are written only to initialized TCS3472 - until library init they wait for it
+    bool ready = cenviro_light_ready();
+    CENVIRO_LOCK(&light->state_lock);
+    if (ready && !_apply_TCS_config(_integration_cycles(config->integration_us), config->gain))
+    {
+        CENVIRO_UNLOCK(&light->state_lock);
+        return false;
+    }
+    light->config = *config;
+    light->cycles = _integration_cycles(config->integration_us);
+    light->gain = config->gain;
+    CENVIRO_UNLOCK(&light->state_lock);
+    return true;
+}
 
-    ssize_t count = 0;
+cenviro_light_config_t cenviro_light_config()
+{
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    CENVIRO_LOCK(&light->state_lock);
+    cenviro_light_config_t config = light->config;
+    config.integration_us = light->cycles * TCS_CYCLE_US;
+    config.gain = light->gain;
+    CENVIRO_UNLOCK(&light->state_lock);
+    return config;
+}
 
-    // send config
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 2);
-    if (count != 2)
+uint32_t cenviro_light_cycle_us()
+{
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    CENVIRO_LOCK(&light->state_lock);
+    uint32_t cycle_us = light->cycles * TCS_CYCLE_US;
+    CENVIRO_UNLOCK(&light->state_lock);
+    return cycle_us;
+}
+
+bool cenviro_light_set_thresholds(uint16_t low, uint16_t high, uint8_t persistence)
+{
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    if (low > high || persistence > 60)
     {
-        LOG("Failed to write config\n");
+        LOG("Invalid light thresholds\n");
         return false;
     }
-    usleep(COMMAND_WAIT * 1000);
+    if (!cenviro_light_ready())
+    {
+        return false;
+    }
+
+    uint8_t pers = 0;
+    while (_tcs_persistence[pers] < persistence)
+    {
+        ++pers;
+    }
+    uint8_t thresholds[5] = {TCS_COMMAND | TCS_AUTOINCREMENT | TCS_ADDRESS_AILTL, low & 0xff, low >> 8, high & 0xff, high >> 8};
+    uint8_t filter[2] = {TCS_COMMAND | TCS_ADDRESS_PERS, pers};
+    uint8_t clear = TCS_COMMAND | TCS_SPECIAL_INT_CLEAR;
+    uint8_t enable[2] = {TCS_COMMAND | TCS_ADDRESS_ENABLE, TCS_ENABLE_PON | TCS_ENABLE_AEN | TCS_ENABLE_AIEN};
+    // thresholds, filter, removal of interrupt raised with previous ones and enable in single transaction
+    cenviro_bus_msg_t messages[4] = {
+        {.address = LIGHT_ADDR, .read = false, .length = 5, .data = thresholds},
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = filter},
+        {.address = LIGHT_ADDR, .read = false, .length = 1, .data = &clear},
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = enable}};
 
-    _cenviro_buffer[0] = TCS_COMMAND | TCS_ADDRESS_ID;
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    CENVIRO_LOCK(&light->state_lock);
+    bool status = cenviro_bus_transfer(messages, 4);
+    if (status)
+    {
+        light->interrupt = true;
+        light->persistence = _tcs_persistence[pers];
+    }
+    CENVIRO_UNLOCK(&light->state_lock);
+    if (!status)
+    {
+        LOG("Failed to write light thresholds\n");
+    }
+    return status;
+}
+
+bool cenviro_light_clear_thresholds()
+{
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    if (!cenviro_light_ready())
     {
-        LOG("Failed to write command for chip id\n");
         return false;
     }
-    usleep(COMMAND_WAIT * 1000);
+    uint8_t enable[2] = {TCS_COMMAND | TCS_ADDRESS_ENABLE, TCS_ENABLE_PON | TCS_ENABLE_AEN};
+    uint8_t clear = TCS_COMMAND | TCS_SPECIAL_INT_CLEAR;
+    cenviro_bus_msg_t messages[2] = {
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = enable},
+        {.address = LIGHT_ADDR, .read = false, .length = 1, .data = &clear}};
+
+    CENVIRO_LOCK(&light->state_lock);
+    bool status = cenviro_bus_transfer(messages, 2);
+    if (status)
+    {
+        light->interrupt = false;
+    }
+    CENVIRO_UNLOCK(&light->state_lock);
+    return status;
+}
 
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+int cenviro_light_wait_threshold(int timeout_ms, cenviro_crgb_t *crgb)
+{
+    CENVIRO_PROBE_API();
+    light_state_t *light = &_cenviro_ctx->light;
+    if (!cenviro_light_ready())
     {
-        LOG("Failed to read chip id\n");
+        return -1;
+    }
+    CENVIRO_LOCK(&light->state_lock);
+    bool enabled = light->interrupt;
+    CENVIRO_UNLOCK(&light->state_lock);
+    if (!enabled || cenviro_light_interrupt_fd() < 0)
+    {
+        LOG("Light interrupt not enabled\n");
+        return -1;
+    }
+
+    uint64_t deadline = cenviro_monotonic_ns() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0) * 1000000;
+    while (true)
+    {
+        // interrupt status is latched so it is checked before every wait - no crossing can be missed
+        uint8_t buffer[LIGHT_BLOCK_LEN];
+        if (!cenviro_bus_read(LIGHT_ADDR, LIGHT_BLOCK_REG, buffer, LIGHT_BLOCK_LEN))
+        {
+            LOG("Failed to read light status\n");
+            return -1;
+        }
+        if (buffer[0] & TCS_STATUS_AINT)
+        {
+            uint8_t clear = TCS_COMMAND | TCS_SPECIAL_INT_CLEAR;
+            cenviro_bus_msg_t message = {.address = LIGHT_ADDR, .read = false, .length = 1, .data = &clear};
+            if (!cenviro_bus_transfer(&message, 1))
+            {
+                LOG("Failed to clear light interrupt\n");
+                return -1;
+            }
+            if (crgb != NULL)
+            {
+                *crgb = cenviro_light_decode(&buffer[1]);
+            }
+            return 1;
+        }
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0)
+        {
+            uint64_t now = cenviro_monotonic_ns();
+            if (now >= deadline)
+            {
+                return 0;
+            }
+            wait_ms = (deadline - now + 999999) / 1000000;
+        }
+        if (cenviro_irq_wait(CENVIRO_IRQ_LIGHT, wait_ms) < 0)
+        {
+            return -1;
+        }
+    }
+}
+
+int cenviro_light_interrupt_fd()
+{
+    CENVIRO_PROBE_API();
+    if (!cenviro_light_ready())
+    {
+        return -1;
+    }
+    return cenviro_irq_fd(CENVIRO_IRQ_LIGHT, LIGHT_ADDR, _interrupt_poll_period());
+}
+
+bool _initiaze_TCS()
+{
+    light_state_t *light = &_cenviro_ctx->light;
+    CENVIRO_LOCK(&light->state_lock);
+    // thresholds have to be set again after library initialization
+    light->interrupt = false;
+    bool status = _apply_TCS_config(_integration_cycles(light->config.integration_us), light->config.gain);
+    CENVIRO_UNLOCK(&light->state_lock);
+    if (!status)
+    {
+        LOG("Failed to write config\n");
         return false;
     }
-    _l_chip_id = _cenviro_buffer[0];
+
+    // chip id is already validated when taken from calibration cache
+    if (!cenviro_calcache_get(LIGHT_ADDR, &light->chip_id, NULL, 0))
+    {
+        if (!cenviro_bus_read(LIGHT_ADDR, TCS_COMMAND | TCS_ADDRESS_ID, &light->chip_id, 1))
+        {
+            LOG("Failed to read chip id\n");
+            return false;
+        }
+        cenviro_calcache_put(LIGHT_ADDR, TCS_COMMAND | TCS_ADDRESS_ID, light->chip_id, 0, NULL, 0);
+    }
 
     return true;
-#undef ENABLE_DATA
+}
+
+// program integration time and gain (state lock has to be held) - integration is stopped for the time
+// of change, so first cycle with new configuration starts together with the transaction
+static bool _apply_TCS_config(uint32_t cycles, cenviro_light_gain_t gain)
+{
+    light_state_t *light = &_cenviro_ctx->light;
+    uint8_t disable[2] = {TCS_COMMAND | TCS_ADDRESS_ENABLE, TCS_ENABLE_PON};
+    uint8_t atime[2] = {TCS_COMMAND | TCS_ADDRESS_ATIME, (uint8_t)(TCS_CYCLES_MAX - cycles)};
+    uint8_t control[2] = {TCS_COMMAND | TCS_ADDRESS_CONTROL, (uint8_t)gain};
+    uint8_t enable[2] = {TCS_COMMAND | TCS_ADDRESS_ENABLE, TCS_ENABLE_PON | TCS_ENABLE_AEN | (light->interrupt ? TCS_ENABLE_AIEN : 0)};
+    cenviro_bus_msg_t messages[4] = {
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = disable},
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = atime},
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = control},
+        {.address = LIGHT_ADDR, .read = false, .length = 2, .data = enable}};
+
+    if (!cenviro_bus_transfer(messages, 4))
+    {
+        LOG("Failed to write integration time and gain\n");
+        return false;
+    }
+    light->cycles = cycles;
+    light->gain = gain;
+    light->valid_ns = cenviro_monotonic_ns() + (uint64_t)cycles * TCS_CYCLE_US * 1000;
+    return true;
+}
+
+// single auto-range step based on clear channel counts: gain is raised before integration time
+// (the shortest integration that is not starved is kept) and lowered after it
+static void _auto_range(uint16_t clear, uint64_t valid_ns)
+{
+    light_state_t *light = &_cenviro_ctx->light;
+    CENVIRO_LOCK(&light->state_lock);
+    if (!light->config.auto_range || valid_ns != light->valid_ns)
+    {
+        // disabled or other reader already changed configuration based on the same cycle
+        CENVIRO_UNLOCK(&light->state_lock);
+        return;
+    }
+
+    uint32_t min_cycles = _integration_cycles(light->config.integration_us);
+    uint32_t cycles = light->cycles;
+    cenviro_light_gain_t gain = light->gain;
+    // analog saturation is 1024 counts per cycle, digital one is 16-bit register
+    uint32_t saturation = (cycles >= 64) ? 0xffff : cycles * 1024;
+
+    if (clear >= saturation * 9 / 10)
+    {
+        if (cycles > min_cycles)
+        {
+            cycles = (cycles / 2 > min_cycles) ? cycles / 2 : min_cycles;
+        }
+        else if (gain > CENVIRO_LIGHT_GAIN_1X)
+        {
+            --gain;
+        }
+    }
+    else if (clear < saturation / 8)
+    {
+        if (gain < CENVIRO_LIGHT_GAIN_60X)
+        {
+            ++gain;
+        }
+        else if (cycles < TCS_CYCLES_MAX)
+        {
+            cycles = (cycles * 2 < TCS_CYCLES_MAX) ? cycles * 2 : TCS_CYCLES_MAX;
+        }
+    }
+    if ((cycles != light->cycles || gain != light->gain) && !_apply_TCS_config(cycles, gain))
+    {
+        LOG("Auto-range step failed\n");
+    }
+    CENVIRO_UNLOCK(&light->state_lock);
+}
+
+// interrupt cannot be raised more often than once per 'persistence' cycles
+static uint32_t _interrupt_poll_period()
+{
+    light_state_t *light = &_cenviro_ctx->light;
+    CENVIRO_LOCK(&light->state_lock);
+    uint32_t period_us = light->cycles * TCS_CYCLE_US * (light->persistence > 0 ? light->persistence : 1);
+    CENVIRO_UNLOCK(&light->state_lock);
+    return (period_us > TCS_IRQ_POLL_MIN) ? period_us : TCS_IRQ_POLL_MIN;
+}
+
+static uint32_t _integration_cycles(uint32_t integration_us)
+{
+    uint32_t cycles = (integration_us + TCS_CYCLE_US / 2) / TCS_CYCLE_US;
+    if (cycles == 0)
+    {
+        return 1;
+    }
+    return (cycles > TCS_CYCLES_MAX) ? TCS_CYCLES_MAX : cycles;
 }
@@ -0,0 +1,645 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cenviro.h"
+#include "internal.h"
+#include "logs.h"
+
+// Logging: calling thread only packs record (format pointer, raw argument values, copied strings) into its own
+// single-producer ring - formatting is done when rings are drained (by background thread or cenviro_log_flush()),
+// records of all threads are merged by timestamp and passed to sink. Writer never waits: when its ring is full
+// record is dropped and counted. Rings are never freed - ring of finished thread is taken by the next new one.
+// Thread unsafe version has no draining thread and passes messages to sink at once.
+
+#define LOG_RING_SIZE 256 // power of two
+#define LOG_ARGS_MAX 8
+#define LOG_TEXT_MAX 48
+#define LOG_MESSAGE_MAX 256
+#define LOG_SPEC_MAX 32
+#define LOG_DRAIN_PERIOD_MS 20
+#define CACHE_LINE 64
+
+#ifdef DEBUG
+cenviro_log_level_t _cenviro_log_level = CENVIRO_LOG_DEBUG;
+#else
+cenviro_log_level_t _cenviro_log_level = CENVIRO_LOG_ERROR;
+#endif
+
+typedef enum
+{
+    ARG_NONE = 0,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_POINTER,
+    ARG_STRING
+} log_arg_t;
+
+// printf conversion specification
+typedef struct
+{
+    size_t length; // '%' included
+    unsigned stars; // '*' width and precision taken from arguments
+    log_arg_t type;
+    bool is_signed;
+} log_spec_t;
+
+typedef struct
+{
+    uint64_t timestamp_ns;
+    const char *format;
+    uint8_t level;
+    uint8_t argc;
+    uint64_t args[LOG_ARGS_MAX]; // raw values (doubles as bit patterns, strings as offsets in text)
+    char text[LOG_TEXT_MAX];
+} log_record_t;
+
+static const char *_log_level_names[] = {"none", "error", "warning", "info", "debug"};
+
+static cenviro_log_sink_t _log_sink = NULL;
+static void *_log_sink_context = NULL;
+
+static bool _log_spec(const char *start, log_spec_t *spec);
+static void _log_pack(log_record_t *record, cenviro_log_level_t level, const char *format, va_list arguments);
+static void _log_render(const log_record_t *record, char *message, size_t size);
+static void _log_emit(cenviro_log_level_t level, uint64_t timestamp_ns, const char *message);
+
+void cenviro_log_set_level(cenviro_log_level_t level)
+{
+    CENVIRO_PROBE_API();
+    if (level > CENVIRO_LOG_DEBUG)
+    {
+        level = CENVIRO_LOG_DEBUG;
+    }
+    __atomic_store_n(&_cenviro_log_level, level, __ATOMIC_RELAXED);
+}
+
+cenviro_log_level_t cenviro_log_level()
+{
+    CENVIRO_PROBE_API();
+    return __atomic_load_n(&_cenviro_log_level, __ATOMIC_RELAXED);
+}
+
+// parses conversion specification starting at '%' ("%%" has no argument), false - unsupported specification
+static bool _log_spec(const char *start, log_spec_t *spec)
+{
+    const char *p = start + 1;
+    spec->stars = 0;
+    spec->type = ARG_NONE;
+    spec->is_signed = false;
+
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL)
+    {
+        ++p;
+    }
+    if (*p == '*')
+    {
+        spec->stars++;
+        ++p;
+    }
+    while (isdigit((unsigned char)*p))
+    {
+        ++p;
+    }
+    if (*p == '.')
+    {
+        ++p;
+        if (*p == '*')
+        {
+            spec->stars++;
+            ++p;
+        }
+        while (isdigit((unsigned char)*p))
+        {
+            ++p;
+        }
+    }
+
+    char modifier = '\0';
+    int longs = 0;
+    while (*p != '\0' && strchr("hlzjtL", *p) != NULL)
+    {
+        longs += (*p == 'l');
+        modifier = *p;
+        ++p;
+    }
+
+    spec->length = p + 1 - start;
+    switch (*p)
+    {
+    case '%':
+        return spec->stars == 0;
+    case 'd':
+    case 'i':
+        spec->is_signed = true;
+        // fall through
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'c':
+        spec->type = (longs >= 2) ? ARG_LLONG : (longs == 1) ? ARG_LONG : ARG_INT;
+        spec->type = (modifier == 'z') ? ARG_SIZE : (modifier == 'j') ? ARG_INTMAX : spec->type;
+        spec->type = (modifier == 't') ? ARG_PTRDIFF : spec->type;
+        return true;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->type = (modifier == 'L') ? ARG_LDOUBLE : ARG_DOUBLE;
+        return true;
+    case 'p':
+        spec->type = ARG_POINTER;
+        return true;
+    case 's':
+        spec->type = ARG_STRING;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// arguments are stored as raw values - no conversion to text in calling thread
+static void _log_pack(log_record_t *record, cenviro_log_level_t level, const char *format, va_list arguments)
+{
+    size_t text_used = 0;
+    record->timestamp_ns = cenviro_monotonic_ns();
+    record->format = format;
+    record->level = level;
+    record->argc = 0;
+
+    for (const char *p = format; *p != '\0'; ++p)
+    {
+        log_spec_t spec;
+        if (*p != '%')
+        {
+            continue;
+        }
+        if (!_log_spec(p, &spec) || record->argc + spec.stars + 1 > LOG_ARGS_MAX)
+        {
+            break;
+        }
+        p += spec.length - 1;
+        if (spec.type == ARG_NONE)
+        {
+            continue;
+        }
+        for (unsigned i = 0; i < spec.stars; ++i)
+        {
+            record->args[record->argc++] = (uint64_t)(int64_t)va_arg(arguments, int);
+        }
+
+        uint64_t value = 0;
+        switch (spec.type)
+        {
+        case ARG_INT:
+            value = (uint64_t)(int64_t)va_arg(arguments, int);
+            break;
+        case ARG_LONG:
+            value = (uint64_t)(int64_t)va_arg(arguments, long);
+            break;
+        case ARG_LLONG:
+            value = (uint64_t)va_arg(arguments, long long);
+            break;
+        case ARG_SIZE:
+            value = (uint64_t)va_arg(arguments, size_t);
+            break;
+        case ARG_INTMAX:
+            value = (uint64_t)va_arg(arguments, intmax_t);
+            break;
+        case ARG_PTRDIFF:
+            value = (uint64_t)(int64_t)va_arg(arguments, ptrdiff_t);
+            break;
+        case ARG_DOUBLE:
+        case ARG_LDOUBLE:
+        {
+            double real = (spec.type == ARG_DOUBLE) ? va_arg(arguments, double) : (double)va_arg(arguments, long double);
+            memcpy(&value, &real, sizeof(value));
+            break;
+        }
+        case ARG_POINTER:
+            value = (uint64_t)(uintptr_t)va_arg(arguments, void *);
+            break;
+        case ARG_STRING:
+        {
+            // strings are truncated to space left in record (last byte is always terminating zero)
+            const char *string = va_arg(arguments, const char *);
+            string = (string != NULL) ? string : "(null)";
+            size_t room = (text_used < LOG_TEXT_MAX - 1) ? LOG_TEXT_MAX - 1 - text_used : 0;
+            size_t length = strlen(string);
+            length = (length < room) ? length : room;
+            value = (room > 0) ? text_used : LOG_TEXT_MAX - 1;
+            memcpy(&record->text[value], string, length);
+            record->text[value + length] = '\0';
+            text_used += (room > 0) ? length + 1 : 0;
+            break;
+        }
+        default:
+            break;
+        }
+        record->args[record->argc++] = value;
+    }
+}
+
+#define LOG_SNPRINTF(value)                                                                                   \
+    ((spec.stars == 0)   ? snprintf(out, room, conversion, value)                                             \
+     : (spec.stars == 1) ? snprintf(out, room, conversion, stars[0], value)                                   \
+                         : snprintf(out, room, conversion, stars[0], stars[1], value))
+
+static void _log_render(const log_record_t *record, char *message, size_t size)
+{
+    size_t position = 0;
+    size_t arg = 0;
+    const char *p = record->format;
+
+    while (*p != '\0' && position < size - 1)
+    {
+        log_spec_t spec;
+        if (*p != '%')
+        {
+            message[position++] = *p++;
+            continue;
+        }
+        if (!_log_spec(p, &spec) || spec.length >= LOG_SPEC_MAX)
+        {
+            break;
+        }
+        if (spec.type == ARG_NONE)
+        {
+            message[position++] = '%';
+            p += spec.length;
+            continue;
+        }
+        // arguments which did not fit in record end the message
+        if (arg + spec.stars + 1 > record->argc)
+        {
+            break;
+        }
+
+        char conversion[LOG_SPEC_MAX];
+        memcpy(conversion, p, spec.length);
+        conversion[spec.length] = '\0';
+        if (spec.type == ARG_LDOUBLE)
+        {
+            // long double is kept as double
+            char *modifier = strchr(conversion, 'L');
+            memmove(modifier, modifier + 1, strlen(modifier));
+        }
+        int stars[2] = {0, 0};
+        for (unsigned i = 0; i < spec.stars; ++i)
+        {
+            stars[i] = (int)(int64_t)record->args[arg++];
+        }
+        uint64_t value = record->args[arg++];
+        char *out = message + position;
+        size_t room = size - position;
+        double real = 0.0;
+        int written = 0;
+
+        switch (spec.type)
+        {
+        case ARG_INT:
+            written = spec.is_signed ? LOG_SNPRINTF((int)(int64_t)value) : LOG_SNPRINTF((unsigned)value);
+            break;
+        case ARG_LONG:
+            written = spec.is_signed ? LOG_SNPRINTF((long)(int64_t)value) : LOG_SNPRINTF((unsigned long)value);
+            break;
+        case ARG_LLONG:
+            written = spec.is_signed ? LOG_SNPRINTF((long long)value) : LOG_SNPRINTF((unsigned long long)value);
+            break;
+        case ARG_SIZE:
+            written = LOG_SNPRINTF((size_t)value);
+            break;
+        case ARG_INTMAX:
+            written = spec.is_signed ? LOG_SNPRINTF((intmax_t)value) : LOG_SNPRINTF((uintmax_t)value);
+            break;
+        case ARG_PTRDIFF:
+            written = LOG_SNPRINTF((ptrdiff_t)(int64_t)value);
+            break;
+        case ARG_DOUBLE:
+        case ARG_LDOUBLE:
+            memcpy(&real, &value, sizeof(real));
+            written = LOG_SNPRINTF(real);
+            break;
+        case ARG_POINTER:
+            written = LOG_SNPRINTF((void *)(uintptr_t)value);
+            break;
+        case ARG_STRING:
+            written = LOG_SNPRINTF(&record->text[value]);
+            break;
+        default:
+            break;
+        }
+        if (written < 0)
+        {
+            break;
+        }
+        position += ((size_t)written < room) ? (size_t)written : room - 1;
+        p += spec.length;
+    }
+    // library messages keep printf convention of ending new line
+    while (position > 0 && message[position - 1] == '\n')
+    {
+        --position;
+    }
+    message[position] = '\0';
+}
+
+static void _log_emit(cenviro_log_level_t level, uint64_t timestamp_ns, const char *message)
+{
+    if (_log_sink != NULL)
+    {
+        _log_sink(level, timestamp_ns, message, _log_sink_context);
+        return;
+    }
+    fprintf(stderr, "[%llu.%06llu] cenviro %s: %s\n", (unsigned long long)(timestamp_ns / 1000000000ULL),
+            (unsigned long long)(timestamp_ns % 1000000000ULL / 1000), _log_level_names[level], message);
+}
+
+#ifndef DISABLE_THREADSAFE
+
+typedef struct log_ring
+{
+    struct log_ring *next;
+    bool owned;
+    uint64_t dropped;
+    uint32_t head __attribute__((aligned(CACHE_LINE))); // written by owner thread only
+    uint32_t tail __attribute__((aligned(CACHE_LINE))); // written by draining side only
+    log_record_t records[LOG_RING_SIZE];
+} log_ring_t;
+
+static __thread log_ring_t *_log_ring = NULL;
+static log_ring_t *_log_rings = NULL;
+static pthread_key_t _log_ring_key;
+static pthread_once_t _log_ring_once = PTHREAD_ONCE_INIT;
+
+// draining side (thread and cenviro_log_flush()) and sink
+static pthread_mutex_t _log_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t _log_thread;
+static bool _log_running = false;
+static bool _log_stop = false;
+// initialized library contexts - drain thread is shared by all of them
+static unsigned _log_users = 0;
+static pthread_mutex_t _log_thread_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _log_wakeup;
+
+// ring is released when its thread finishes - records left in it are still drained
+static void _log_ring_release(void *ring)
+{
+    __atomic_store_n(&((log_ring_t *)ring)->owned, false, __ATOMIC_RELEASE);
+}
+
+static void _log_ring_key_create()
+{
+    pthread_key_create(&_log_ring_key, _log_ring_release);
+}
+
+static log_ring_t *_log_thread_ring()
+{
+    if (_log_ring != NULL)
+    {
+        return _log_ring;
+    }
+    pthread_once(&_log_ring_once, _log_ring_key_create);
+
+    log_ring_t *ring = __atomic_load_n(&_log_rings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next)
+    {
+        bool owned = false;
+        if (__atomic_compare_exchange_n(&ring->owned, &owned, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+    if (ring == NULL)
+    {
+        void *memory = NULL;
+        if (posix_memalign(&memory, CACHE_LINE, sizeof(log_ring_t)) != 0)
+        {
+            return NULL;
+        }
+        ring = memory;
+        memset(ring, 0, sizeof(*ring));
+        ring->owned = true;
+        ring->next = __atomic_load_n(&_log_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&_log_rings, &ring->next, ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+        }
+    }
+    pthread_setspecific(_log_ring_key, ring);
+    _log_ring = ring;
+    return ring;
+}
+
+void cenviro_log(cenviro_log_level_t level, const char *format, ...)
+{
+    CENVIRO_PROBE_API();
+    if (format == NULL || level == CENVIRO_LOG_NONE || level > __atomic_load_n(&_cenviro_log_level, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    log_ring_t *ring = _log_thread_ring();
+    if (ring == NULL)
+    {
+        return;
+    }
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE)
+    {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    va_list arguments;
+    va_start(arguments, format);
+    _log_pack(&ring->records[head & (LOG_RING_SIZE - 1)], level, format, arguments);
+    va_end(arguments);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// records of all rings are passed to sink in timestamp order, has to be called with drain lock held
+static void _log_drain()
+{
+    char message[LOG_MESSAGE_MAX];
+    while (true)
+    {
+        log_ring_t *oldest = NULL;
+        for (log_ring_t *ring = __atomic_load_n(&_log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+        {
+            uint32_t tail = ring->tail;
+            if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+            {
+                continue;
+            }
+            if (oldest == NULL || ring->records[tail & (LOG_RING_SIZE - 1)].timestamp_ns <
+                                      oldest->records[oldest->tail & (LOG_RING_SIZE - 1)].timestamp_ns)
+            {
+                oldest = ring;
+            }
+        }
+        if (oldest == NULL)
+        {
+            break;
+        }
+        const log_record_t *record = &oldest->records[oldest->tail & (LOG_RING_SIZE - 1)];
+        _log_render(record, message, sizeof(message));
+        _log_emit(record->level, record->timestamp_ns, message);
+        __atomic_store_n(&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
+    }
+
+    uint64_t dropped = 0;
+    for (log_ring_t *ring = __atomic_load_n(&_log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+        dropped += __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    }
+    if (dropped > 0)
+    {
+        snprintf(message, sizeof(message), "%llu log messages dropped (ring full)", (unsigned long long)dropped);
+        _log_emit(CENVIRO_LOG_WARNING, cenviro_monotonic_ns(), message);
+    }
+}
+
+void cenviro_log_flush()
+{
+    CENVIRO_PROBE_API();
+    pthread_mutex_lock(&_log_drain_lock);
+    _log_drain();
+    pthread_mutex_unlock(&_log_drain_lock);
+}
+
+void cenviro_log_set_sink(cenviro_log_sink_t sink, void *context)
+{
+    CENVIRO_PROBE_API();
+    // messages recorded so far go to previous sink
+    pthread_mutex_lock(&_log_drain_lock);
+    _log_drain();
+    _log_sink = sink;
+    _log_sink_context = context;
+    pthread_mutex_unlock(&_log_drain_lock);
+}
+
+static void *_log_main(void *params)
+{
+    pthread_mutex_lock(&_log_thread_lock);
+    while (!_log_stop)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        until.tv_nsec += LOG_DRAIN_PERIOD_MS * 1000000L;
+        until.tv_sec += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&_log_wakeup, &_log_thread_lock, &until);
+        pthread_mutex_unlock(&_log_thread_lock);
+
+        cenviro_log_flush();
+
+        pthread_mutex_lock(&_log_thread_lock);
+    }
+    pthread_mutex_unlock(&_log_thread_lock);
+    return NULL;
+}
+
+void cenviro_log_start()
+{
+    pthread_mutex_lock(&_log_thread_lock);
+    ++_log_users;
+    if (_log_running)
+    {
+        pthread_mutex_unlock(&_log_thread_lock);
+        return;
+    }
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&_log_wakeup, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    _log_stop = false;
+    if (pthread_create(&_log_thread, NULL, _log_main, NULL) != 0)
+    {
+        // messages stay in rings until cenviro_log_flush()
+        pthread_cond_destroy(&_log_wakeup);
+        pthread_mutex_unlock(&_log_thread_lock);
+        return;
+    }
+    _log_running = true;
+    pthread_mutex_unlock(&_log_thread_lock);
+}
+
+void cenviro_log_stop()
+{
+    pthread_mutex_lock(&_log_thread_lock);
+    if (_log_users > 0)
+    {
+        --_log_users;
+    }
+    if (_log_running && _log_users == 0)
+    {
+        _log_stop = true;
+        pthread_cond_signal(&_log_wakeup);
+        pthread_mutex_unlock(&_log_thread_lock);
+
+        pthread_join(_log_thread, NULL);
+
+        pthread_mutex_lock(&_log_thread_lock);
+        pthread_cond_destroy(&_log_wakeup);
+        _log_running = false;
+    }
+    pthread_mutex_unlock(&_log_thread_lock);
+    cenviro_log_flush();
+}
+
+#else
+
+void cenviro_log(cenviro_log_level_t level, const char *format, ...)
+{
+    CENVIRO_PROBE_API();
+    if (format == NULL || level == CENVIRO_LOG_NONE || level > _cenviro_log_level)
+    {
+        return;
+    }
+    log_record_t record;
+    char message[LOG_MESSAGE_MAX];
+    va_list arguments;
+    va_start(arguments, format);
+    _log_pack(&record, level, format, arguments);
+    va_end(arguments);
+    _log_render(&record, message, sizeof(message));
+    _log_emit(level, record.timestamp_ns, message);
+}
+
+void cenviro_log_flush()
+{
+    CENVIRO_PROBE_API();
+}
+
+void cenviro_log_set_sink(cenviro_log_sink_t sink, void *context)
+{
+    CENVIRO_PROBE_API();
+    _log_sink = sink;
+    _log_sink_context = context;
+}
+
+void cenviro_log_start()
+{
+}
+
+void cenviro_log_stop()
+{
+}
+
+#endif // DISABLE_THREADSAFE
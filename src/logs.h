@@ -1,12 +1,31 @@
 #ifndef _LOGS_H_
 #define _LOGS_H_
 
-#ifdef DEBUG
-#include <stdio.h>
+#include "cenviro.h"
 
-#define LOG(x) printf(x)
-#else
-#define LOG(x)
-#endif
+// Library diagnostics: level is checked before call, so disabled messages cost single load, enabled ones are
+// stored as binary records (no formatting in calling thread). Most library messages report failure of single
+// operation, so plain LOG() is warning.
 
-#endif // _LOGS_H_
\ No newline at end of file
+extern cenviro_log_level_t _cenviro_log_level;
+
+#define LOG_AT(level, ...)                                                     \
+    do                                                                         \
+    {                                                                          \
+        if ((level) <= __atomic_load_n(&_cenviro_log_level, __ATOMIC_RELAXED)) \
+        {                                                                      \
+            cenviro_log((level), __VA_ARGS__);                                 \
+        }                                                                      \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(CENVIRO_LOG_ERROR, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(CENVIRO_LOG_WARNING, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(CENVIRO_LOG_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(CENVIRO_LOG_DEBUG, __VA_ARGS__)
+#define LOG(...) LOG_WARNING(__VA_ARGS__)
+
+// background draining thread is running while any library context is initialized (calls are counted)
+void cenviro_log_start();
+void cenviro_log_stop();
+
+#endif // _LOGS_H_
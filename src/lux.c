@@ -0,0 +1,189 @@
+#include "cenviro.h"
+#include "internal.h"
+#include "logs.h"
+
+// Lux and correlated colour temperature (TCS3472 DN40 application note):
+//   IR = (R + G + B - C) / 2, X' = X - IR
+//   G'' = R_COEF * R' + G_COEF * G' + B_COEF * B'
+//   CPL = (ATIME_ms * AGAIN) / (GA * DF), lux = G'' / CPL
+//   CCT = CT_COEF * B' / R' + CT_OFFSET
+// Kernels take channels as separate arrays and have no data dependent branches, this file is built
+// with -O3 -fno-trapping-math so floating-point loop is vectorized (conditions are turned into selects).
+// Fixed-point kernel is meant for cores without FPU/SIMD (ARMv6) - per-sample CCT division keeps it scalar.
+
+// open-air (no glass) coefficients
+#define LUX_R_COEF 0.136f
+#define LUX_G_COEF 1.0f
+#define LUX_B_COEF -0.444f
+#define LUX_GA 1
+#define LUX_DF 310
+#define LUX_CT_COEF 3810
+#define LUX_CT_OFFSET 1391
+
+// the same coefficients in 1/1000 units for fixed-point kernel
+#define LUX_R_COEF_M 136
+#define LUX_G_COEF_M 1000
+#define LUX_B_COEF_M -444
+
+// integration cycle length [us] and analog saturation per cycle [counts]
+#define LUX_CYCLE_US 2400
+#define LUX_CYCLE_COUNTS 1024
+
+// samples converted at once from cenviro_crgb_t array
+#define LUX_BLOCK 64
+
+static const uint32_t _lux_gain[4] = {1, 4, 16, 60};
+
+static bool _lux_params_valid(uint32_t integration_us, cenviro_light_gain_t gain);
+static uint32_t _lux_saturation(uint32_t integration_us);
+
+cenviro_lux_t cenviro_light_lux()
+{
+    CENVIRO_PROBE_API();
+    cenviro_lux_t result = {.lux = 0.0f, .cct = 0.0f};
+    cenviro_crgb_t crgb;
+    uint32_t integration_us = 0;
+    cenviro_light_gain_t gain = CENVIRO_LIGHT_GAIN_1X;
+
+    if (!cenviro_light_read(&crgb, &integration_us, &gain))
+    {
+        return result;
+    }
+    return cenviro_light_lux_compute(crgb, integration_us, gain);
+}
+
+cenviro_lux_t cenviro_light_lux_compute(cenviro_crgb_t crgb, uint32_t integration_us, cenviro_light_gain_t gain)
+{
+    CENVIRO_PROBE_API();
+    cenviro_lux_t result = {.lux = 0.0f, .cct = 0.0f};
+    cenviro_light_lux_batch(&crgb.clear, &crgb.red, &crgb.green, &crgb.blue, 1, integration_us, gain, &result.lux, &result.cct);
+    return result;
+}
+
+bool cenviro_light_lux_batch(const uint16_t *restrict clear, const uint16_t *restrict red, const uint16_t *restrict green,
+                             const uint16_t *restrict blue, size_t count, uint32_t integration_us, cenviro_light_gain_t gain,
+                             float *restrict lux, float *restrict cct)
+{
+    CENVIRO_PROBE_API();
+    if (!_lux_params_valid(integration_us, gain) || lux == NULL || cct == NULL)
+    {
+        return false;
+    }
+    // 1 / CPL computed once per batch
+    const float lux_per_count = (float)(LUX_GA * LUX_DF) * 1000.0f / ((float)integration_us * _lux_gain[gain]);
+    const uint32_t saturation = _lux_saturation(integration_us);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        float c = clear[i];
+        float r = red[i];
+        float g = green[i];
+        float b = blue[i];
+        float ir = (r + g + b - c) * 0.5f;
+        float r1 = r - ir;
+        float g1 = g - ir;
+        float b1 = b - ir;
+
+        float value = (LUX_R_COEF * r1 + LUX_G_COEF * g1 + LUX_B_COEF * b1) * lux_per_count;
+        value = (value > 0.0f) ? value : 0.0f;
+        lux[i] = (clear[i] >= saturation) ? -1.0f : value;
+
+        // denominator is replaced (not skipped) for samples without red light to keep loop branchless
+        float divisor = (r1 > 0.0f) ? r1 : 1.0f;
+        float temperature = LUX_CT_COEF * b1 / divisor + LUX_CT_OFFSET;
+        cct[i] = (r1 > 0.0f) ? temperature : 0.0f;
+    }
+    return true;
+}
+
+bool cenviro_light_lux_batch_fixed(const uint16_t *restrict clear, const uint16_t *restrict red, const uint16_t *restrict green,
+                                   const uint16_t *restrict blue, size_t count, uint32_t integration_us,
+                                   cenviro_light_gain_t gain, int32_t *restrict lux_q8, int32_t *restrict cct)
+{
+    CENVIRO_PROBE_API();
+    if (!_lux_params_valid(integration_us, gain) || lux_q8 == NULL || cct == NULL)
+    {
+        return false;
+    }
+    // doubled values are used (no IR halving), so G'' is scaled by 2000 - lux in 1/256 units is
+    // G''x2000 * DF * 1000 * 256 / (2000 * integration_us * gain), multiplier is kept in Q16 to avoid division
+    const uint32_t lux_scale = (uint32_t)(((uint64_t)(LUX_GA * LUX_DF * 128) << 16) / (integration_us * _lux_gain[gain]));
+    const int32_t saturation = (int32_t)_lux_saturation(integration_us);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int32_t c = clear[i];
+        int32_t r = red[i];
+        int32_t g = green[i];
+        int32_t b = blue[i];
+        // 2 * X' = X - (2 * IR - X) fits in 18 bits, weighted sum in 29 bits
+        int32_t ir2 = r + g + b - c;
+        int32_t r2 = 2 * r - ir2;
+        int32_t g2 = 2 * g - ir2;
+        int32_t b2 = 2 * b - ir2;
+
+        int32_t weighted = LUX_R_COEF_M * r2 + LUX_G_COEF_M * g2 + LUX_B_COEF_M * b2;
+        int64_t value = ((int64_t)weighted * lux_scale) >> 16;
+        value = (value > 0) ? value : 0;
+        value = (value < INT32_MAX) ? value : INT32_MAX;
+        lux_q8[i] = (c >= saturation) ? -256 : (int32_t)value;
+
+        int32_t divisor = (r2 > 0) ? r2 : 1;
+        int32_t temperature = LUX_CT_COEF * b2 / divisor + LUX_CT_OFFSET;
+        cct[i] = (r2 > 0) ? temperature : 0;
+    }
+    return true;
+}
+
+bool cenviro_light_lux_batch_crgb(const cenviro_crgb_t *samples, size_t count, uint32_t integration_us,
+                                  cenviro_light_gain_t gain, float *lux, float *cct)
+{
+    CENVIRO_PROBE_API();
+    uint16_t clear[LUX_BLOCK];
+    uint16_t red[LUX_BLOCK];
+    uint16_t green[LUX_BLOCK];
+    uint16_t blue[LUX_BLOCK];
+
+    if (samples == NULL && count > 0)
+    {
+        return false;
+    }
+    for (size_t offset = 0; offset < count; offset += LUX_BLOCK)
+    {
+        size_t length = (count - offset < LUX_BLOCK) ? count - offset : LUX_BLOCK;
+        for (size_t i = 0; i < length; ++i)
+        {
+            clear[i] = samples[offset + i].clear;
+            red[i] = samples[offset + i].red;
+            green[i] = samples[offset + i].green;
+            blue[i] = samples[offset + i].blue;
+        }
+        if (!cenviro_light_lux_batch(clear, red, green, blue, length, integration_us, gain, lux + offset, cct + offset))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool _lux_params_valid(uint32_t integration_us, cenviro_light_gain_t gain)
+{
+    // integration time above 256 cycles is not supported by chip (and keeps fixed-point scale in range)
+    if (integration_us == 0 || integration_us > 256 * LUX_CYCLE_US || gain > CENVIRO_LIGHT_GAIN_60X)
+    {
+        LOG("Invalid lux conversion parameters\n");
+        return false;
+    }
+    return true;
+}
+
+// clear count at which sensor saturates - analog one grows with integration cycles, digital one is 16-bit register
+static uint32_t _lux_saturation(uint32_t integration_us)
+{
+    uint32_t cycles = (integration_us + LUX_CYCLE_US / 2) / LUX_CYCLE_US;
+    if (cycles == 0)
+    {
+        cycles = 1;
+    }
+    return (cycles >= 64) ? 0xffff : cycles * LUX_CYCLE_COUNTS;
+}
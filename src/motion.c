@@ -1,41 +1,86 @@
-#include <linux/i2c-dev.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
+#include <string.h>
 
 #include "cenviro.h"
+#include "context.h"
 #include "internal.h"
 #include "logs.h"
 
 #define LSM_ADDRESS_ID 0x0F
 #define LSM_ADDRESS_TEMP_L 0x05
 #define LSM_ADDRESS_TEMP_H 0x06
+#define LSM_ADDRESS_STATUS_M 0x07
+#define LSM_ADDRESS_OUT_M 0x08
+#define LSM_ADDRESS_OUT_A 0x28
 
+#define LSM_ADDRESS_CTRL_0 0x1F
+#define LSM_ADDRESS_CTRL_1 0x20
+#define LSM_ADDRESS_CTRL_3 0x22
 #define LSM_ADDRESS_CTRL_5 0x24
+#define LSM_ADDRESS_CTRL_7 0x26
+#define LSM_ADDRESS_STATUS_A 0x27
+#define LSM_ADDRESS_FIFO_CTRL 0x2E
+#define LSM_ADDRESS_FIFO_SRC 0x2F
+#define LSM_ADDRESS_IG_CFG1 0x30
+#define LSM_ADDRESS_IG_SRC1 0x31
+#define LSM_ADDRESS_IG_THS1 0x32
 
 #define LSM_VALUE_ID 0x49
 #define LSM_VALUE_TEMP_ENA 0x80
 #define LSM_VALUE_MRES_LOW 0x00
 #define LSM_VALUE_MRES_HIGH 0x60
 #define LSM_VALUE_MODR_25HZ 0x0c
+#define LSM_VALUE_AXES_ENA 0x07
+#define LSM_VALUE_BDU 0x08
+#define LSM_VALUE_MD_CONTINUOUS 0x00
+#define LSM_VALUE_FIFO_EN 0x40
+#define LSM_VALUE_FM_BYPASS 0x00
+#define LSM_VALUE_FM_STREAM 0x40
+#define LSM_VALUE_FIFO_FTH 0x80
+#define LSM_VALUE_FIFO_OVRN 0x40
+#define LSM_VALUE_FIFO_FSS 0x1f
+#define LSM_VALUE_ZYXDA 0x08
+#define LSM_VALUE_LIR1 0x01
+#define LSM_VALUE_HPIS1 0x02
+#define LSM_VALUE_IG_HIGH_XYZ 0x2a // OR of X, Y and Z high events
+#define LSM_VALUE_IG_IA 0x40
 
 #define LSM_VALUE_AUTOINCREMENT 0x80
 
-static bool _m_initialized = false;
-static uint8_t _m_chip_id = 0x0;
+// FIFO depth and bytes per accelerometer sample
+#define LSM_FIFO_SIZE 32
+#define LSM_SAMPLE_LEN 6
+// minimal period of interrupt status polling when INT pins are not connected [us]
+#define LSM_IRQ_POLL_MIN 1000
+
+#define MOTION_INT_ALL (CENVIRO_MOTION_INT_ACCEL_READY | CENVIRO_MOTION_INT_MAG_READY | CENVIRO_MOTION_INT_FIFO_WATERMARK | CENVIRO_MOTION_INT_INERTIAL)
+
+// supported accelerometer data rates [mHz] (AODR values 1-10)
+static const uint32_t _lsm_rates_mhz[10] = {3125, 6250, 12500, 25000, 50000, 100000, 200000, 400000, 800000, 1600000};
+// sensitivity for full scale settings [ug/LSB] and [ugauss/LSB]
+static const uint32_t _lsm_accel_sensitivity[5] = {61, 122, 183, 244, 732};
+static const uint32_t _lsm_mag_sensitivity[4] = {80, 160, 320, 479};
+// accelerometer full scale [g]
+static const uint32_t _lsm_accel_range[5] = {2, 4, 6, 8, 16};
 
 static bool _initialize_LSM();
+static bool _apply_LSM_config(const cenviro_motion_config_t *config);
+static bool _apply_LSM_interrupts(const cenviro_motion_irq_config_t *irq);
+static bool _read_LSM_ctrl0(uint8_t *value);
+static void _interrupt_registers(const cenviro_motion_config_t *config, const cenviro_motion_irq_config_t *irq, uint8_t *control);
+static uint32_t _interrupt_poll_period(cenviro_irq_line_t line);
+static uint8_t _rate_code(uint32_t rate_hz);
+static cenviro_vector_t _decode_vector(const uint8_t *block, uint32_t sensitivity);
 static int16_t _twos_complement(uint16_t input);
 
 bool cenviro_motion_init()
 {
-    if (!_cenviro_initialized)
+    if (!_cenviro_ctx->initialized)
     {
         LOG("Library not initialized exiting\n");
         return false;
     }
 
-    if (ioctl(_cenviro_bus_fd, I2C_SLAVE, MOTION_ADDR) < 0)
+    if (!cenviro_bus_probe(MOTION_ADDR))
     {
         LOG("Failed to set motion sensor address\n");
         return false;
@@ -47,93 +92,499 @@ bool cenviro_motion_init()
         return false;
     }
 
-    _m_initialized = true;
     return true;
 }
 
 double cenviro_motion_temperature()
 {
-    if (!_m_initialized)
-    {
-        // return empty (zeroed) result
-        return 0.0;
-    }
-    CENVIRO_LOCK_MUTEX();
-    if (ioctl(_cenviro_bus_fd, I2C_SLAVE, MOTION_ADDR) < 0)
-    {
-        LOG("Failed to set motion sensor address\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return 0.0;
-    }
+    CENVIRO_PROBE_API();
+    // empty (zeroed) result on failure
+    double temperature = 0.0;
+    cenviro_motion_read_temperature(&temperature);
+    return temperature;
+}
 
-    _cenviro_buffer[0] = LSM_ADDRESS_TEMP_L | LSM_VALUE_AUTOINCREMENT;
-    ssize_t count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+bool cenviro_motion_read_temperature(double *temperature)
+{
+    if (!cenviro_motion_ready())
     {
-        LOG("Failed to set LSM temp data request\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return 0.0;
+        return false;
     }
-    usleep(COMMAND_WAIT * 1000);
+    uint8_t buffer[2];
 
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 2);
-    if (count != 2)
+    if (!cenviro_bus_read(MOTION_ADDR, LSM_ADDRESS_TEMP_L | LSM_VALUE_AUTOINCREMENT, buffer, 2))
     {
         LOG("Failed to read LSM temp data\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return 0.0;
+        return false;
     }
-    uint16_t uitemp = _cenviro_buffer[1] << 8 | _cenviro_buffer[0];
+    *temperature = cenviro_motion_decode_temperature(buffer);
+    return true;
+}
+
+bool cenviro_motion_ready()
+{
+    return cenviro_module_ready(CENVIRO_MODULE_MOTION);
+}
+
+double cenviro_motion_decode_temperature(const uint8_t *block)
+{
+    uint16_t uitemp = block[1] << 8 | block[0];
     int16_t itemp = _twos_complement(uitemp);
 
-    CENVIRO_UNLOCK_MUTEX();
     // TODO: Verify why correct value appears when divided by two?
     return (double)itemp / 2;
 }
 
 uint8_t cenviro_motion_chip_id()
 {
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
 
-    if (!_m_initialized)
+    if (!cenviro_motion_ready())
     {
         return 0x00;
     }
-    return _m_chip_id;
+    return motion->chip_id;
 }
 
-static bool _initialize_LSM()
+cenviro_vector_t cenviro_motion_acceleration()
 {
-    ssize_t count = 0;
-    // configure chip (enable necessary option)
-    _cenviro_buffer[0] = LSM_ADDRESS_CTRL_5;
-    _cenviro_buffer[1] = LSM_VALUE_TEMP_ENA | LSM_VALUE_MRES_HIGH | LSM_VALUE_MODR_25HZ;
+    CENVIRO_PROBE_API();
+    cenviro_vector_t result = {0.0, 0.0, 0.0};
+    uint8_t buffer[MOTION_ACCEL_BLOCK_LEN];
 
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 2);
-    if (count != 2)
+    if (!cenviro_motion_ready())
     {
-        LOG("Failed to write config\n");
+        return result;
+    }
+    if (cenviro_motion_streaming())
+    {
+        LOG("Accelerometer is streaming - use ring buffer\n");
+        return result;
+    }
+    if (!cenviro_bus_read(MOTION_ADDR, MOTION_ACCEL_BLOCK_REG, buffer, MOTION_ACCEL_BLOCK_LEN))
+    {
+        LOG("Failed to read LSM accelerometer data\n");
+        return result;
+    }
+    return cenviro_motion_decode_acceleration(buffer);
+}
+
+cenviro_vector_t cenviro_motion_magnetic()
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    cenviro_vector_t result = {0.0, 0.0, 0.0};
+    uint8_t buffer[6];
+
+    if (!cenviro_motion_ready())
+    {
+        return result;
+    }
+    if (!cenviro_bus_read(MOTION_ADDR, LSM_ADDRESS_OUT_M | LSM_VALUE_AUTOINCREMENT, buffer, 6))
+    {
+        LOG("Failed to read LSM magnetometer data\n");
+        return result;
+    }
+    CENVIRO_LOCK(&motion->state_lock);
+    uint32_t sensitivity = _lsm_mag_sensitivity[motion->config.mag_range];
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return _decode_vector(buffer, sensitivity);
+}
+
+void cenviro_motion_decode(const uint8_t *block, double *temperature, cenviro_vector_t *magnetic)
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    // temperature, STATUS_M, magnetometer axes
+    *temperature = cenviro_motion_decode_temperature(block);
+    CENVIRO_LOCK(&motion->state_lock);
+    uint32_t sensitivity = _lsm_mag_sensitivity[motion->config.mag_range];
+    CENVIRO_UNLOCK(&motion->state_lock);
+    *magnetic = _decode_vector(&block[3], sensitivity);
+}
+
+cenviro_vector_t cenviro_motion_decode_acceleration(const uint8_t *block)
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    uint32_t sensitivity = _lsm_accel_sensitivity[motion->config.accel_range];
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return _decode_vector(block, sensitivity);
+}
+
+bool cenviro_motion_configure(const cenviro_motion_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    if (config == NULL || config->accel_rate_hz == 0 || config->accel_rate_hz > 1600 ||
+        config->accel_range > CENVIRO_ACCEL_RANGE_16G || config->mag_range > CENVIRO_MAG_RANGE_12GAUSS)
+    {
+        LOG("Invalid motion configuration\n");
         return false;
     }
-    usleep(COMMAND_WAIT * 1000);
 
-    // read chip id
-    _cenviro_buffer[0] = LSM_ADDRESS_ID;
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    // initialized library brings LSM303D up here if needed, otherwise configuration is applied by cenviro_motion_init()
+    bool ready = cenviro_motion_ready();
+    CENVIRO_LOCK(&motion->state_lock);
+    if (motion->watermark != 0)
+    {
+        LOG("Motion configuration cannot be changed while streaming\n");
+        CENVIRO_UNLOCK(&motion->state_lock);
+        return false;
+    }
+    if (ready && !_apply_LSM_config(config))
     {
-        LOG("Failed to write command for chip id\n");
+        CENVIRO_UNLOCK(&motion->state_lock);
         return false;
     }
-    usleep(COMMAND_WAIT * 1000);
+    motion->config = *config;
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return true;
+}
+
+cenviro_motion_config_t cenviro_motion_config()
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    cenviro_motion_config_t config = motion->config;
+    CENVIRO_UNLOCK(&motion->state_lock);
+    config.accel_rate_hz = _lsm_rates_mhz[_rate_code(config.accel_rate_hz) - 1] / 1000;
+    return config;
+}
 
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+double cenviro_motion_accel_scale()
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    uint32_t sensitivity = _lsm_accel_sensitivity[motion->config.accel_range];
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return sensitivity / 1000000.0;
+}
+
+bool cenviro_motion_stream_start(uint8_t watermark)
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    if (watermark == 0 || watermark >= LSM_FIFO_SIZE)
+    {
+        LOG("Invalid FIFO watermark\n");
+        return false;
+    }
+    if (!cenviro_motion_ready())
+    {
+        return false;
+    }
+
+    CENVIRO_LOCK(&motion->state_lock);
+    // FIFO is emptied by switching to bypass mode before stream mode is enabled
+    uint8_t bypass[2] = {LSM_ADDRESS_FIFO_CTRL, LSM_VALUE_FM_BYPASS};
+    uint8_t enable[2] = {LSM_ADDRESS_CTRL_0, 0x00};
+    uint8_t stream[2] = {LSM_ADDRESS_FIFO_CTRL, LSM_VALUE_FM_STREAM | watermark};
+    cenviro_bus_msg_t messages[3] = {
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = bypass},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = enable},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = stream}};
+    bool status = _read_LSM_ctrl0(&enable[1]);
+    if (status)
+    {
+        enable[1] |= LSM_VALUE_FIFO_EN;
+        status = cenviro_bus_transfer(messages, 3);
+    }
+    if (status)
+    {
+        motion->watermark = watermark;
+    }
+    CENVIRO_UNLOCK(&motion->state_lock);
+    if (!status)
+    {
+        LOG("Failed to enable accelerometer FIFO\n");
+    }
+    return status;
+}
+
+bool cenviro_motion_stream_stop()
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    if (!cenviro_module_active(CENVIRO_MODULE_MOTION))
     {
-        LOG("Failed to read chip id\n");
         return false;
     }
-    _m_chip_id = _cenviro_buffer[0];
-    if (_m_chip_id != LSM_VALUE_ID)
+    uint8_t bypass[2] = {LSM_ADDRESS_FIFO_CTRL, LSM_VALUE_FM_BYPASS};
+    uint8_t disable[2] = {LSM_ADDRESS_CTRL_0, 0x00};
+    cenviro_bus_msg_t messages[2] = {
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = bypass},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = disable}};
+
+    CENVIRO_LOCK(&motion->state_lock);
+    bool status = _read_LSM_ctrl0(&disable[1]);
+    if (status)
+    {
+        disable[1] &= ~LSM_VALUE_FIFO_EN;
+        status = cenviro_bus_transfer(messages, 2);
+    }
+    if (status)
+    {
+        motion->watermark = 0;
+    }
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return status;
+}
+
+uint32_t cenviro_motion_stream_period_us()
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    uint32_t rate_mhz = _lsm_rates_mhz[_rate_code(motion->config.accel_rate_hz) - 1];
+    uint32_t samples = (motion->watermark != 0) ? motion->watermark : 1;
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return (uint32_t)((uint64_t)samples * 1000000000ULL / rate_mhz);
+}
+
+int cenviro_motion_stream_drain(cenviro_motion_ring_t *ring)
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    if (ring == NULL || ring->samples == NULL || ring->capacity == 0)
+    {
+        return -1;
+    }
+    CENVIRO_LOCK(&motion->state_lock);
+    if (motion->watermark == 0)
+    {
+        LOG("Accelerometer is not streaming\n");
+        CENVIRO_UNLOCK(&motion->state_lock);
+        return -1;
+    }
+
+    uint8_t fifo_src = 0;
+    if (!cenviro_bus_read(MOTION_ADDR, LSM_ADDRESS_FIFO_SRC, &fifo_src, 1))
+    {
+        LOG("Failed to read FIFO status\n");
+        CENVIRO_UNLOCK(&motion->state_lock);
+        return -1;
+    }
+    uint64_t timestamp = cenviro_monotonic_ns();
+    bool overrun = (fifo_src & LSM_VALUE_FIFO_OVRN) != 0;
+    // overrun flag means all slots are filled (level field holds at most 31)
+    uint32_t level = overrun ? LSM_FIFO_SIZE : (fifo_src & LSM_VALUE_FIFO_FSS);
+    if (!(fifo_src & LSM_VALUE_FIFO_FTH) && level < motion->watermark)
+    {
+        CENVIRO_UNLOCK(&motion->state_lock);
+        return 0;
+    }
+
+    // whole FIFO content in single burst - output register address rolls back from OUT_Z_H_A to OUT_X_L_A
+    uint8_t buffer[LSM_FIFO_SIZE * LSM_SAMPLE_LEN];
+    if (!cenviro_bus_read(MOTION_ADDR, MOTION_ACCEL_BLOCK_REG, buffer, level * LSM_SAMPLE_LEN))
+    {
+        LOG("Failed to read FIFO data\n");
+        CENVIRO_UNLOCK(&motion->state_lock);
+        return -1;
+    }
+    CENVIRO_UNLOCK(&motion->state_lock);
+
+    // samples which do not fit into ring are dropped (the newest ones, so stream stays continuous up to the gap)
+    uint64_t used = ring->written - __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE);
+    uint32_t count = (ring->capacity - used < level) ? (uint32_t)(ring->capacity - used) : level;
+    uint64_t first = ring->written;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint8_t *sample = &buffer[i * LSM_SAMPLE_LEN];
+        cenviro_accel_raw_t *slot = &ring->samples[(first + i) % ring->capacity];
+        slot->x = (int16_t)(sample[1] << 8 | sample[0]);
+        slot->y = (int16_t)(sample[3] << 8 | sample[2]);
+        slot->z = (int16_t)(sample[5] << 8 | sample[4]);
+    }
+    if (ring->batches != NULL && ring->batch_capacity != 0)
+    {
+        cenviro_motion_batch_t *batch = &ring->batches[ring->batches_written % ring->batch_capacity];
+        batch->timestamp_ns = timestamp;
+        batch->first = first;
+        batch->count = count;
+        batch->overrun = overrun || count < level;
+        __atomic_store_n(&ring->batches_written, ring->batches_written + 1, __ATOMIC_RELEASE);
+    }
+    ring->dropped += level - count;
+    __atomic_store_n(&ring->written, first + count, __ATOMIC_RELEASE);
+    return (int)count;
+}
+
+bool cenviro_motion_set_interrupts(const cenviro_motion_irq_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    if (config == NULL || (config->int1_sources & ~MOTION_INT_ALL) || (config->int2_sources & ~MOTION_INT_ALL) ||
+        (config->int1_sources & CENVIRO_MOTION_INT_FIFO_WATERMARK))
+    {
+        LOG("Invalid motion interrupt sources\n");
+        return false;
+    }
+    if (((config->int1_sources | config->int2_sources) & CENVIRO_MOTION_INT_INERTIAL) && config->wakeup_threshold_g <= 0.0)
+    {
+        LOG("Invalid wake-up threshold\n");
+        return false;
+    }
+    if (!cenviro_motion_ready())
+    {
+        return false;
+    }
+
+    CENVIRO_LOCK(&motion->state_lock);
+    bool status = _apply_LSM_interrupts(config);
+    if (status)
+    {
+        motion->irq = *config;
+    }
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return status;
+}
+
+bool cenviro_motion_clear_interrupts()
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    cenviro_motion_irq_config_t none = {0};
+    if (!cenviro_motion_ready())
+    {
+        return false;
+    }
+
+    CENVIRO_LOCK(&motion->state_lock);
+    bool status = _apply_LSM_interrupts(&none);
+    if (status)
+    {
+        motion->irq = none;
+    }
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return status;
+}
+
+int cenviro_motion_wait(cenviro_irq_line_t line, int timeout_ms, unsigned *sources)
+{
+    CENVIRO_PROBE_API();
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    if (line != CENVIRO_IRQ_MOTION1 && line != CENVIRO_IRQ_MOTION2)
+    {
+        LOG("Not a motion interrupt line\n");
+        return -1;
+    }
+    if (!cenviro_motion_ready())
+    {
+        return -1;
+    }
+    CENVIRO_LOCK(&motion->state_lock);
+    unsigned enabled = (line == CENVIRO_IRQ_MOTION1) ? motion->irq.int1_sources : motion->irq.int2_sources;
+    CENVIRO_UNLOCK(&motion->state_lock);
+    if (enabled == 0 || cenviro_motion_interrupt_fd(line) < 0)
+    {
+        LOG("Motion interrupt not enabled\n");
+        return -1;
+    }
+
+    // inertial event source is read (and its latch cleared) only by waiter of line it is routed to
+    uint8_t status_m_reg = LSM_ADDRESS_STATUS_M;
+    uint8_t status_a_reg = LSM_ADDRESS_STATUS_A;
+    uint8_t fifo_reg = LSM_ADDRESS_FIFO_SRC | LSM_VALUE_AUTOINCREMENT;
+    uint8_t status_m = 0;
+    uint8_t status_a = 0;
+    uint8_t fifo[3] = {0}; // FIFO_SRC, IG_CFG1, IG_SRC1
+    cenviro_bus_msg_t messages[6] = {
+        {.address = MOTION_ADDR, .read = false, .length = 1, .data = &status_m_reg},
+        {.address = MOTION_ADDR, .read = true, .length = 1, .data = &status_m},
+        {.address = MOTION_ADDR, .read = false, .length = 1, .data = &status_a_reg},
+        {.address = MOTION_ADDR, .read = true, .length = 1, .data = &status_a},
+        {.address = MOTION_ADDR, .read = false, .length = 1, .data = &fifo_reg},
+        {.address = MOTION_ADDR, .read = true, .length = (enabled & CENVIRO_MOTION_INT_INERTIAL) ? 3 : 1, .data = fifo}};
+
+    uint64_t deadline = cenviro_monotonic_ns() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0) * 1000000;
+    while (true)
+    {
+        // all sources are latched or level based so status is checked before every wait - no event can be missed
+        if (!cenviro_bus_transfer(messages, 6))
+        {
+            LOG("Failed to read motion interrupt status\n");
+            return -1;
+        }
+        unsigned active = 0;
+        active |= (status_a & LSM_VALUE_ZYXDA) ? CENVIRO_MOTION_INT_ACCEL_READY : 0;
+        active |= (status_m & LSM_VALUE_ZYXDA) ? CENVIRO_MOTION_INT_MAG_READY : 0;
+        active |= (fifo[0] & LSM_VALUE_FIFO_FTH) ? CENVIRO_MOTION_INT_FIFO_WATERMARK : 0;
+        active |= (fifo[2] & LSM_VALUE_IG_IA) ? CENVIRO_MOTION_INT_INERTIAL : 0;
+        if (active & enabled)
+        {
+            if (sources != NULL)
+            {
+                *sources = active & enabled;
+            }
+            return 1;
+        }
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0)
+        {
+            uint64_t now = cenviro_monotonic_ns();
+            if (now >= deadline)
+            {
+                return 0;
+            }
+            wait_ms = (deadline - now + 999999) / 1000000;
+        }
+        if (cenviro_irq_wait(line, wait_ms) < 0)
+        {
+            return -1;
+        }
+    }
+}
+
+int cenviro_motion_interrupt_fd(cenviro_irq_line_t line)
+{
+    CENVIRO_PROBE_API();
+    if ((line != CENVIRO_IRQ_MOTION1 && line != CENVIRO_IRQ_MOTION2) || !cenviro_motion_ready())
+    {
+        return -1;
+    }
+    return cenviro_irq_fd(line, MOTION_ADDR, _interrupt_poll_period(line));
+}
+
+bool cenviro_motion_streaming()
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    bool streaming = motion->watermark != 0;
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return streaming;
+}
+
+static bool _initialize_LSM()
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    // streaming and interrupts have to be started again after library initialization
+    motion->watermark = 0;
+    memset(&motion->irq, 0, sizeof(motion->irq));
+    bool status = _apply_LSM_config(&motion->config);
+    CENVIRO_UNLOCK(&motion->state_lock);
+    if (!status)
+    {
+        LOG("Failed to write config\n");
+        return false;
+    }
+
+    // read chip id (already validated when taken from calibration cache)
+    if (!cenviro_calcache_get(MOTION_ADDR, &motion->chip_id, NULL, 0))
+    {
+        if (!cenviro_bus_read(MOTION_ADDR, LSM_ADDRESS_ID, &motion->chip_id, 1))
+        {
+            LOG("Failed to read chip id\n");
+            return false;
+        }
+        cenviro_calcache_put(MOTION_ADDR, LSM_ADDRESS_ID, motion->chip_id, 0, NULL, 0);
+    }
+    if (motion->chip_id != LSM_VALUE_ID)
     {
         LOG("Invalid chip id read from device\n");
         return false;
@@ -141,6 +592,163 @@ static bool _initialize_LSM()
     return true;
 }
 
+// all control registers (CTRL0 - FIFO disabled, CTRL1 - CTRL7) and inertial event settings (state lock has
+// to be held) written in single transaction
+static bool _apply_LSM_config(const cenviro_motion_config_t *config)
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    uint8_t fifo[2] = {LSM_ADDRESS_FIFO_CTRL, LSM_VALUE_FM_BYPASS};
+    uint8_t interrupts[9];
+    _interrupt_registers(config, &motion->irq, interrupts);
+    uint8_t ctrl0 = 0;
+    if (!_read_LSM_ctrl0(&ctrl0))
+    {
+        return false;
+    }
+    uint8_t control[9] = {
+        LSM_ADDRESS_CTRL_0 | LSM_VALUE_AUTOINCREMENT,
+        (uint8_t)((ctrl0 & ~(LSM_VALUE_FIFO_EN | LSM_VALUE_HPIS1)) | interrupts[7]),
+        (uint8_t)(_rate_code(config->accel_rate_hz) << 4 | LSM_VALUE_BDU | LSM_VALUE_AXES_ENA),
+        (uint8_t)(config->accel_range << 3),
+        interrupts[0],
+        interrupts[1],
+        interrupts[2],
+        (uint8_t)(config->mag_range << 5),
+        interrupts[3]};
+    uint8_t generator[2] = {LSM_ADDRESS_IG_CFG1, interrupts[4]};
+    uint8_t threshold[3] = {LSM_ADDRESS_IG_THS1 | LSM_VALUE_AUTOINCREMENT, interrupts[5], interrupts[6]};
+    cenviro_bus_msg_t messages[4] = {
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = fifo},
+        {.address = MOTION_ADDR, .read = false, .length = 9, .data = control},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = generator},
+        {.address = MOTION_ADDR, .read = false, .length = 3, .data = threshold}};
+
+    if (!cenviro_bus_transfer(messages, 4))
+    {
+        LOG("Failed to write motion configuration\n");
+        return false;
+    }
+    return true;
+}
+
+// interrupt routing, inertial generator settings and latched event removal in single transaction (state lock has to be held)
+static bool _apply_LSM_interrupts(const cenviro_motion_irq_config_t *irq)
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    uint8_t interrupts[9];
+    _interrupt_registers(&motion->config, irq, interrupts);
+    // CTRL0 keeps FIFO state of running stream
+    uint8_t ctrl0[2] = {LSM_ADDRESS_CTRL_0, 0x00};
+    if (!_read_LSM_ctrl0(&ctrl0[1]))
+    {
+        return false;
+    }
+    ctrl0[1] = (ctrl0[1] & ~LSM_VALUE_HPIS1) | interrupts[7];
+    uint8_t route[3] = {LSM_ADDRESS_CTRL_3 | LSM_VALUE_AUTOINCREMENT, interrupts[0], interrupts[1]};
+    uint8_t ctrl5[2] = {LSM_ADDRESS_CTRL_5, interrupts[2]};
+    uint8_t ctrl7[2] = {LSM_ADDRESS_CTRL_7, interrupts[3]};
+    uint8_t generator[2] = {LSM_ADDRESS_IG_CFG1, interrupts[4]};
+    uint8_t threshold[3] = {LSM_ADDRESS_IG_THS1 | LSM_VALUE_AUTOINCREMENT, interrupts[5], interrupts[6]};
+    uint8_t source_reg = LSM_ADDRESS_IG_SRC1;
+    uint8_t source = 0;
+    cenviro_bus_msg_t messages[8] = {
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = ctrl0},
+        {.address = MOTION_ADDR, .read = false, .length = 3, .data = route},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = ctrl5},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = ctrl7},
+        {.address = MOTION_ADDR, .read = false, .length = 2, .data = generator},
+        {.address = MOTION_ADDR, .read = false, .length = 3, .data = threshold},
+        {.address = MOTION_ADDR, .read = false, .length = 1, .data = &source_reg},
+        {.address = MOTION_ADDR, .read = true, .length = 1, .data = &source}};
+
+    if (!cenviro_bus_transfer(messages, 8))
+    {
+        LOG("Failed to write motion interrupt configuration\n");
+        return false;
+    }
+    return true;
+}
+
+// register values: CTRL3, CTRL4, CTRL5, CTRL7, IG_CFG1, IG_THS1, IG_DUR1 and CTRL0 filter bits
+static void _interrupt_registers(const cenviro_motion_config_t *config, const cenviro_motion_irq_config_t *irq, uint8_t *control)
+{
+    unsigned sources[2] = {irq->int1_sources, irq->int2_sources};
+    // INT1 (CTRL3) and INT2 (CTRL4) bits of accelerometer ready, magnetometer ready, watermark and inertial event
+    // (order of CENVIRO_MOTION_INT_* bits, watermark cannot be routed to INT1)
+    static const uint8_t bits[2][4] = {{0x04, 0x02, 0x00, 0x20}, {0x08, 0x04, 0x01, 0x40}};
+    for (int output = 0; output < 2; ++output)
+    {
+        control[output] = 0;
+        for (int source = 0; source < 4; ++source)
+        {
+            if (sources[output] & (1u << source))
+            {
+                control[output] |= bits[output][source];
+            }
+        }
+    }
+
+    bool inertial = ((sources[0] | sources[1]) & CENVIRO_MOTION_INT_INERTIAL) != 0;
+    // inertial event is latched and detected on high-pass filtered data, so gravity does not count as motion -
+    // filter is enabled for interrupt generator 1 only (CTRL7 AFDS would filter output registers and FIFO as well)
+    control[2] = LSM_VALUE_TEMP_ENA | LSM_VALUE_MRES_HIGH | LSM_VALUE_MODR_25HZ | (inertial ? LSM_VALUE_LIR1 : 0);
+    control[3] = LSM_VALUE_MD_CONTINUOUS;
+    control[4] = inertial ? LSM_VALUE_IG_HIGH_XYZ : 0x00;
+
+    double step = _lsm_accel_range[config->accel_range] / 128.0;
+    uint32_t steps = (uint32_t)(irq->wakeup_threshold_g / step + 0.5);
+    control[5] = inertial ? (steps < 1 ? 1 : (steps > 127 ? 127 : steps)) : 0;
+    uint64_t samples = (uint64_t)irq->wakeup_duration_ms * _lsm_rates_mhz[_rate_code(config->accel_rate_hz) - 1] / 1000000;
+    control[6] = inertial ? (samples > 127 ? 127 : samples) : 0;
+    control[7] = inertial ? LSM_VALUE_HPIS1 : 0x00;
+}
+
+// current CTRL0 value (FIFO enable and interrupt filter bits are changed independently)
+static bool _read_LSM_ctrl0(uint8_t *value)
+{
+    if (!cenviro_bus_read(MOTION_ADDR, LSM_ADDRESS_CTRL_0, value, 1))
+    {
+        LOG("Failed to read motion CTRL0 register\n");
+        return false;
+    }
+    return true;
+}
+
+// interrupt cannot be raised more often than once per accelerometer sample (watermark - once per batch)
+static uint32_t _interrupt_poll_period(cenviro_irq_line_t line)
+{
+    motion_state_t *motion = &_cenviro_ctx->motion;
+    CENVIRO_LOCK(&motion->state_lock);
+    unsigned sources = (line == CENVIRO_IRQ_MOTION1) ? motion->irq.int1_sources : motion->irq.int2_sources;
+    uint32_t period_us = 1000000000ULL / _lsm_rates_mhz[_rate_code(motion->config.accel_rate_hz) - 1];
+    if (sources == CENVIRO_MOTION_INT_FIFO_WATERMARK && motion->watermark != 0)
+    {
+        period_us *= motion->watermark;
+    }
+    CENVIRO_UNLOCK(&motion->state_lock);
+    return (period_us > LSM_IRQ_POLL_MIN) ? period_us : LSM_IRQ_POLL_MIN;
+}
+
+// AODR value of the lowest supported rate not lower than requested one
+static uint8_t _rate_code(uint32_t rate_hz)
+{
+    uint8_t code = 1;
+    while (code < 10 && _lsm_rates_mhz[code - 1] < rate_hz * 1000)
+    {
+        ++code;
+    }
+    return code;
+}
+
+static cenviro_vector_t _decode_vector(const uint8_t *block, uint32_t sensitivity)
+{
+    cenviro_vector_t result;
+    result.x = (int16_t)(block[1] << 8 | block[0]) * (sensitivity / 1000000.0);
+    result.y = (int16_t)(block[3] << 8 | block[2]) * (sensitivity / 1000000.0);
+    result.z = (int16_t)(block[5] << 8 | block[4]) * (sensitivity / 1000000.0);
+    return result;
+}
+
 static int16_t _twos_complement(uint16_t input)
 {
     // computation for 12-bit value (like temperature from motion sensor)
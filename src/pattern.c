@@ -0,0 +1,453 @@
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// LED pattern player: dedicated thread sleeps on single timerfd armed with absolute deadlines (next deadline
+// is computed from previous one, not from wakeup time, so pattern does not drift). Commands (new pattern, stop)
+// are passed under lock and timer is armed to expire immediately to wake the thread up.
+
+#define MORSE_DOT 1
+#define MORSE_DASH 3
+#define MORSE_LETTER_GAP 3
+#define MORSE_WORD_GAP 7
+
+// heartbeat pulse length and second pulse start (Linux heartbeat LED trigger timing)
+#define HEARTBEAT_PULSE_MS 70
+#define HEARTBEAT_PERIOD_MIN_MS 400
+
+#define PWM_FREQUENCY_MAX 1000
+
+static const char *_morse_letters[26] = {".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---",
+                                         "-.-", ".-..", "--", "-.", "---", ".--.", "--.-", ".-.", "...", "-",
+                                         "..-", "...-", ".--", "-..-", "-.--", "--.."};
+static const char *_morse_digits[10] = {"-----", ".----", "..---", "...--", "....-",
+                                        ".....", "-....", "--...", "---..", "----."};
+
+static bool _pattern_append(cenviro_led_pattern_t *pattern, bool on, uint32_t duration_us);
+
+bool cenviro_led_pattern_morse(cenviro_led_pattern_t *pattern, const char *text, uint32_t unit_ms)
+{
+    CENVIRO_PROBE_API();
+    if (pattern == NULL || text == NULL || unit_ms == 0)
+    {
+        return false;
+    }
+    memset(pattern, 0, sizeof(*pattern));
+    uint32_t unit_us = unit_ms * 1000;
+
+    for (const char *c = text; *c != '\0'; ++c)
+    {
+        const char *code = NULL;
+        if (isalpha((unsigned char)*c))
+        {
+            code = _morse_letters[toupper((unsigned char)*c) - 'A'];
+        }
+        else if (isdigit((unsigned char)*c))
+        {
+            code = _morse_digits[*c - '0'];
+        }
+        else if (*c == ' ')
+        {
+            // letter gap is already there - word gap is extended by merging consecutive off steps
+            if (!_pattern_append(pattern, false, (MORSE_WORD_GAP - MORSE_LETTER_GAP) * unit_us))
+            {
+                return false;
+            }
+            continue;
+        }
+        else
+        {
+            LOG("Character without Morse code\n");
+            return false;
+        }
+
+        for (const char *element = code; *element != '\0'; ++element)
+        {
+            uint32_t length = (*element == '.') ? MORSE_DOT : MORSE_DASH;
+            uint32_t gap = (element[1] != '\0') ? MORSE_DOT : MORSE_LETTER_GAP;
+            if (!_pattern_append(pattern, true, length * unit_us) || !_pattern_append(pattern, false, gap * unit_us))
+            {
+                return false;
+            }
+        }
+    }
+    if (pattern->count == 0)
+    {
+        return false;
+    }
+    // message is separated from its repetition with word gap
+    cenviro_led_step_t *last = &pattern->steps[pattern->count - 1];
+    if (last->duration_us < MORSE_WORD_GAP * unit_us)
+    {
+        last->duration_us = MORSE_WORD_GAP * unit_us;
+    }
+    return true;
+}
+
+bool cenviro_led_pattern_heartbeat(cenviro_led_pattern_t *pattern, uint32_t period_ms)
+{
+    CENVIRO_PROBE_API();
+    if (pattern == NULL || period_ms < HEARTBEAT_PERIOD_MIN_MS)
+    {
+        return false;
+    }
+    memset(pattern, 0, sizeof(*pattern));
+    uint32_t pulse_us = HEARTBEAT_PULSE_MS * 1000;
+    uint32_t period_us = period_ms * 1000;
+    _pattern_append(pattern, true, pulse_us);
+    _pattern_append(pattern, false, period_us / 4 - pulse_us);
+    _pattern_append(pattern, true, pulse_us);
+    _pattern_append(pattern, false, period_us - period_us / 4 - pulse_us);
+    return true;
+}
+
+bool cenviro_led_pattern_pwm(cenviro_led_pattern_t *pattern, uint8_t brightness, uint32_t frequency_hz)
+{
+    CENVIRO_PROBE_API();
+    if (pattern == NULL || brightness > 100 || frequency_hz == 0 || frequency_hz > PWM_FREQUENCY_MAX)
+    {
+        return false;
+    }
+    memset(pattern, 0, sizeof(*pattern));
+    uint32_t period_us = 1000000 / frequency_hz;
+    uint32_t on_us = period_us * brightness / 100;
+
+    // pulses shorter than timer resolution are rounded to constant level
+    if (on_us < CENVIRO_LED_STEP_MIN_US)
+    {
+        on_us = 0;
+    }
+    else if (period_us - on_us < CENVIRO_LED_STEP_MIN_US)
+    {
+        on_us = period_us;
+    }
+    if (on_us > 0)
+    {
+        _pattern_append(pattern, true, on_us);
+    }
+    if (on_us < period_us)
+    {
+        _pattern_append(pattern, false, period_us - on_us);
+    }
+    return true;
+}
+
+// consecutive steps of the same level are merged
+static bool _pattern_append(cenviro_led_pattern_t *pattern, bool on, uint32_t duration_us)
+{
+    if (duration_us == 0)
+    {
+        return true;
+    }
+    if (pattern->count > 0 && pattern->steps[pattern->count - 1].on == on)
+    {
+        pattern->steps[pattern->count - 1].duration_us += duration_us;
+        return true;
+    }
+    if (pattern->count == CENVIRO_LED_PATTERN_STEPS)
+    {
+        LOG("Too many LED pattern steps\n");
+        return false;
+    }
+    pattern->steps[pattern->count].on = on;
+    pattern->steps[pattern->count].duration_us = duration_us;
+    pattern->count++;
+    return true;
+}
+
+#ifndef DISABLE_THREADSAFE
+
+static bool _pattern_valid(const cenviro_led_pattern_t *pattern)
+{
+    if (pattern == NULL || pattern->count == 0 || pattern->count > CENVIRO_LED_PATTERN_STEPS)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < pattern->count; ++i)
+    {
+        if (pattern->steps[i].duration_us < CENVIRO_LED_STEP_MIN_US)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _pattern_arm(pattern_state_t *player, uint64_t deadline)
+{
+    struct itimerspec timer = {0};
+    timer.it_value.tv_sec = deadline / 1000000000ULL;
+    timer.it_value.tv_nsec = deadline % 1000000000ULL;
+    timerfd_settime(player->timer, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+// wakes player thread up (zero would disarm timer, deadline in the past expires at once)
+static void _pattern_kick(pattern_state_t *player)
+{
+    _pattern_arm(player, 1);
+}
+
+static void _timing_add(pattern_state_t *player, uint64_t lateness)
+{
+    player->timing_changes++;
+    player->timing_sum += (double)lateness;
+    player->timing_sum_sq += (double)lateness * lateness;
+    if (lateness > player->timing_max)
+    {
+        player->timing_max = lateness;
+    }
+}
+
+// player thread cannot continue - it releases its resources unless cenviro_led_stop() is already waiting for it,
+// so player is reported as stopped and next cenviro_led_play() starts new thread
+static void _pattern_abort(pattern_state_t *player)
+{
+    pthread_mutex_lock(&player->lock);
+    if (!player->exit)
+    {
+        if (player->active)
+        {
+            cenviro_led_set(false);
+        }
+        close(player->timer);
+        player->timer = -1;
+        player->running = false;
+        player->active = false;
+        player->pending = false;
+        pthread_detach(pthread_self());
+    }
+    pthread_mutex_unlock(&player->lock);
+}
+
+static void *_pattern_main(void *params)
+{
+    // LED of context which started the player
+    _cenviro_ctx = params;
+    pattern_state_t *player = &_cenviro_ctx->pattern;
+    cenviro_led_pattern_t pattern = {.count = 0, .repeat = 0};
+    uint64_t deadline = 0;
+    size_t step = 0;
+    uint32_t round = 0;
+
+    while (true)
+    {
+        uint64_t expirations = 0;
+        if (read(player->timer, &expirations, sizeof(expirations)) < 0 && errno != EINTR)
+        {
+            LOG_ERROR("Failed to read LED pattern timer\n");
+            _pattern_abort(player);
+            break;
+        }
+
+        // timer is armed under lock, so command issued after this section always wakes the thread again
+        pthread_mutex_lock(&player->lock);
+        if (player->exit)
+        {
+            pthread_mutex_unlock(&player->lock);
+            break;
+        }
+        bool scheduled = true;
+        if (player->pending)
+        {
+            pattern = player->next;
+            player->pending = false;
+            deadline = cenviro_monotonic_ns();
+            step = 0;
+            round = 0;
+            scheduled = false;
+        }
+        uint64_t now = cenviro_monotonic_ns();
+        if (!player->active || now < deadline)
+        {
+            // stopped pattern or spurious wakeup
+            pthread_mutex_unlock(&player->lock);
+            continue;
+        }
+
+        if (step == pattern.count)
+        {
+            // pattern played given number of times
+            cenviro_led_set(false);
+            player->active = false;
+            pthread_mutex_unlock(&player->lock);
+            continue;
+        }
+        cenviro_led_set(pattern.steps[step].on);
+        if (scheduled)
+        {
+            _timing_add(player, cenviro_monotonic_ns() - deadline);
+        }
+
+        // next deadline follows from previous one - steps missed due to long delay are skipped
+        deadline += (uint64_t)pattern.steps[step].duration_us * 1000;
+        now = cenviro_monotonic_ns();
+        while (true)
+        {
+            if (++step == pattern.count)
+            {
+                round++;
+                if (pattern.repeat == 0 || round < pattern.repeat)
+                {
+                    step = 0;
+                }
+            }
+            if (deadline > now || step == pattern.count)
+            {
+                break;
+            }
+            player->timing_missed++;
+            deadline += (uint64_t)pattern.steps[step].duration_us * 1000;
+        }
+        _pattern_arm(player, deadline);
+        pthread_mutex_unlock(&player->lock);
+    }
+    return NULL;
+}
+
+bool cenviro_led_play(const cenviro_led_pattern_t *pattern)
+{
+    CENVIRO_PROBE_API();
+    pattern_state_t *player = &_cenviro_ctx->pattern;
+    if (!_pattern_valid(pattern))
+    {
+        LOG("Invalid LED pattern\n");
+        return false;
+    }
+    if (!cenviro_module_ready(CENVIRO_MODULE_LED))
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&player->lock);
+    if (!player->running)
+    {
+        player->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (player->timer < 0)
+        {
+            LOG("Failed to create LED pattern timer\n");
+            pthread_mutex_unlock(&player->lock);
+            return false;
+        }
+        player->exit = false;
+        if (pthread_create(&player->thread, NULL, _pattern_main, _cenviro_ctx) != 0)
+        {
+            LOG("Failed to create LED pattern thread\n");
+            close(player->timer);
+            player->timer = -1;
+            pthread_mutex_unlock(&player->lock);
+            return false;
+        }
+        player->running = true;
+    }
+    player->next = *pattern;
+    player->pending = true;
+    player->active = true;
+    _pattern_kick(player);
+    pthread_mutex_unlock(&player->lock);
+    return true;
+}
+
+void cenviro_led_stop()
+{
+    CENVIRO_PROBE_API();
+    pattern_state_t *player = &_cenviro_ctx->pattern;
+    pthread_mutex_lock(&player->lock);
+    if (!player->running)
+    {
+        pthread_mutex_unlock(&player->lock);
+        return;
+    }
+    bool active = player->active;
+    player->exit = true;
+    _pattern_kick(player);
+    pthread_mutex_unlock(&player->lock);
+
+    pthread_join(player->thread, NULL);
+
+    pthread_mutex_lock(&player->lock);
+    close(player->timer);
+    player->timer = -1;
+    player->running = false;
+    player->active = false;
+    player->pending = false;
+    pthread_mutex_unlock(&player->lock);
+    if (active)
+    {
+        cenviro_led_set(false);
+    }
+}
+
+bool cenviro_led_playing()
+{
+    CENVIRO_PROBE_API();
+    pattern_state_t *player = &_cenviro_ctx->pattern;
+    pthread_mutex_lock(&player->lock);
+    bool active = player->active;
+    pthread_mutex_unlock(&player->lock);
+    return active;
+}
+
+cenviro_led_timing_t cenviro_led_timing(bool reset)
+{
+    CENVIRO_PROBE_API();
+    pattern_state_t *player = &_cenviro_ctx->pattern;
+    cenviro_led_timing_t timing = {0};
+    pthread_mutex_lock(&player->lock);
+    timing.changes = player->timing_changes;
+    timing.missed = player->timing_missed;
+    if (player->timing_changes > 0)
+    {
+        double mean = player->timing_sum / player->timing_changes;
+        double variance = player->timing_sum_sq / player->timing_changes - mean * mean;
+        timing.mean_ns = (uint32_t)mean;
+        timing.stddev_ns = (variance > 0.0) ? (uint32_t)sqrt(variance) : 0;
+        timing.max_ns = (player->timing_max < UINT32_MAX) ? (uint32_t)player->timing_max : UINT32_MAX;
+    }
+    if (reset)
+    {
+        player->timing_changes = 0;
+        player->timing_missed = 0;
+        player->timing_sum = 0.0;
+        player->timing_sum_sq = 0.0;
+        player->timing_max = 0;
+    }
+    pthread_mutex_unlock(&player->lock);
+    return timing;
+}
+
+#else
+
+bool cenviro_led_play(const cenviro_led_pattern_t *pattern)
+{
+    CENVIRO_PROBE_API();
+    LOG("LED patterns not available in thread unsafe version\n");
+    return false;
+}
+
+void cenviro_led_stop()
+{
+    CENVIRO_PROBE_API();
+}
+
+bool cenviro_led_playing()
+{
+    CENVIRO_PROBE_API();
+    return false;
+}
+
+cenviro_led_timing_t cenviro_led_timing(bool reset)
+{
+    CENVIRO_PROBE_API();
+    cenviro_led_timing_t timing = {0};
+    return timing;
+}
+
+#endif // DISABLE_THREADSAFE
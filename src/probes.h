@@ -0,0 +1,43 @@
+#ifndef _CENVIRO_PROBES_H_
+#define _CENVIRO_PROBES_H_
+
+// USDT (statically defined tracing) probes of "cenviro" provider. Probe site is a single nop instruction
+// described in ELF note, so probes cost nothing until tracer (perf, bpftrace) attaches to them. Probes are
+// compiled in when <sys/sdt.h> (systemtap SDT header) is available and DISABLE_PROBES is not defined.
+//
+// api__entry(function), api__return(function)                     - public cenviro_* call (function name)
+// bus__transfer__start(address, reg, bytes, messages)             - bus transaction (reg -1 when first
+// bus__transfer__done(address, reg, bytes, status)                  message is not register write)
+// lock__acquire(mutex), lock__acquired(mutex)                     - blocking mutex acquisition
+
+#if !defined(DISABLE_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CENVIRO_PROBES
+#endif
+#endif
+
+#ifdef CENVIRO_PROBES
+
+#define CENVIRO_PROBE1(name, a) DTRACE_PROBE1(cenviro, name, a)
+#define CENVIRO_PROBE4(name, a, b, c, d) DTRACE_PROBE4(cenviro, name, a, b, c, d)
+
+static inline void _cenviro_probe_return(const char *const *function)
+{
+    DTRACE_PROBE1(cenviro, api__return, *function);
+}
+
+// entry probe of public function - return probe fires when function scope is left (on every return statement)
+#define CENVIRO_PROBE_API()                                                                                      \
+    const char *_cenviro_probe_function __attribute__((cleanup(_cenviro_probe_return))) = __func__;              \
+    DTRACE_PROBE1(cenviro, api__entry, _cenviro_probe_function)
+
+#else
+
+#define CENVIRO_PROBE1(name, a)
+#define CENVIRO_PROBE4(name, a, b, c, d)
+#define CENVIRO_PROBE_API()
+
+#endif // CENVIRO_PROBES
+
+#endif // _CENVIRO_PROBES_H_
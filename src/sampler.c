@@ -0,0 +1,266 @@
+#include <string.h>
+#include <time.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// Background sampler: dedicated thread reads sensors with configured periods and publishes
+// latest values through seqlocks, so readers never touch the bus nor any mutex.
+
+// returns false if nothing was published yet
+static bool _seqlock_read(sampler_seqlock_t *slot, void *value, size_t size)
+{
+    uint64_t words[SEQLOCK_WORDS];
+    uint32_t before = 0;
+    uint32_t after = 0;
+
+    do
+    {
+        before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        for (size_t i = 0; i < SEQLOCK_WORDS; ++i)
+        {
+            words[i] = __atomic_load_n(&slot->data[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    } while ((before & 0x01) || before != after);
+
+    if (before == 0)
+    {
+        return false;
+    }
+    memcpy(value, words, size);
+    return true;
+}
+
+#ifndef DISABLE_THREADSAFE
+
+static void _seqlock_publish(sampler_seqlock_t *slot, const void *value, size_t size)
+{
+    uint64_t words[SEQLOCK_WORDS] = {0};
+    memcpy(words, value, size);
+
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < SEQLOCK_WORDS; ++i)
+    {
+        __atomic_store_n(&slot->data[i], words[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+static void _sample_weather()
+{
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    cenviro_weather_sample_t sample;
+    if (!cenviro_weather_read(&sample.temperature, &sample.pressure))
+    {
+        return;
+    }
+    sample.timestamp_ns = cenviro_monotonic_ns();
+    _seqlock_publish(&sampler->weather_slot, &sample, sizeof(sample));
+}
+
+static void _sample_light()
+{
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    cenviro_light_sample_t sample;
+    if (!cenviro_light_read(&sample.crgb, NULL, NULL))
+    {
+        return;
+    }
+    sample.timestamp_ns = cenviro_monotonic_ns();
+    _seqlock_publish(&sampler->light_slot, &sample, sizeof(sample));
+}
+
+static void _sample_motion()
+{
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    cenviro_motion_sample_t sample;
+    if (!cenviro_motion_read_temperature(&sample.temperature))
+    {
+        return;
+    }
+    sample.timestamp_ns = cenviro_monotonic_ns();
+    _seqlock_publish(&sampler->motion_slot, &sample, sizeof(sample));
+}
+
+// run sampling function if its deadline passed and compute the next one (absolute, no drift)
+static void _sampler_poll(void (*sample)(), uint32_t period_ms, uint64_t *deadline, uint64_t now, uint64_t *wakeup)
+{
+    if (period_ms == 0)
+    {
+        return;
+    }
+    uint64_t period_ns = (uint64_t)period_ms * 1000000;
+    if (now >= *deadline)
+    {
+        sample();
+        *deadline += period_ns;
+        if (*deadline <= now)
+        {
+            // sampling took longer than period - skip missed slots
+            *deadline = now + period_ns;
+        }
+    }
+    if (*deadline < *wakeup)
+    {
+        *wakeup = *deadline;
+    }
+}
+
+static void *_sampler_main(void *params)
+{
+    // sensors are read through context of thread which started sampler
+    _cenviro_ctx = params;
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    uint64_t start = cenviro_monotonic_ns();
+    uint64_t weather_deadline = start;
+    uint64_t light_deadline = start;
+    uint64_t motion_deadline = start;
+
+    pthread_mutex_lock(&sampler->lock);
+    while (!sampler->stop)
+    {
+        pthread_mutex_unlock(&sampler->lock);
+
+        uint64_t now = cenviro_monotonic_ns();
+        uint64_t wakeup = UINT64_MAX;
+        _sampler_poll(_sample_weather, sampler->config.weather_period_ms, &weather_deadline, now, &wakeup);
+        _sampler_poll(_sample_light, sampler->config.light_period_ms, &light_deadline, now, &wakeup);
+        _sampler_poll(_sample_motion, sampler->config.motion_period_ms, &motion_deadline, now, &wakeup);
+
+        pthread_mutex_lock(&sampler->lock);
+        if (sampler->stop)
+        {
+            break;
+        }
+        struct timespec until = {.tv_sec = wakeup / 1000000000ULL, .tv_nsec = wakeup % 1000000000ULL};
+        pthread_cond_timedwait(&sampler->wakeup, &sampler->lock, &until);
+    }
+    pthread_mutex_unlock(&sampler->lock);
+    return NULL;
+}
+
+bool cenviro_sampler_start(const cenviro_sampler_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    if (!_cenviro_ctx->initialized || config == NULL)
+    {
+        LOG("Library not initialized or missing sampler config\n");
+        return false;
+    }
+    if (config->weather_period_ms == 0 && config->light_period_ms == 0 && config->motion_period_ms == 0)
+    {
+        LOG("No sensor selected for sampling\n");
+        return false;
+    }
+
+    pthread_mutex_lock(&sampler->lock);
+    if (sampler->running)
+    {
+        LOG("Sampler already running\n");
+        pthread_mutex_unlock(&sampler->lock);
+        return false;
+    }
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&sampler->wakeup, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    sampler->config = *config;
+    if (sampler->config.weather_period_ms != 0)
+    {
+        // no point in polling faster than sensor produces new data in current profile
+        uint32_t data_period_ms = (cenviro_weather_timing().period_us + 999) / 1000;
+        if (sampler->config.weather_period_ms < data_period_ms)
+        {
+            sampler->config.weather_period_ms = data_period_ms;
+        }
+    }
+    if (sampler->config.light_period_ms != 0)
+    {
+        // light sensor produces new data once per integration cycle
+        uint32_t cycle_ms = (cenviro_light_cycle_us() + 999) / 1000;
+        if (sampler->config.light_period_ms < cycle_ms)
+        {
+            sampler->config.light_period_ms = cycle_ms;
+        }
+    }
+    sampler->stop = false;
+    if (pthread_create(&sampler->thread, NULL, _sampler_main, _cenviro_ctx) != 0)
+    {
+        LOG("Failed to create sampler thread\n");
+        pthread_cond_destroy(&sampler->wakeup);
+        pthread_mutex_unlock(&sampler->lock);
+        return false;
+    }
+    sampler->running = true;
+    pthread_mutex_unlock(&sampler->lock);
+    return true;
+}
+
+void cenviro_sampler_stop()
+{
+    CENVIRO_PROBE_API();
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    pthread_mutex_lock(&sampler->lock);
+    if (!sampler->running)
+    {
+        pthread_mutex_unlock(&sampler->lock);
+        return;
+    }
+    sampler->stop = true;
+    pthread_cond_signal(&sampler->wakeup);
+    pthread_mutex_unlock(&sampler->lock);
+
+    pthread_join(sampler->thread, NULL);
+
+    pthread_mutex_lock(&sampler->lock);
+    pthread_cond_destroy(&sampler->wakeup);
+    sampler->running = false;
+    pthread_mutex_unlock(&sampler->lock);
+}
+
+#else
+
+bool cenviro_sampler_start(const cenviro_sampler_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    LOG("Sampler not available in thread unsafe version\n");
+    return false;
+}
+
+void cenviro_sampler_stop()
+{
+    CENVIRO_PROBE_API();
+}
+
+#endif // DISABLE_THREADSAFE
+
+bool cenviro_sampler_weather(cenviro_weather_sample_t *sample)
+{
+    CENVIRO_PROBE_API();
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    return sample != NULL && _seqlock_read(&sampler->weather_slot, sample, sizeof(*sample));
+}
+
+bool cenviro_sampler_light(cenviro_light_sample_t *sample)
+{
+    CENVIRO_PROBE_API();
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    return sample != NULL && _seqlock_read(&sampler->light_slot, sample, sizeof(*sample));
+}
+
+bool cenviro_sampler_motion(cenviro_motion_sample_t *sample)
+{
+    CENVIRO_PROBE_API();
+    sampler_state_t *sampler = &_cenviro_ctx->sampler;
+    return sample != NULL && _seqlock_read(&sampler->motion_slot, sample, sizeof(*sample));
+}
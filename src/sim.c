@@ -0,0 +1,1119 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// Register level simulation of Enviro pHat devices:
+// - BMP280 (weather) with calibration PROM and forced mode conversion timing,
+// - TCS3472 (light) with command register protocol, gain and continuous integration cycles,
+// - LSM303D (motion) with auto-increment register access, accelerometer FIFO in stream mode, data-ready and
+//   inertial (high event, optionally high-pass filtered) interrupt generator on INT1/INT2,
+// - ADS1015 (ADC) with 16-bit registers, single-shot and continuous conversion timing and ALERT/RDY output
+//   (conversion-ready pulse or traditional/window comparator with queue and latch).
+// Interrupt outputs are represented by timerfd descriptors expiring when simulated device asserts its line.
+
+#define SIM_REGS 256
+#define SIM_DEVICE_COUNT 4
+#define SIM_IRQ_OUTPUTS 2
+// wait between register address write and data read of legacy register reads (in [ms])
+#define SIM_COMMAND_WAIT_MS 5
+
+// BMP280 registers
+#define SIM_BMP_CALIBRATION 0x88
+#define SIM_BMP_ID 0xd0
+#define SIM_BMP_RESET 0xe0
+#define SIM_BMP_STATUS 0xf3
+#define SIM_BMP_CTRL_MEAS 0xf4
+#define SIM_BMP_DATA 0xf7
+#define SIM_BMP_STATUS_MEASURING 0x08
+
+// TCS3472 registers and command bits
+#define SIM_TCS_COMMAND_TYPE 0x60
+#define SIM_TCS_TYPE_AUTOINCREMENT 0x20
+#define SIM_TCS_TYPE_SPECIAL 0x60
+#define SIM_TCS_SPECIAL_INT_CLEAR 0x06
+#define SIM_TCS_ENABLE 0x00
+#define SIM_TCS_ATIME 0x01
+#define SIM_TCS_CONTROL 0x0f
+#define SIM_TCS_AILT 0x04
+#define SIM_TCS_AIHT 0x06
+#define SIM_TCS_PERS 0x0c
+#define SIM_TCS_ID 0x12
+#define SIM_TCS_STATUS 0x13
+#define SIM_TCS_DATA 0x14
+// pseudo registers with light input - clear, red, green, blue counts per 2.4ms cycle at 1x gain
+#define SIM_TCS_INPUT 0x20
+#define SIM_TCS_CYCLE_NS 2400000ULL
+#define SIM_TCS_STATUS_AVALID 0x01
+#define SIM_TCS_STATUS_AINT 0x10
+#define SIM_TCS_ENABLE_AEN 0x02
+#define SIM_TCS_ENABLE_AIEN 0x10
+
+// LSM303D registers
+#define SIM_LSM_AUTOINCREMENT 0x80
+#define SIM_LSM_TEMP 0x05
+#define SIM_LSM_STATUS_M 0x07
+#define SIM_LSM_MAG 0x08
+#define SIM_LSM_ID 0x0f
+#define SIM_LSM_CTRL0 0x1f
+#define SIM_LSM_CTRL1 0x20
+#define SIM_LSM_CTRL3 0x22
+#define SIM_LSM_CTRL4 0x23
+#define SIM_LSM_CTRL5 0x24
+#define SIM_LSM_CTRL7 0x26
+#define SIM_LSM_STATUS_A 0x27
+#define SIM_LSM_ACCEL 0x28
+#define SIM_LSM_FIFO_CTRL 0x2e
+#define SIM_LSM_FIFO_SRC 0x2f
+#define SIM_LSM_IG_CFG1 0x30
+#define SIM_LSM_IG_SRC1 0x31
+#define SIM_LSM_IG_THS1 0x32
+#define SIM_LSM_IG_DUR1 0x33
+#define SIM_LSM_ZYXDA 0x08
+#define SIM_LSM_LIR1 0x01
+#define SIM_LSM_HPIS1 0x02
+#define SIM_LSM_AFDS 0x20
+#define SIM_LSM_IG_IA 0x40
+#define SIM_LSM_FIFO_SIZE 32
+#define SIM_LSM_FIFO_EN 0x40
+#define SIM_LSM_FM_MASK 0xe0
+#define SIM_LSM_FM_BYPASS 0x00
+#define SIM_LSM_FM_STREAM 0x40
+
+// ADS1015 registers
+#define SIM_ADS_CONVERSION 0
+#define SIM_ADS_CONFIG 1
+#define SIM_ADS_INPUTS 4
+#define SIM_ADS_REGISTERS 8
+#define SIM_ADS_LO_THRESH 2
+#define SIM_ADS_HI_THRESH 3
+#define SIM_ADS_CONFIG_OS 0x8000
+#define SIM_ADS_CONFIG_MODE 0x0100
+#define SIM_ADS_COMP_WINDOW 0x0010
+#define SIM_ADS_COMP_LAT 0x0004
+#define SIM_ADS_COMP_QUE 0x0003
+
+typedef struct
+{
+    uint8_t address;
+    uint8_t regs[SIM_REGS];
+    uint8_t pointer;
+    uint64_t ready_ns; // end of currently running conversion
+    bool converting;
+    uint32_t persistence;        // consecutive out-of-range cycles (TCS3472), samples above threshold (LSM303D) or
+                                 // conversions beyond comparator threshold (ADS1015)
+    bool alert;                  // ADS1015 comparator output asserted
+    uint32_t fifo_level;         // number of stored samples (LSM303D FIFO)
+    int32_t hp_reference[3];     // LSM303D high-pass filter state (inertial interrupt)
+    int irq_fd[SIM_IRQ_OUTPUTS]; // stand-in interrupt lines (-1 - not requested)
+} sim_device_t;
+
+typedef struct
+{
+    cenviro_sim_config_t config;
+    sim_device_t devices[SIM_DEVICE_COUNT];
+    uint64_t transfers;
+    bool led;
+#ifndef DISABLE_THREADSAFE
+    pthread_mutex_t lock;
+#endif // DISABLE_THREADSAFE
+} sim_board_t;
+
+static cenviro_sim_config_t _sim_config = {0};
+
+#ifndef DISABLE_THREADSAFE
+#define SIM_LOCK(board) pthread_mutex_lock(&(board)->lock)
+#define SIM_UNLOCK(board) pthread_mutex_unlock(&(board)->lock)
+#else
+#define SIM_LOCK(board)
+#define SIM_UNLOCK(board)
+#endif // DISABLE_THREADSAFE
+
+// calibration PROM and raw data taken from BMP280 datasheet example (25.08*C, 1006.53hPa)
+static const uint8_t _bmp_calibration[24] = {
+    0x70, 0x6b, 0x43, 0x67, 0x18, 0xfc, 0x7d, 0x8e, 0x43, 0xd6, 0xd0, 0x0b,
+    0x27, 0x0b, 0x8c, 0x00, 0xf9, 0xff, 0x8c, 0x3c, 0xf8, 0xc6, 0x70, 0x17};
+static const uint8_t _bmp_data[6] = {0x65, 0x5a, 0xc0, 0x7e, 0xed, 0x00};
+
+// clear, red, green, blue counts (little endian) - 24ms integration at 1x gain of default light input
+static const uint8_t _tcs_data[8] = {0xb0, 0x04, 0x90, 0x01, 0xf4, 0x01, 0x2c, 0x01};
+static const uint8_t _tcs_input[8] = {0x78, 0x00, 0x28, 0x00, 0x32, 0x00, 0x1e, 0x00};
+// number of out-of-range cycles required by PERS register values (0 - interrupt after every cycle)
+static const uint32_t _tcs_persistence[16] = {0, 1, 2, 3, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60};
+
+static sim_board_t *_sim_active_board()
+{
+    if (!cenviro_bus_simulated())
+    {
+        return NULL;
+    }
+    return _cenviro_ctx->bus.handle;
+}
+
+static sim_device_t *_sim_find(sim_board_t *board, uint8_t address)
+{
+    for (int i = 0; i < SIM_DEVICE_COUNT; ++i)
+    {
+        if (board->devices[i].address == address)
+        {
+            return &board->devices[i];
+        }
+    }
+    return NULL;
+}
+
+static uint16_t _ads_get(sim_device_t *dev, uint8_t reg)
+{
+    return ((uint16_t)dev->regs[reg * 2]) << 8 | dev->regs[reg * 2 + 1];
+}
+
+static void _ads_set(sim_device_t *dev, uint8_t reg, uint16_t value)
+{
+    dev->regs[reg * 2] = value >> 8;
+    dev->regs[reg * 2 + 1] = value & 0xff;
+}
+
+// conversion result of currently selected input (single ended AIN0-AIN3, 12-bit left aligned)
+static int16_t _ads_result(sim_device_t *dev)
+{
+    uint8_t mux = (_ads_get(dev, SIM_ADS_CONFIG) >> 12) & 0x07;
+    uint8_t input = (mux >= 4) ? mux - 4 : 0;
+    return (int16_t)(_ads_get(dev, SIM_ADS_INPUTS + input) & 0xfff0);
+}
+
+static uint64_t _ads_conversion_ns(sim_device_t *dev)
+{
+    static const uint32_t rates[8] = {128, 250, 490, 920, 1600, 2400, 3300, 3300};
+    return 1000000000ULL / rates[(_ads_get(dev, SIM_ADS_CONFIG) >> 5) & 0x07];
+}
+
+// ALERT/RDY works as conversion-ready output when Hi_thresh MSB is 1 and Lo_thresh MSB is 0
+static bool _ads_ready_mode(sim_device_t *dev)
+{
+    return (_ads_get(dev, SIM_ADS_HI_THRESH) & 0x8000) && !(_ads_get(dev, SIM_ADS_LO_THRESH) & 0x8000);
+}
+
+static bool _ads_beyond_threshold(sim_device_t *dev)
+{
+    int16_t result = _ads_result(dev);
+    bool window = _ads_get(dev, SIM_ADS_CONFIG) & SIM_ADS_COMP_WINDOW;
+    return result > (int16_t)_ads_get(dev, SIM_ADS_HI_THRESH) || (window && result < (int16_t)_ads_get(dev, SIM_ADS_LO_THRESH));
+}
+
+// comparator update (input is constant between pokes so all conversions done since last update are the same)
+// and next conversion scheduling in continuous mode
+static void _ads_conversion_done(sim_device_t *dev, uint64_t now)
+{
+    uint16_t config = _ads_get(dev, SIM_ADS_CONFIG);
+    uint64_t conversion_ns = _ads_conversion_ns(dev);
+    uint64_t conversions = 1;
+    _ads_set(dev, SIM_ADS_CONVERSION, (uint16_t)_ads_result(dev));
+    if (config & SIM_ADS_CONFIG_MODE)
+    {
+        _ads_set(dev, SIM_ADS_CONFIG, config | SIM_ADS_CONFIG_OS);
+    }
+    else
+    {
+        conversions = (now - dev->ready_ns) / conversion_ns + 1;
+        dev->ready_ns += conversions * conversion_ns;
+        dev->converting = true;
+    }
+
+    uint8_t queue = config & SIM_ADS_COMP_QUE;
+    if (queue == SIM_ADS_COMP_QUE || _ads_ready_mode(dev))
+    {
+        return;
+    }
+    if (_ads_beyond_threshold(dev))
+    {
+        dev->persistence += conversions;
+        dev->alert = dev->alert || dev->persistence >= (1u << queue);
+        return;
+    }
+    dev->persistence = 0;
+    // traditional comparator is released below low threshold (hysteresis), latched one only by reading result
+    bool release = (config & SIM_ADS_COMP_WINDOW) || _ads_result(dev) < (int16_t)_ads_get(dev, SIM_ADS_LO_THRESH);
+    if (!(config & SIM_ADS_COMP_LAT) && release)
+    {
+        dev->alert = false;
+    }
+}
+
+static void _sim_reset_device(sim_device_t *dev)
+{
+    memset(dev->regs, 0, SIM_REGS);
+    dev->pointer = 0;
+    dev->converting = false;
+    dev->ready_ns = 0;
+    dev->persistence = 0;
+    dev->alert = false;
+    dev->fifo_level = 0;
+    memset(dev->hp_reference, 0, sizeof(dev->hp_reference));
+
+    switch (dev->address)
+    {
+    case WEATHER_ADDR:
+        memcpy(&dev->regs[SIM_BMP_CALIBRATION], _bmp_calibration, sizeof(_bmp_calibration));
+        memcpy(&dev->regs[SIM_BMP_DATA], _bmp_data, sizeof(_bmp_data));
+        dev->regs[SIM_BMP_ID] = 0x58;
+        break;
+    case LIGHT_ADDR:
+        memcpy(&dev->regs[SIM_TCS_DATA], _tcs_data, sizeof(_tcs_data));
+        memcpy(&dev->regs[SIM_TCS_INPUT], _tcs_input, sizeof(_tcs_input));
+        dev->regs[SIM_TCS_ATIME] = 0xff;
+        dev->regs[SIM_TCS_ID] = 0x44;
+        break;
+    case MOTION_ADDR:
+        dev->regs[SIM_LSM_ID] = 0x49;
+        // 25*C
+        dev->regs[SIM_LSM_TEMP] = 0x32;
+        // +1g on Z axis
+        dev->regs[SIM_LSM_ACCEL + 5] = 0x40;
+        // magnetic field pointing north (magnetometer data is always ready)
+        dev->regs[SIM_LSM_MAG + 1] = 0x08;
+        dev->regs[SIM_LSM_STATUS_M] = SIM_LSM_ZYXDA;
+        break;
+    case ADC_ADDR:
+        _ads_set(dev, SIM_ADS_CONFIG, 0x8583);
+        _ads_set(dev, 2, 0x8000);
+        _ads_set(dev, 3, 0x7fff);
+        break;
+    }
+}
+
+// BMP280 conversion time computed as in datasheet (typical values)
+static uint64_t _bmp_conversion_ns(sim_board_t *board, sim_device_t *dev)
+{
+    static const uint32_t oversampling[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+    if (board->config.conversion_latency_us != 0)
+    {
+        return (uint64_t)board->config.conversion_latency_us * 1000;
+    }
+    uint8_t ctrl = dev->regs[SIM_BMP_CTRL_MEAS];
+    uint32_t osrs_t = oversampling[ctrl >> 5];
+    uint32_t osrs_p = oversampling[(ctrl >> 2) & 0x07];
+    uint64_t time_us = 1000 + 2000 * osrs_t;
+    if (osrs_p != 0)
+    {
+        time_us += 2000 * osrs_p + 500;
+    }
+    return time_us * 1000;
+}
+
+static uint16_t _sim_get16(sim_device_t *dev, uint8_t reg)
+{
+    return dev->regs[reg] | ((uint16_t)dev->regs[reg + 1] << 8);
+}
+
+// counts integrated during one cycle for given channel (0 - clear, 1 - red, 2 - green, 3 - blue)
+static uint16_t _tcs_counts(sim_device_t *dev, int channel)
+{
+    static const uint32_t gains[] = {1, 4, 16, 60};
+    uint32_t cycles = 256 - dev->regs[SIM_TCS_ATIME];
+    uint32_t gain = gains[dev->regs[SIM_TCS_CONTROL] & 0x03];
+    // analog saturation is 1024 counts per cycle, digital one is 16-bit register
+    uint32_t saturation = (cycles >= 64) ? 0xffff : cycles * 1024;
+
+    uint32_t counts = _sim_get16(dev, SIM_TCS_INPUT + 2 * channel) * cycles * gain;
+    return (counts > saturation) ? saturation : counts;
+}
+
+static bool _tcs_out_of_range(sim_device_t *dev)
+{
+    uint16_t clear = _tcs_counts(dev, 0);
+    return clear < _sim_get16(dev, SIM_TCS_AILT) || clear > _sim_get16(dev, SIM_TCS_AIHT);
+}
+
+// store counts integrated during last cycle, update interrupt filter and schedule next cycle (integration is continuous)
+static void _tcs_cycle_done(sim_device_t *dev, uint64_t now)
+{
+    uint64_t cycle_ns = (256 - dev->regs[SIM_TCS_ATIME]) * SIM_TCS_CYCLE_NS;
+    // light input is constant between pokes so all cycles which ended since last update are the same
+    uint64_t cycles_done = (now - dev->ready_ns) / cycle_ns + 1;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        uint16_t counts = _tcs_counts(dev, i);
+        dev->regs[SIM_TCS_DATA + 2 * i] = counts & 0xff;
+        dev->regs[SIM_TCS_DATA + 2 * i + 1] = counts >> 8;
+    }
+    dev->regs[SIM_TCS_STATUS] |= SIM_TCS_STATUS_AVALID;
+
+    dev->persistence = _tcs_out_of_range(dev) ? dev->persistence + cycles_done : 0;
+    uint32_t required = _tcs_persistence[dev->regs[SIM_TCS_PERS] & 0x0f];
+    if ((dev->regs[SIM_TCS_ENABLE] & SIM_TCS_ENABLE_AIEN) && dev->persistence >= required)
+    {
+        dev->regs[SIM_TCS_STATUS] |= SIM_TCS_STATUS_AINT;
+    }
+
+    dev->ready_ns += cycles_done * cycle_ns;
+    dev->converting = true;
+}
+
+// accelerometer sample period for AODR setting (0 - power down)
+static uint64_t _lsm_sample_ns(sim_device_t *dev)
+{
+    static const uint64_t periods[16] = {0, 320000000, 160000000, 80000000, 40000000, 20000000,
+                                         10000000, 5000000, 2500000, 1250000, 625000};
+    return periods[dev->regs[SIM_LSM_CTRL1] >> 4];
+}
+
+static bool _lsm_streaming(sim_device_t *dev)
+{
+    return (dev->regs[SIM_LSM_CTRL0] & SIM_LSM_FIFO_EN) && (dev->regs[SIM_LSM_FIFO_CTRL] & SIM_LSM_FM_MASK) == SIM_LSM_FM_STREAM &&
+           _lsm_sample_ns(dev) != 0;
+}
+
+// FIFO_SRC - watermark, overrun (all slots filled), empty and level (at most 31) fields
+static void _lsm_fifo_status(sim_device_t *dev)
+{
+    uint8_t status = (dev->fifo_level < SIM_LSM_FIFO_SIZE) ? dev->fifo_level : SIM_LSM_FIFO_SIZE - 1;
+    if (dev->fifo_level >= (dev->regs[SIM_LSM_FIFO_CTRL] & 0x1f))
+    {
+        status |= 0x80;
+    }
+    if (dev->fifo_level == SIM_LSM_FIFO_SIZE)
+    {
+        status |= 0x40;
+    }
+    if (dev->fifo_level == 0)
+    {
+        status |= 0x20;
+    }
+    dev->regs[SIM_LSM_FIFO_SRC] = status;
+}
+
+// samples measured since last update are pushed to FIFO (the oldest ones are overwritten in stream mode)
+static int16_t _lsm_input(sim_device_t *dev, int axis)
+{
+    return (int16_t)_sim_get16(dev, SIM_LSM_ACCEL + 2 * axis);
+}
+
+// high-pass filter is used by interrupt generator 1 (CTRL0 HPIS1) or by output registers and FIFO (CTRL7 AFDS)
+static bool _lsm_filtered(sim_device_t *dev)
+{
+    return (dev->regs[SIM_LSM_CTRL0] & SIM_LSM_HPIS1) || (dev->regs[SIM_LSM_CTRL7] & SIM_LSM_AFDS);
+}
+
+// byte of accelerometer output register - filtered data (without gravity) when CTRL7 AFDS is set
+static uint8_t _lsm_output(sim_device_t *dev, uint8_t reg)
+{
+    if (!(dev->regs[SIM_LSM_CTRL7] & SIM_LSM_AFDS) || reg < SIM_LSM_ACCEL || reg >= SIM_LSM_ACCEL + 6)
+    {
+        return dev->regs[reg];
+    }
+    int axis = (reg - SIM_LSM_ACCEL) / 2;
+    uint16_t value = (uint16_t)(_lsm_input(dev, axis) - dev->hp_reference[axis]);
+    return ((reg - SIM_LSM_ACCEL) & 0x01) ? value >> 8 : value & 0xff;
+}
+
+// high event on any enabled axis - threshold LSB is 1/128 of full scale (256 raw counts)
+static bool _lsm_above_threshold(sim_device_t *dev)
+{
+    uint8_t config = dev->regs[SIM_LSM_IG_CFG1];
+    int32_t threshold = (dev->regs[SIM_LSM_IG_THS1] & 0x7f) * 256;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int32_t value = _lsm_input(dev, axis);
+        if (dev->regs[SIM_LSM_CTRL0] & SIM_LSM_HPIS1)
+        {
+            value -= dev->hp_reference[axis];
+        }
+        if ((config & (0x02 << (2 * axis))) && (value > threshold || -value > threshold))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// inertial interrupt generator 1 - event is raised when high event lasts longer than IG_DUR1 samples
+static void _lsm_inertial(sim_device_t *dev, uint64_t samples)
+{
+    // input is constant between pokes - filter settles within a few hundred samples
+    for (uint64_t i = 0; i < samples && i < 256; ++i)
+    {
+        bool above = _lsm_above_threshold(dev);
+        dev->persistence = above ? dev->persistence + 1 : 0;
+        if (dev->persistence > (dev->regs[SIM_LSM_IG_DUR1] & 0x7f))
+        {
+            dev->regs[SIM_LSM_IG_SRC1] |= SIM_LSM_IG_IA;
+        }
+        else if (!above && !(dev->regs[SIM_LSM_CTRL5] & SIM_LSM_LIR1))
+        {
+            dev->regs[SIM_LSM_IG_SRC1] &= ~SIM_LSM_IG_IA;
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            dev->hp_reference[axis] += (_lsm_input(dev, axis) - dev->hp_reference[axis]) / 8;
+        }
+    }
+}
+
+static void _lsm_samples_done(sim_device_t *dev, uint64_t now)
+{
+    uint64_t sample_ns = _lsm_sample_ns(dev);
+    uint64_t samples = (now - dev->ready_ns) / sample_ns + 1;
+    if (_lsm_streaming(dev))
+    {
+        dev->fifo_level = (dev->fifo_level + samples < SIM_LSM_FIFO_SIZE) ? dev->fifo_level + samples : SIM_LSM_FIFO_SIZE;
+    }
+    dev->regs[SIM_LSM_STATUS_A] |= SIM_LSM_ZYXDA;
+    _lsm_inertial(dev, samples);
+    _lsm_fifo_status(dev);
+    dev->ready_ns += samples * sample_ns;
+    dev->converting = true;
+}
+
+static void _lsm_fifo_pop(sim_device_t *dev)
+{
+    if (dev->fifo_level > 0)
+    {
+        --dev->fifo_level;
+    }
+    _lsm_fifo_status(dev);
+}
+
+// stand-in TCS3472 INT line - timer expires at the end of cycle which asserts interrupt
+static uint64_t _tcs_irq_expiry(sim_device_t *dev)
+{
+    uint64_t expire_ns = 0;
+    uint8_t enable = dev->regs[SIM_TCS_ENABLE];
+    if (dev->converting && (enable & SIM_TCS_ENABLE_AEN) && (enable & SIM_TCS_ENABLE_AIEN))
+    {
+        uint32_t required = _tcs_persistence[dev->regs[SIM_TCS_PERS] & 0x0f];
+        if (dev->regs[SIM_TCS_STATUS] & SIM_TCS_STATUS_AINT)
+        {
+            // line already asserted
+            expire_ns = 1;
+        }
+        else if (required == 0 || _tcs_out_of_range(dev))
+        {
+            uint32_t remaining = (required > dev->persistence) ? required - dev->persistence : 1;
+            expire_ns = dev->ready_ns + (remaining - 1) * (256 - dev->regs[SIM_TCS_ATIME]) * SIM_TCS_CYCLE_NS;
+        }
+    }
+    return expire_ns;
+}
+
+// stand-in ADS1015 ALERT/RDY line - conversion-ready pulse ends every conversion, comparator output is asserted
+// after queue of conversions beyond threshold
+static uint64_t _ads_irq_expiry(sim_device_t *dev)
+{
+    uint16_t config = _ads_get(dev, SIM_ADS_CONFIG);
+    uint8_t queue = config & SIM_ADS_COMP_QUE;
+    if (queue == SIM_ADS_COMP_QUE)
+    {
+        return 0;
+    }
+    if (_ads_ready_mode(dev))
+    {
+        return dev->converting ? dev->ready_ns : 0;
+    }
+    if (dev->alert)
+    {
+        // line already asserted
+        return 1;
+    }
+    if (!dev->converting || !_ads_beyond_threshold(dev))
+    {
+        return 0;
+    }
+    uint32_t required = 1u << queue;
+    uint32_t remaining = (required > dev->persistence) ? required - dev->persistence : 1;
+    return dev->ready_ns + (remaining - 1) * _ads_conversion_ns(dev);
+}
+
+// stand-in LSM303D INT1/INT2 line - sources routed by CTRL3 (INT1) and CTRL4 (INT2)
+static uint64_t _lsm_irq_expiry(sim_device_t *dev, int output)
+{
+    uint8_t route = dev->regs[output ? SIM_LSM_CTRL4 : SIM_LSM_CTRL3];
+    bool drdy_a = route & (output ? 0x08 : 0x04);
+    bool drdy_m = route & (output ? 0x04 : 0x02);
+    bool inertial = route & (output ? 0x40 : 0x20);
+    bool watermark = output && (route & 0x01);
+
+    if ((drdy_a && (dev->regs[SIM_LSM_STATUS_A] & SIM_LSM_ZYXDA)) || drdy_m ||
+        (inertial && (dev->regs[SIM_LSM_IG_SRC1] & SIM_LSM_IG_IA)) || (watermark && (dev->regs[SIM_LSM_FIFO_SRC] & 0x80)))
+    {
+        // line already asserted
+        return 1;
+    }
+    if (!dev->converting)
+    {
+        return 0;
+    }
+    uint64_t sample_ns = _lsm_sample_ns(dev);
+    uint64_t expire_ns = UINT64_MAX;
+    if (drdy_a)
+    {
+        expire_ns = dev->ready_ns;
+    }
+    if (watermark && _lsm_streaming(dev))
+    {
+        uint32_t threshold = dev->regs[SIM_LSM_FIFO_CTRL] & 0x1f;
+        uint64_t remaining = (threshold > dev->fifo_level) ? threshold - dev->fifo_level - 1 : 0;
+        expire_ns = (dev->ready_ns + remaining * sample_ns < expire_ns) ? dev->ready_ns + remaining * sample_ns : expire_ns;
+    }
+    if (inertial && _lsm_above_threshold(dev))
+    {
+        uint32_t duration = dev->regs[SIM_LSM_IG_DUR1] & 0x7f;
+        uint64_t remaining = (duration > dev->persistence) ? duration - dev->persistence : 0;
+        expire_ns = (dev->ready_ns + remaining * sample_ns < expire_ns) ? dev->ready_ns + remaining * sample_ns : expire_ns;
+    }
+    return (expire_ns == UINT64_MAX) ? 0 : expire_ns;
+}
+
+// timer expiring at given moment (0 - disarmed)
+static void _sim_set_timer(int fd, uint64_t expire_ns)
+{
+    struct itimerspec timer = {0};
+    timer.it_value.tv_sec = expire_ns / 1000000000ULL;
+    timer.it_value.tv_nsec = expire_ns % 1000000000ULL;
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+static void _sim_arm_irq(sim_device_t *dev)
+{
+    for (int output = 0; output < SIM_IRQ_OUTPUTS; ++output)
+    {
+        if (dev->irq_fd[output] < 0)
+        {
+            continue;
+        }
+        switch (dev->address)
+        {
+        case LIGHT_ADDR:
+            _sim_set_timer(dev->irq_fd[output], _tcs_irq_expiry(dev));
+            break;
+        case MOTION_ADDR:
+            _sim_set_timer(dev->irq_fd[output], _lsm_irq_expiry(dev, output));
+            break;
+        case ADC_ADDR:
+            _sim_set_timer(dev->irq_fd[output], _ads_irq_expiry(dev));
+            break;
+        }
+    }
+}
+
+// update device state based on current time (conversion completion)
+static void _sim_update(sim_device_t *dev, uint64_t now)
+{
+    if (!dev->converting || now < dev->ready_ns)
+    {
+        return;
+    }
+    dev->converting = false;
+    switch (dev->address)
+    {
+    case WEATHER_ADDR:
+        // forced conversion done - return to sleep mode
+        dev->regs[SIM_BMP_CTRL_MEAS] &= ~0x03;
+        dev->regs[SIM_BMP_STATUS] &= ~SIM_BMP_STATUS_MEASURING;
+        break;
+    case LIGHT_ADDR:
+        _tcs_cycle_done(dev, now);
+        break;
+    case MOTION_ADDR:
+        _lsm_samples_done(dev, now);
+        break;
+    case ADC_ADDR:
+        _ads_conversion_done(dev, now);
+        break;
+    }
+}
+
+static void _sim_write_bmp(sim_board_t *board, sim_device_t *dev, const uint8_t *data, size_t length, uint64_t now)
+{
+    dev->pointer = data[0];
+    // multi-byte writes are sent as register/value pairs
+    for (size_t i = 0; i + 1 < length; i += 2)
+    {
+        uint8_t reg = data[i];
+        uint8_t value = data[i + 1];
+        if (reg == SIM_BMP_RESET)
+        {
+            if (value == 0xb6)
+            {
+                _sim_reset_device(dev);
+            }
+            continue;
+        }
+        if (reg < SIM_BMP_STATUS || reg >= SIM_BMP_DATA)
+        {
+            // read only registers
+            continue;
+        }
+        dev->regs[reg] = value;
+        if (reg == SIM_BMP_CTRL_MEAS && ((value & 0x03) == 0x01 || (value & 0x03) == 0x02))
+        {
+            dev->converting = true;
+            dev->ready_ns = now + _bmp_conversion_ns(board, dev);
+            dev->regs[SIM_BMP_STATUS] |= SIM_BMP_STATUS_MEASURING;
+        }
+    }
+}
+
+static void _sim_write_tcs(sim_device_t *dev, const uint8_t *data, size_t length, uint64_t now)
+{
+    uint8_t command = data[0];
+    if ((command & SIM_TCS_COMMAND_TYPE) == SIM_TCS_TYPE_SPECIAL)
+    {
+        if ((command & 0x1f) == SIM_TCS_SPECIAL_INT_CLEAR)
+        {
+            dev->regs[SIM_TCS_STATUS] &= ~SIM_TCS_STATUS_AINT;
+        }
+        return;
+    }
+    dev->pointer = command;
+    bool increment = (command & SIM_TCS_COMMAND_TYPE) == SIM_TCS_TYPE_AUTOINCREMENT;
+    uint8_t reg = command & 0x1f;
+    for (size_t i = 1; i < length; ++i)
+    {
+        // integration restarts when it is enabled or disabled and on configuration change
+        bool restart = (reg == SIM_TCS_ENABLE) ? ((dev->regs[reg] ^ data[i]) & SIM_TCS_ENABLE_AEN) != 0
+                                               : (reg == SIM_TCS_ATIME || reg == SIM_TCS_CONTROL);
+        if (reg != SIM_TCS_ID && reg != SIM_TCS_STATUS && reg < SIM_TCS_DATA)
+        {
+            dev->regs[reg] = data[i];
+        }
+        if (restart)
+        {
+            dev->regs[SIM_TCS_STATUS] &= ~SIM_TCS_STATUS_AVALID;
+            dev->persistence = 0;
+            dev->converting = (dev->regs[SIM_TCS_ENABLE] & SIM_TCS_ENABLE_AEN) != 0;
+            dev->ready_ns = now + (uint64_t)(256 - dev->regs[SIM_TCS_ATIME]) * SIM_TCS_CYCLE_NS;
+        }
+        if (increment)
+        {
+            ++reg;
+        }
+    }
+}
+
+static void _sim_write_lsm(sim_device_t *dev, const uint8_t *data, size_t length, uint64_t now)
+{
+    bool filter = _lsm_filtered(dev);
+    dev->pointer = data[0];
+    uint8_t reg = data[0] & ~SIM_LSM_AUTOINCREMENT;
+    for (size_t i = 1; i < length; ++i)
+    {
+        if (reg != SIM_LSM_ID && reg != SIM_LSM_FIFO_SRC && reg != SIM_LSM_IG_SRC1)
+        {
+            dev->regs[reg] = data[i];
+        }
+        if (data[0] & SIM_LSM_AUTOINCREMENT)
+        {
+            ++reg;
+        }
+    }
+
+    // bypass mode empties FIFO, sampling runs only in stream mode
+    if ((dev->regs[SIM_LSM_FIFO_CTRL] & SIM_LSM_FM_MASK) == SIM_LSM_FM_BYPASS)
+    {
+        dev->fifo_level = 0;
+    }
+    // high-pass filter starts settled on current input
+    if (_lsm_filtered(dev) && !filter)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            dev->hp_reference[axis] = _lsm_input(dev, axis);
+        }
+    }
+    // accelerometer samples at AODR rate (FIFO is filled in stream mode only)
+    if (_lsm_sample_ns(dev) == 0)
+    {
+        dev->converting = false;
+    }
+    else if (!dev->converting)
+    {
+        dev->converting = true;
+        dev->ready_ns = now + _lsm_sample_ns(dev);
+    }
+    _lsm_fifo_status(dev);
+}
+
+static void _sim_write_ads(sim_device_t *dev, const uint8_t *data, size_t length, uint64_t now)
+{
+    dev->pointer = data[0] & 0x03;
+    if (length < 3)
+    {
+        return;
+    }
+    uint16_t value = ((uint16_t)data[1]) << 8 | data[2];
+    if (dev->pointer == SIM_ADS_CONVERSION)
+    {
+        return;
+    }
+    if (dev->pointer != SIM_ADS_CONFIG)
+    {
+        _ads_set(dev, dev->pointer, value);
+        return;
+    }
+    bool start = (value & SIM_ADS_CONFIG_OS) || !(value & SIM_ADS_CONFIG_MODE);
+    _ads_set(dev, SIM_ADS_CONFIG, value & ~SIM_ADS_CONFIG_OS);
+    if (start)
+    {
+        // single-shot start or continuous mode - conversion result available after one period
+        dev->converting = true;
+        dev->ready_ns = now + _ads_conversion_ns(dev);
+    }
+}
+
+static void _sim_write(sim_board_t *board, sim_device_t *dev, const uint8_t *data, size_t length, uint64_t now)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    switch (dev->address)
+    {
+    case WEATHER_ADDR:
+        _sim_write_bmp(board, dev, data, length, now);
+        break;
+    case LIGHT_ADDR:
+        _sim_write_tcs(dev, data, length, now);
+        break;
+    case MOTION_ADDR:
+        _sim_write_lsm(dev, data, length, now);
+        break;
+    case ADC_ADDR:
+        _sim_write_ads(dev, data, length, now);
+        break;
+    }
+}
+
+static void _sim_read(sim_device_t *dev, uint8_t *data, size_t length)
+{
+    if (dev->address == ADC_ADDR)
+    {
+        uint8_t pointer = dev->pointer;
+        if (pointer == SIM_ADS_CONVERSION)
+        {
+            // register holds result of last finished conversion, reading it releases latched comparator
+            if (_ads_get(dev, SIM_ADS_CONFIG) & SIM_ADS_COMP_LAT)
+            {
+                dev->alert = false;
+                dev->persistence = 0;
+            }
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            data[i] = dev->regs[pointer * 2 + (i & 0x01)];
+        }
+        return;
+    }
+
+    uint8_t reg = dev->pointer;
+    bool increment = true;
+    if (dev->address == LIGHT_ADDR)
+    {
+        increment = (reg & SIM_TCS_COMMAND_TYPE) == SIM_TCS_TYPE_AUTOINCREMENT;
+        reg &= 0x1f;
+    }
+    else if (dev->address == MOTION_ADDR)
+    {
+        increment = (reg & SIM_LSM_AUTOINCREMENT) != 0;
+        reg &= ~SIM_LSM_AUTOINCREMENT;
+    }
+    bool fifo = dev->address == MOTION_ADDR && (dev->regs[SIM_LSM_CTRL0] & SIM_LSM_FIFO_EN);
+    for (size_t i = 0; i < length; ++i)
+    {
+        data[i] = dev->regs[reg];
+        if (dev->address == MOTION_ADDR)
+        {
+            data[i] = _lsm_output(dev, reg);
+            // data-ready is cleared by reading data, latched inertial event by reading its source register
+            if (reg >= SIM_LSM_ACCEL && reg < SIM_LSM_ACCEL + 6)
+            {
+                dev->regs[SIM_LSM_STATUS_A] &= ~SIM_LSM_ZYXDA;
+            }
+            if (reg == SIM_LSM_IG_SRC1 && (dev->regs[SIM_LSM_CTRL5] & SIM_LSM_LIR1))
+            {
+                dev->regs[SIM_LSM_IG_SRC1] &= ~SIM_LSM_IG_IA;
+            }
+        }
+        if (fifo && increment && reg == SIM_LSM_ACCEL + 5)
+        {
+            // FIFO output - address rolls back to OUT_X_L_A and next sample is taken
+            reg = SIM_LSM_ACCEL;
+            _lsm_fifo_pop(dev);
+        }
+        else if (increment)
+        {
+            ++reg;
+        }
+    }
+}
+
+// simulate time spent on the bus
+static void _sim_delay(sim_board_t *board, size_t bytes)
+{
+    uint64_t delay_ns = (uint64_t)board->config.transfer_latency_us * 1000;
+    if (board->config.clock_hz != 0)
+    {
+        // 9 clock cycles per byte (8 data bits + ACK)
+        delay_ns += (uint64_t)bytes * 9 * 1000000000ULL / board->config.clock_hz;
+    }
+    if (delay_ns == 0)
+    {
+        return;
+    }
+    struct timespec delay = {.tv_sec = delay_ns / 1000000000ULL, .tv_nsec = delay_ns % 1000000000ULL};
+    nanosleep(&delay, NULL);
+}
+
+static void *_sim_open(const char *path)
+{
+    static const uint8_t addresses[SIM_DEVICE_COUNT] = {WEATHER_ADDR, LIGHT_ADDR, MOTION_ADDR, ADC_ADDR};
+    sim_board_t *board = calloc(1, sizeof(sim_board_t));
+    if (board == NULL)
+    {
+        return NULL;
+    }
+    board->config = _sim_config;
+    for (int i = 0; i < SIM_DEVICE_COUNT; ++i)
+    {
+        board->devices[i].address = addresses[i];
+        for (int output = 0; output < SIM_IRQ_OUTPUTS; ++output)
+        {
+            board->devices[i].irq_fd[output] = -1;
+        }
+        _sim_reset_device(&board->devices[i]);
+    }
+#ifndef DISABLE_THREADSAFE
+    pthread_mutex_init(&board->lock, NULL);
+#endif // DISABLE_THREADSAFE
+    return board;
+}
+
+static bool _sim_select_slave(void *handle, uint8_t address)
+{
+    sim_board_t *board = handle;
+    if (address == board->config.absent_address || _sim_find(board, address) == NULL)
+    {
+        // simulated failures are reported as bus driver ones
+        cenviro_stats_ioctl_failure(address);
+        errno = ENXIO;
+        return false;
+    }
+    return true;
+}
+
+// single bus transaction
+static bool _sim_transaction(sim_board_t *board, cenviro_bus_msg_t *messages, size_t count)
+{
+    size_t bytes = 0;
+    bool status = true;
+
+    SIM_LOCK(board);
+    ++board->transfers;
+    if (board->config.fault_period != 0 && board->transfers % board->config.fault_period == 0)
+    {
+        SIM_UNLOCK(board);
+        _sim_delay(board, 1);
+        cenviro_stats_transfer_failure(messages, count);
+        errno = EIO;
+        return false;
+    }
+
+    uint64_t now = cenviro_monotonic_ns();
+    for (size_t i = 0; i < count; ++i)
+    {
+        sim_device_t *dev = _sim_find(board, messages[i].address);
+        // address byte
+        ++bytes;
+        if (dev == NULL || messages[i].address == board->config.absent_address)
+        {
+            errno = ENXIO;
+            status = false;
+            break;
+        }
+        _sim_update(dev, now);
+        if (messages[i].read)
+        {
+            _sim_read(dev, messages[i].data, messages[i].length);
+        }
+        else
+        {
+            _sim_write(board, dev, messages[i].data, messages[i].length, now);
+        }
+        bytes += messages[i].length;
+    }
+    for (int i = 0; i < SIM_DEVICE_COUNT; ++i)
+    {
+        _sim_arm_irq(&board->devices[i]);
+    }
+    SIM_UNLOCK(board);
+
+    if (!status)
+    {
+        cenviro_stats_transfer_failure(messages, count);
+    }
+    _sim_delay(board, bytes);
+    return status;
+}
+
+static bool _sim_transfer(void *handle, cenviro_bus_msg_t *messages, size_t count)
+{
+    sim_board_t *board = handle;
+    if (board->config.legacy_reads && count == 2 && !messages[0].read && messages[1].read)
+    {
+        // register read as done before combined transactions: address write, fixed wait, separate read
+        struct timespec wait = {.tv_sec = 0, .tv_nsec = SIM_COMMAND_WAIT_MS * 1000000L};
+        if (!_sim_transaction(board, &messages[0], 1))
+        {
+            return false;
+        }
+        nanosleep(&wait, NULL);
+        return _sim_transaction(board, &messages[1], 1);
+    }
+    return _sim_transaction(board, messages, count);
+}
+
+static void _sim_close(void *handle)
+{
+    sim_board_t *board = handle;
+    for (int i = 0; i < SIM_DEVICE_COUNT; ++i)
+    {
+        for (int output = 0; output < SIM_IRQ_OUTPUTS; ++output)
+        {
+            if (board->devices[i].irq_fd[output] >= 0)
+            {
+                close(board->devices[i].irq_fd[output]);
+            }
+        }
+    }
+#ifndef DISABLE_THREADSAFE
+    pthread_mutex_destroy(&board->lock);
+#endif // DISABLE_THREADSAFE
+    free(board);
+}
+
+const cenviro_bus_backend_t cenviro_bus_sim = {
+    .name = "sim",
+    .open = _sim_open,
+    .select_slave = _sim_select_slave,
+    .transfer = _sim_transfer,
+    .close = _sim_close};
+
+void cenviro_sim_configure(const cenviro_sim_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    if (config == NULL)
+    {
+        return;
+    }
+    _sim_config = *config;
+
+    sim_board_t *board = _sim_active_board();
+    if (board != NULL)
+    {
+        SIM_LOCK(board);
+        board->config = *config;
+        SIM_UNLOCK(board);
+    }
+}
+
+bool cenviro_sim_poke(uint8_t address, uint8_t reg, const uint8_t *data, size_t length)
+{
+    CENVIRO_PROBE_API();
+    sim_board_t *board = _sim_active_board();
+    if (board == NULL || data == NULL)
+    {
+        return false;
+    }
+    sim_device_t *dev = _sim_find(board, address);
+    if (dev == NULL)
+    {
+        return false;
+    }
+
+    size_t limit = (address == ADC_ADDR) ? SIM_ADS_REGISTERS * 2 : SIM_REGS;
+    size_t offset = (address == ADC_ADDR) ? reg * 2 : reg;
+    if (offset + length > limit)
+    {
+        return false;
+    }
+
+    SIM_LOCK(board);
+    memcpy(&dev->regs[offset], data, length);
+    _sim_arm_irq(dev);
+    SIM_UNLOCK(board);
+    return true;
+}
+
+int cenviro_sim_irq_fd(uint8_t address, uint8_t output)
+{
+    sim_board_t *board = _sim_active_board();
+    if (board == NULL || output >= SIM_IRQ_OUTPUTS)
+    {
+        return -1;
+    }
+    sim_device_t *dev = _sim_find(board, address);
+    if (dev == NULL)
+    {
+        return -1;
+    }
+
+    SIM_LOCK(board);
+    if (dev->irq_fd[output] < 0)
+    {
+        dev->irq_fd[output] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (dev->irq_fd[output] >= 0)
+        {
+            _sim_arm_irq(dev);
+        }
+    }
+    int fd = dev->irq_fd[output];
+    SIM_UNLOCK(board);
+    return fd;
+}
+
+uint64_t cenviro_sim_transfers()
+{
+    CENVIRO_PROBE_API();
+    sim_board_t *board = _sim_active_board();
+    if (board == NULL)
+    {
+        return 0;
+    }
+    SIM_LOCK(board);
+    uint64_t transfers = board->transfers;
+    SIM_UNLOCK(board);
+    return transfers;
+}
+
+void cenviro_sim_led_set(bool state)
+{
+    sim_board_t *board = _sim_active_board();
+    if (board == NULL)
+    {
+        return;
+    }
+    SIM_LOCK(board);
+    board->led = state;
+    SIM_UNLOCK(board);
+}
+
+bool cenviro_sim_led()
+{
+    CENVIRO_PROBE_API();
+    sim_board_t *board = _sim_active_board();
+    if (board == NULL)
+    {
+        return false;
+    }
+    SIM_LOCK(board);
+    bool state = board->led;
+    SIM_UNLOCK(board);
+    return state;
+}
@@ -0,0 +1,109 @@
+#include "cenviro.h"
+#include "internal.h"
+#include "logs.h"
+
+// all selected data blocks are read in single bus transaction (one I2C_RDWR with pair of messages per data block)
+cenviro_snapshot_t cenviro_read_all(unsigned sensor_mask)
+{
+    CENVIRO_PROBE_API();
+    cenviro_snapshot_t snapshot = {0};
+    cenviro_bus_msg_t messages[8];
+    size_t count = 0;
+
+    uint8_t weather_reg = WEATHER_BLOCK_REG;
+    uint8_t weather_block[WEATHER_BLOCK_LEN];
+    uint8_t light_reg = LIGHT_BLOCK_REG;
+    uint8_t light_block[LIGHT_BLOCK_LEN];
+    uint64_t light_valid_ns = 0;
+    uint8_t motion_reg = MOTION_BLOCK_REG;
+    uint8_t motion_block[MOTION_BLOCK_LEN];
+    uint8_t accel_reg = MOTION_ACCEL_BLOCK_REG;
+    uint8_t accel_block[MOTION_ACCEL_BLOCK_LEN];
+    bool accel = false;
+    unsigned forced_valid = 0;
+
+    if (!cenviro_weather_ready())
+    {
+        sensor_mask &= ~CENVIRO_SENSOR_WEATHER;
+    }
+    else if ((sensor_mask & CENVIRO_SENSOR_WEATHER) && cenviro_weather_forced_mode())
+    {
+        // sleeping chip keeps result of last conversion - fresh one needs status polling, so it cannot be part
+        // of shared transaction
+        sensor_mask &= ~CENVIRO_SENSOR_WEATHER;
+        if (cenviro_weather_read_forced(&snapshot.temperature, &snapshot.pressure))
+        {
+            forced_valid = CENVIRO_SENSOR_WEATHER;
+        }
+    }
+    if (!cenviro_light_ready())
+    {
+        sensor_mask &= ~CENVIRO_SENSOR_LIGHT;
+    }
+    if (!cenviro_motion_ready())
+    {
+        sensor_mask &= ~CENVIRO_SENSOR_MOTION;
+    }
+
+    if (sensor_mask & CENVIRO_SENSOR_WEATHER)
+    {
+        messages[count++] = (cenviro_bus_msg_t){.address = WEATHER_ADDR, .read = false, .length = 1, .data = &weather_reg};
+        messages[count++] = (cenviro_bus_msg_t){.address = WEATHER_ADDR, .read = true, .length = WEATHER_BLOCK_LEN, .data = weather_block};
+    }
+    if (sensor_mask & CENVIRO_SENSOR_LIGHT)
+    {
+        cenviro_light_cycle(&light_valid_ns, &snapshot.light_integration_us, &snapshot.light_gain);
+        messages[count++] = (cenviro_bus_msg_t){.address = LIGHT_ADDR, .read = false, .length = 1, .data = &light_reg};
+        messages[count++] = (cenviro_bus_msg_t){.address = LIGHT_ADDR, .read = true, .length = LIGHT_BLOCK_LEN, .data = light_block};
+    }
+    if (sensor_mask & CENVIRO_SENSOR_MOTION)
+    {
+        messages[count++] = (cenviro_bus_msg_t){.address = MOTION_ADDR, .read = false, .length = 1, .data = &motion_reg};
+        messages[count++] = (cenviro_bus_msg_t){.address = MOTION_ADDR, .read = true, .length = MOTION_BLOCK_LEN, .data = motion_block};
+        // streamed samples are left in FIFO for application ring buffer
+        accel = !cenviro_motion_streaming();
+        if (accel)
+        {
+            messages[count++] = (cenviro_bus_msg_t){.address = MOTION_ADDR, .read = false, .length = 1, .data = &accel_reg};
+            messages[count++] = (cenviro_bus_msg_t){.address = MOTION_ADDR, .read = true, .length = MOTION_ACCEL_BLOCK_LEN, .data = accel_block};
+        }
+    }
+    if (count == 0)
+    {
+        snapshot.timestamp_ns = (forced_valid != 0) ? cenviro_monotonic_ns() : 0;
+        snapshot.valid = forced_valid;
+        return snapshot;
+    }
+
+    uint64_t start = cenviro_monotonic_ns();
+    if (!cenviro_bus_transfer(messages, count))
+    {
+        LOG("Failed to read sensors data\n");
+        snapshot.valid = forced_valid;
+        return snapshot;
+    }
+    // all values come from the same transaction so single timestamp (middle of transfer) is used
+    snapshot.timestamp_ns = start + (cenviro_monotonic_ns() - start) / 2;
+
+    // data conversion is done after the bus is released
+    if (sensor_mask & CENVIRO_SENSOR_WEATHER)
+    {
+        cenviro_weather_decode(weather_block, &snapshot.temperature, &snapshot.pressure);
+    }
+    // light counts of incomplete integration cycle (right after configuration change) are not reported
+    if ((sensor_mask & CENVIRO_SENSOR_LIGHT) &&
+        !cenviro_light_decode_status(light_block, light_valid_ns, snapshot.timestamp_ns, &snapshot.crgb))
+    {
+        sensor_mask &= ~CENVIRO_SENSOR_LIGHT;
+    }
+    if (sensor_mask & CENVIRO_SENSOR_MOTION)
+    {
+        cenviro_motion_decode(motion_block, &snapshot.motion_temperature, &snapshot.magnetic);
+        if (accel)
+        {
+            snapshot.acceleration = cenviro_motion_decode_acceleration(accel_block);
+        }
+    }
+    snapshot.valid = sensor_mask | forced_valid;
+    return snapshot;
+}
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <string.h>
+
+#include "cenviro.h"
+#include "context.h"
+#include "internal.h"
+#include "logs.h"
+
+// Bus statistics: transfers are recorded by cenviro_bus_transfer() while it still holds bus lock, so
+// counters and histograms are plain memory updates (no atomics on the hot path). Retries and driver
+// failures are reported from places which do not hold the lock and use relaxed atomic counters.
+// Statistics belong to context (bus) of calling thread.
+
+// device index of slave address, -1 - address of unknown device
+static int _stats_device(uint8_t address)
+{
+    switch (address)
+    {
+    case WEATHER_ADDR:
+        return CENVIRO_STATS_WEATHER;
+    case LIGHT_ADDR:
+        return CENVIRO_STATS_LIGHT;
+    case MOTION_ADDR:
+        return CENVIRO_STATS_MOTION;
+    case ADC_ADDR:
+        return CENVIRO_STATS_ADC;
+    default:
+        return -1;
+    }
+}
+
+static unsigned _stats_bucket(uint64_t ns)
+{
+    unsigned bucket = 63 - __builtin_clzll(ns | 1);
+    return (bucket < CENVIRO_STATS_BUCKETS) ? bucket : CENVIRO_STATS_BUCKETS - 1;
+}
+
+void cenviro_stats_transfer(const cenviro_bus_msg_t *messages, size_t count, bool status, uint64_t lock_wait_ns,
+                            uint64_t transfer_ns)
+{
+    cenviro_stats_t *bus_stats = &_cenviro_ctx->stats;
+    int error = status ? 0 : errno;
+    unsigned addressed = 0;
+
+    bus_stats->transactions++;
+    bus_stats->transfer_total_ns += transfer_ns;
+    bus_stats->lock_wait_total_ns += lock_wait_ns;
+    bus_stats->transfer_ns[_stats_bucket(transfer_ns)]++;
+    bus_stats->lock_wait_ns[_stats_bucket(lock_wait_ns)]++;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int device = _stats_device(messages[i].address);
+        if (device < 0)
+        {
+            continue;
+        }
+        bus_stats->devices[device].bytes += messages[i].length;
+        addressed |= 1u << device;
+    }
+    for (int device = 0; device < CENVIRO_STATS_DEVICES; ++device)
+    {
+        if (!(addressed & (1u << device)))
+        {
+            continue;
+        }
+        bus_stats->devices[device].transactions++;
+        if (!status)
+        {
+            bus_stats->devices[device].errors++;
+            bus_stats->devices[device].last_error = (error != 0) ? error : EIO;
+        }
+    }
+}
+
+void cenviro_stats_retry(uint8_t address)
+{
+    cenviro_stats_t *bus_stats = &_cenviro_ctx->stats;
+    int device = _stats_device(address);
+    if (device >= 0)
+    {
+        __atomic_fetch_add(&bus_stats->devices[device].retries, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void cenviro_stats_ioctl_failure(uint8_t address)
+{
+    cenviro_stats_t *bus_stats = &_cenviro_ctx->stats;
+    int device = _stats_device(address);
+    if (device >= 0)
+    {
+        __atomic_fetch_add(&bus_stats->devices[device].ioctl_failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void cenviro_stats_transfer_failure(const cenviro_bus_msg_t *messages, size_t count)
+{
+    cenviro_stats_t *bus_stats = &_cenviro_ctx->stats;
+    unsigned addressed = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int device = _stats_device(messages[i].address);
+        if (device >= 0 && !(addressed & (1u << device)))
+        {
+            addressed |= 1u << device;
+            __atomic_fetch_add(&bus_stats->devices[device].ioctl_failures, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool cenviro_stats_get(cenviro_stats_t *stats)
+{
+    CENVIRO_PROBE_API();
+    cenviro_stats_t *bus_stats = &_cenviro_ctx->stats;
+    if (stats == NULL)
+    {
+        return false;
+    }
+    CENVIRO_LOCK(&_cenviro_ctx->bus.lock);
+    *stats = *bus_stats;
+    for (int device = 0; device < CENVIRO_STATS_DEVICES; ++device)
+    {
+        stats->devices[device].retries = __atomic_load_n(&bus_stats->devices[device].retries, __ATOMIC_RELAXED);
+        stats->devices[device].ioctl_failures = __atomic_load_n(&bus_stats->devices[device].ioctl_failures, __ATOMIC_RELAXED);
+    }
+    CENVIRO_UNLOCK(&_cenviro_ctx->bus.lock);
+    return true;
+}
+
+void cenviro_stats_reset()
+{
+    CENVIRO_PROBE_API();
+    cenviro_stats_t *bus_stats = &_cenviro_ctx->stats;
+    CENVIRO_LOCK(&_cenviro_ctx->bus.lock);
+    bus_stats->transactions = 0;
+    bus_stats->transfer_total_ns = 0;
+    bus_stats->lock_wait_total_ns = 0;
+    memset(bus_stats->transfer_ns, 0, sizeof(bus_stats->transfer_ns));
+    memset(bus_stats->lock_wait_ns, 0, sizeof(bus_stats->lock_wait_ns));
+    for (int device = 0; device < CENVIRO_STATS_DEVICES; ++device)
+    {
+        cenviro_device_stats_t *counters = &bus_stats->devices[device];
+        counters->transactions = 0;
+        counters->bytes = 0;
+        counters->errors = 0;
+        counters->last_error = 0;
+        __atomic_store_n(&counters->retries, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters->ioctl_failures, 0, __ATOMIC_RELAXED);
+    }
+    CENVIRO_UNLOCK(&_cenviro_ctx->bus.lock);
+}
+
+uint64_t cenviro_stats_percentile(const uint64_t *histogram, double fraction)
+{
+    CENVIRO_PROBE_API();
+    if (histogram == NULL)
+    {
+        return 0;
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < CENVIRO_STATS_BUCKETS; ++i)
+    {
+        total += histogram[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(fraction * total + 0.5);
+    target = (target == 0) ? 1 : target;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < CENVIRO_STATS_BUCKETS; ++i)
+    {
+        cumulative += histogram[i];
+        if (cumulative >= target)
+        {
+            return 2ULL << i;
+        }
+    }
+    return 2ULL << (CENVIRO_STATS_BUCKETS - 1);
+}
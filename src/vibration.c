@@ -0,0 +1,414 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cenviro.h"
+#include "internal.h"
+#include "logs.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+// Vibration analysis of single window (N samples):
+// - mean is removed, RMS and peak are computed from remaining AC part,
+// - windowed samples are packed as N/2 complex values (even - real, odd - imaginary part) in bit-reversed order,
+// - iterative radix-2 FFT of length N/2 (twiddles of each stage are stored contiguously),
+// - split step turns it into spectrum of N real samples, power is scaled so sum of all bins gives mean square.
+// Complex values are kept as separate real/imaginary arrays, butterflies of stages with 4 or more twiddles
+// use NEON when available - scalar loops have the same layout and are vectorized by compiler (-O3) elsewhere.
+
+#define VIBRATION_WINDOW_MIN 16
+#define VIBRATION_WINDOW_MAX 8192
+// buffer alignment (SIMD loads)
+#define VIBRATION_ALIGN 16
+
+struct cenviro_vibration
+{
+    cenviro_vibration_config_t config;
+    uint32_t half;      // N/2 - complex FFT length
+    float window_power; // sum of squared window coefficients
+    float bin_hz;
+    uint32_t band_first[CENVIRO_VIBRATION_BANDS_MAX];
+    uint32_t band_end[CENVIRO_VIBRATION_BANDS_MAX];
+    uint32_t *bit_reverse;
+    // single allocation, all arrays are aligned
+    float *storage;
+    float *window;
+    float *work;
+    float *re;
+    float *im;
+    float *twiddle_re;
+    float *twiddle_im;
+    float *split_re;
+    float *split_im;
+    float *power;
+    // incomplete window of ring buffer samples
+    float *pending;
+    uint32_t pending_count;
+    uint64_t pending_first;
+};
+
+static bool _vibration_config_valid(const cenviro_vibration_config_t *config);
+static void _vibration_tables(cenviro_vibration_t *analyzer);
+static void _vibration_fft(cenviro_vibration_t *analyzer);
+static void _vibration_butterflies(float *restrict a_re, float *restrict a_im, float *restrict b_re, float *restrict b_im,
+                                   const float *restrict w_re, const float *restrict w_im, uint32_t count);
+static void _vibration_spectrum(cenviro_vibration_t *analyzer);
+static float _vibration_sample(const cenviro_accel_raw_t *sample, cenviro_axis_t axis, float scale);
+
+cenviro_vibration_t *cenviro_vibration_create(const cenviro_vibration_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    if (config == NULL || !_vibration_config_valid(config))
+    {
+        return NULL;
+    }
+    cenviro_vibration_t *analyzer = calloc(1, sizeof(cenviro_vibration_t));
+    if (analyzer == NULL)
+    {
+        LOG("Failed to allocate vibration analyzer\n");
+        return NULL;
+    }
+    analyzer->config = *config;
+    if (analyzer->config.sample_rate_hz == 0)
+    {
+        analyzer->config.sample_rate_hz = cenviro_motion_config().accel_rate_hz;
+    }
+    const uint32_t size = config->window_size;
+    const uint32_t half = size / 2;
+    analyzer->half = half;
+    analyzer->bin_hz = (float)analyzer->config.sample_rate_hz / size;
+
+    // window, work and pending (N each), 6 arrays of N/2 and power spectrum (N/2 + 1, padded)
+    size_t floats = 3 * (size_t)size + 6 * (size_t)half + half + VIBRATION_ALIGN / sizeof(float);
+    void *storage = NULL;
+    analyzer->bit_reverse = malloc(half * sizeof(uint32_t));
+    if (analyzer->bit_reverse == NULL || posix_memalign(&storage, VIBRATION_ALIGN, floats * sizeof(float)) != 0)
+    {
+        LOG("Failed to allocate vibration analyzer buffers\n");
+        free(analyzer->bit_reverse);
+        free(analyzer);
+        return NULL;
+    }
+    analyzer->storage = storage;
+    analyzer->window = analyzer->storage;
+    analyzer->work = analyzer->window + size;
+    analyzer->pending = analyzer->work + size;
+    analyzer->re = analyzer->pending + size;
+    analyzer->im = analyzer->re + half;
+    analyzer->twiddle_re = analyzer->im + half;
+    analyzer->twiddle_im = analyzer->twiddle_re + half;
+    analyzer->split_re = analyzer->twiddle_im + half;
+    analyzer->split_im = analyzer->split_re + half;
+    analyzer->power = analyzer->split_im + half;
+
+    _vibration_tables(analyzer);
+    return analyzer;
+}
+
+void cenviro_vibration_destroy(cenviro_vibration_t *analyzer)
+{
+    CENVIRO_PROBE_API();
+    if (analyzer == NULL)
+    {
+        return;
+    }
+    free(analyzer->storage);
+    free(analyzer->bit_reverse);
+    free(analyzer);
+}
+
+bool cenviro_vibration_analyze(cenviro_vibration_t *analyzer, const float *samples, cenviro_vibration_result_t *result)
+{
+    CENVIRO_PROBE_API();
+    if (analyzer == NULL || samples == NULL || result == NULL)
+    {
+        return false;
+    }
+    const uint32_t size = analyzer->config.window_size;
+    const uint32_t half = analyzer->half;
+    const float *restrict window = analyzer->window;
+    float *restrict work = analyzer->work;
+
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        sum += samples[i];
+    }
+    const float mean = sum / size;
+
+    float square_sum = 0.0f;
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        float value = samples[i] - mean;
+        float magnitude = fabsf(value);
+        square_sum += value * value;
+        peak = (magnitude > peak) ? magnitude : peak;
+        work[i] = value * window[i];
+    }
+    result->rms = sqrtf(square_sum / size);
+    result->peak = peak;
+    result->crest = (result->rms > 0.0f) ? peak / result->rms : 0.0f;
+
+    // even/odd samples become real/imaginary parts, gathered in bit-reversed order for in-place FFT
+    for (uint32_t i = 0; i < half; ++i)
+    {
+        uint32_t source = 2 * analyzer->bit_reverse[i];
+        analyzer->re[i] = work[source];
+        analyzer->im[i] = work[source + 1];
+    }
+    _vibration_fft(analyzer);
+    _vibration_spectrum(analyzer);
+
+    const float *power = analyzer->power;
+    uint32_t dominant = 1;
+    for (uint32_t k = 2; k <= half; ++k)
+    {
+        dominant = (power[k] > power[dominant]) ? k : dominant;
+    }
+    result->dominant_hz = dominant * analyzer->bin_hz;
+
+    memset(result->band_power, 0, sizeof(result->band_power));
+    for (uint32_t band = 0; band < analyzer->config.band_count; ++band)
+    {
+        float energy = 0.0f;
+        for (uint32_t k = analyzer->band_first[band]; k < analyzer->band_end[band]; ++k)
+        {
+            energy += power[k];
+        }
+        result->band_power[band] = energy;
+    }
+    result->first = 0;
+    return true;
+}
+
+int cenviro_vibration_process(cenviro_vibration_t *analyzer, cenviro_motion_ring_t *ring, cenviro_vibration_result_t *results,
+                              size_t max_results)
+{
+    CENVIRO_PROBE_API();
+    if (analyzer == NULL || ring == NULL || ring->samples == NULL || ring->capacity == 0 || (results == NULL && max_results > 0))
+    {
+        return -1;
+    }
+    const float scale = (float)cenviro_motion_accel_scale();
+    const uint32_t size = analyzer->config.window_size;
+    uint64_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+    uint64_t position = ring->read;
+    size_t stored = 0;
+
+    // ring is left untouched once results are full, so remaining samples wait for the next call
+    while (position < written && stored < max_results)
+    {
+        if (analyzer->pending_count == 0)
+        {
+            analyzer->pending_first = position;
+        }
+        const cenviro_accel_raw_t *sample = &ring->samples[position % ring->capacity];
+        analyzer->pending[analyzer->pending_count++] = _vibration_sample(sample, analyzer->config.axis, scale);
+        ++position;
+
+        if (analyzer->pending_count == size)
+        {
+            cenviro_vibration_analyze(analyzer, analyzer->pending, &results[stored]);
+            results[stored].first = analyzer->pending_first;
+            analyzer->pending_count = 0;
+            ++stored;
+        }
+    }
+    __atomic_store_n(&ring->read, position, __ATOMIC_RELEASE);
+    return (int)stored;
+}
+
+static bool _vibration_config_valid(const cenviro_vibration_config_t *config)
+{
+    uint32_t size = config->window_size;
+    if (size < VIBRATION_WINDOW_MIN || size > VIBRATION_WINDOW_MAX || (size & (size - 1)) != 0)
+    {
+        LOG("Vibration window size has to be power of two\n");
+        return false;
+    }
+    if (config->window > CENVIRO_WINDOW_HAMMING || config->axis > CENVIRO_AXIS_MAGNITUDE ||
+        config->band_count > CENVIRO_VIBRATION_BANDS_MAX)
+    {
+        LOG("Invalid vibration analysis parameters\n");
+        return false;
+    }
+    for (uint32_t band = 0; band < config->band_count; ++band)
+    {
+        if (!(config->band_edges_hz[band] >= 0.0f && config->band_edges_hz[band] < config->band_edges_hz[band + 1]))
+        {
+            LOG("Vibration band edges have to be increasing\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// window coefficients, twiddle factors and band limits are computed once (in double precision)
+static void _vibration_tables(cenviro_vibration_t *analyzer)
+{
+    const uint32_t size = analyzer->config.window_size;
+    const uint32_t half = analyzer->half;
+
+    double window_power = 0.0;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        // periodic windows (no leakage for frequencies matching FFT bins)
+        double phase = 2.0 * M_PI * i / size;
+        double value = 1.0;
+        if (analyzer->config.window == CENVIRO_WINDOW_HANN)
+        {
+            value = 0.5 - 0.5 * cos(phase);
+        }
+        else if (analyzer->config.window == CENVIRO_WINDOW_HAMMING)
+        {
+            value = 0.54 - 0.46 * cos(phase);
+        }
+        analyzer->window[i] = (float)value;
+        window_power += value * value;
+    }
+    analyzer->window_power = (float)window_power;
+
+    uint32_t bits = 0;
+    while ((1u << bits) < half)
+    {
+        ++bits;
+    }
+    for (uint32_t i = 0; i < half; ++i)
+    {
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < bits; ++bit)
+        {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        analyzer->bit_reverse[i] = reversed;
+    }
+
+    // stage with span m uses m twiddles exp(-i*pi*j/m) stored at offset m - 1
+    for (uint32_t span = 1; span < half; span *= 2)
+    {
+        for (uint32_t j = 0; j < span; ++j)
+        {
+            double angle = -M_PI * j / span;
+            analyzer->twiddle_re[span - 1 + j] = (float)cos(angle);
+            analyzer->twiddle_im[span - 1 + j] = (float)sin(angle);
+        }
+    }
+    for (uint32_t k = 0; k < half; ++k)
+    {
+        double angle = -2.0 * M_PI * k / size;
+        analyzer->split_re[k] = (float)cos(angle);
+        analyzer->split_im[k] = (float)sin(angle);
+    }
+
+    // band i sums bins with frequency in [edge i, edge i + 1), last one may reach Nyquist bin
+    for (uint32_t band = 0; band < analyzer->config.band_count; ++band)
+    {
+        double first = ceil(analyzer->config.band_edges_hz[band] / analyzer->bin_hz);
+        double end = ceil(analyzer->config.band_edges_hz[band + 1] / analyzer->bin_hz);
+        analyzer->band_first[band] = (first > half + 1) ? half + 1 : (uint32_t)first;
+        analyzer->band_end[band] = (end > half + 1) ? half + 1 : (uint32_t)end;
+    }
+}
+
+static void _vibration_fft(cenviro_vibration_t *analyzer)
+{
+    const uint32_t half = analyzer->half;
+    float *re = analyzer->re;
+    float *im = analyzer->im;
+
+    for (uint32_t span = 1; span < half; span *= 2)
+    {
+        const float *w_re = analyzer->twiddle_re + span - 1;
+        const float *w_im = analyzer->twiddle_im + span - 1;
+        for (uint32_t start = 0; start < half; start += 2 * span)
+        {
+            _vibration_butterflies(re + start, im + start, re + start + span, im + start + span, w_re, w_im, span);
+        }
+    }
+}
+
+// a' = a + w * b, b' = a - w * b for count consecutive pairs (a and b halves of block never overlap)
+static void _vibration_butterflies(float *restrict a_re, float *restrict a_im, float *restrict b_re, float *restrict b_im,
+                                   const float *restrict w_re, const float *restrict w_im, uint32_t count)
+{
+    uint32_t j = 0;
+#if defined(__ARM_NEON)
+    for (; j + 4 <= count; j += 4)
+    {
+        float32x4_t x_re = vld1q_f32(b_re + j);
+        float32x4_t x_im = vld1q_f32(b_im + j);
+        float32x4_t c = vld1q_f32(w_re + j);
+        float32x4_t s = vld1q_f32(w_im + j);
+        float32x4_t t_re = vmlsq_f32(vmulq_f32(x_re, c), x_im, s);
+        float32x4_t t_im = vmlaq_f32(vmulq_f32(x_re, s), x_im, c);
+        float32x4_t u_re = vld1q_f32(a_re + j);
+        float32x4_t u_im = vld1q_f32(a_im + j);
+        vst1q_f32(a_re + j, vaddq_f32(u_re, t_re));
+        vst1q_f32(a_im + j, vaddq_f32(u_im, t_im));
+        vst1q_f32(b_re + j, vsubq_f32(u_re, t_re));
+        vst1q_f32(b_im + j, vsubq_f32(u_im, t_im));
+    }
+#endif // __ARM_NEON
+    for (; j < count; ++j)
+    {
+        float t_re = b_re[j] * w_re[j] - b_im[j] * w_im[j];
+        float t_im = b_re[j] * w_im[j] + b_im[j] * w_re[j];
+        float u_re = a_re[j];
+        float u_im = a_im[j];
+        a_re[j] = u_re + t_re;
+        a_im[j] = u_im + t_im;
+        b_re[j] = u_re - t_re;
+        b_im[j] = u_im - t_im;
+    }
+}
+
+// spectrum of real signal from half-length complex FFT Z:
+//   X[k] = (Z[k] + Z*[M-k]) / 2 - i * W^k * (Z[k] - Z*[M-k]) / 2, W = exp(-2*pi*i/N)
+// one-sided power (DC and Nyquist bins are not doubled) normalized by N * sum(window^2)
+static void _vibration_spectrum(cenviro_vibration_t *analyzer)
+{
+    const uint32_t half = analyzer->half;
+    const float *restrict re = analyzer->re;
+    const float *restrict im = analyzer->im;
+    const float *restrict w_re = analyzer->split_re;
+    const float *restrict w_im = analyzer->split_im;
+    float *restrict power = analyzer->power;
+    const float scale = 1.0f / (analyzer->config.window_size * analyzer->window_power);
+
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]) * scale;
+    power[half] = (re[0] - im[0]) * (re[0] - im[0]) * scale;
+    for (uint32_t k = 1; k < half; ++k)
+    {
+        float even_re = 0.5f * (re[k] + re[half - k]);
+        float even_im = 0.5f * (im[k] - im[half - k]);
+        float odd_re = 0.5f * (re[k] - re[half - k]);
+        float odd_im = 0.5f * (im[k] + im[half - k]);
+        float p_re = w_re[k] * odd_re - w_im[k] * odd_im;
+        float p_im = w_re[k] * odd_im + w_im[k] * odd_re;
+        float x_re = even_re + p_im;
+        float x_im = even_im - p_re;
+        power[k] = 2.0f * (x_re * x_re + x_im * x_im) * scale;
+    }
+}
+
+static float _vibration_sample(const cenviro_accel_raw_t *sample, cenviro_axis_t axis, float scale)
+{
+    switch (axis)
+    {
+    case CENVIRO_AXIS_X:
+        return sample->x * scale;
+    case CENVIRO_AXIS_Y:
+        return sample->y * scale;
+    case CENVIRO_AXIS_Z:
+        return sample->z * scale;
+    default:
+        break;
+    }
+    float x = sample->x;
+    float y = sample->y;
+    float z = sample->z;
+    return sqrtf(x * x + y * y + z * z) * scale;
+}
@@ -1,9 +1,9 @@
-#include <linux/i2c-dev.h>
-#include <fcntl.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
 
 #include "cenviro.h"
+#include "context.h"
 #include "internal.h"
 #include "logs.h"
 
@@ -11,44 +11,52 @@
 #define BMP_ADDRESS_ID 0xd0
 #define BMP_ADDRESS_RESET 0xe0             // only 0xb6 has effect
 #define BMP_ADDRRESS_CONTROL 0xf4          // temp_measure | press measure | power mode
+#define BMP_ADDRESS_CONFIG 0xf5            // standby time | IIR filter | spi3w_en
 #define BMP_ADDRESS_CALIBRATION_TEMP 0x88  // lowest address of 6B temperature calibration data
-#define BMP_ADDRESS_CALIBRATION_PRESS 0x8e // lowest address of 6B pressure calibration data
+#define BMP_ADDRESS_CALIBRATION_PRESS 0x8e // lowest address of 18B pressure calibration data
+#define BMP_CALIBRATION_LEN 24             // temperature and pressure calibration data
 #define BMP_ADDRESS_RAW_TEMP 0xfa          // lowest address of 3B temperature data
 #define BMP_ADDRESS_RAW_PRESS 0xf7         // lowest address of 3B temperature data
-
-static bool _w_initialized = false;
+#define BMP_ADDRESS_STATUS 0xf3            // measuring | im_update
+#define BMP_STATUS_MEASURING 0x08
+// status, ctrl_meas, config, reserved 0xf6 byte and 6B data block read at once in forced mode
+#define BMP_STATUS_BLOCK_LEN (4 + WEATHER_BLOCK_LEN)
+
+#define BMP_POWER_MODE_SLEEP 0x00
+#define BMP_POWER_MODE_FORCED 0x01
+#define BMP_POWER_MODE_NORMAL 0x03
+
+// minimal status polling interval in forced mode [us]
+#define BMP_POLL_MIN 50
+
+// predefined measurement profiles
+static const cenviro_weather_config_t _w_profiles[] = {
+    [CENVIRO_WEATHER_ULTRA_LOW_POWER] = {CENVIRO_OVERSAMPLING_X1, CENVIRO_OVERSAMPLING_X1, CENVIRO_FILTER_OFF, CENVIRO_STANDBY_1000MS},
+    [CENVIRO_WEATHER_STANDARD] = {CENVIRO_OVERSAMPLING_X1, CENVIRO_OVERSAMPLING_X4, CENVIRO_FILTER_4, CENVIRO_STANDBY_125MS},
+    [CENVIRO_WEATHER_HIGH_RESOLUTION] = {CENVIRO_OVERSAMPLING_X1, CENVIRO_OVERSAMPLING_X8, CENVIRO_FILTER_4, CENVIRO_STANDBY_62_5MS},
+    [CENVIRO_WEATHER_ULTRA_HIGH_RESOLUTION] = {CENVIRO_OVERSAMPLING_X2, CENVIRO_OVERSAMPLING_X16, CENVIRO_FILTER_4, CENVIRO_STANDBY_500MS},
+    [CENVIRO_WEATHER_INDOOR_NAVIGATION] = {CENVIRO_OVERSAMPLING_X2, CENVIRO_OVERSAMPLING_X16, CENVIRO_FILTER_16, CENVIRO_STANDBY_0_5MS}};
 
 // forward declaration of internal functions
 static bool _initialize_BMP();
+static bool _apply_BMP_config(const cenviro_weather_config_t *config, uint8_t power_mode);
+static bool _read_BMP_forced(uint8_t *block);
+static uint32_t _oversampling_count(cenviro_oversampling_t oversampling);
+static uint32_t _typical_measurement_us(const cenviro_weather_config_t *config);
 static bool _read_BMP_calibration_data();
-static int32_t _calibrate_temperature(int32_t adc_T);
-static int32_t _calibrate_pressure(int32_t adc_P);
-
-// temperature callibration
-static uint16_t _calibration_T1 = 0;
-static int16_t _calibration_T2 = 0;
-static int16_t _calibration_T3 = 0;
-// pressure calibration
-static uint16_t _calibration_P1 = 0;
-static int16_t _calibration_P2 = 0;
-static int16_t _calibration_P3 = 0;
-static int16_t _calibration_P4 = 0;
-static int16_t _calibration_P5 = 0;
-static int16_t _calibration_P6 = 0;
-static int16_t _calibration_P7 = 0;
-static int16_t _calibration_P8 = 0;
-static int16_t _calibration_P9 = 0;
+static int32_t _calibrate_temperature(int32_t adc_T, int32_t *fine);
+static int32_t _calibrate_pressure(int32_t adc_P, int32_t fine);
 
 // API functions definitions
 bool cenviro_weather_init()
 {
-    if (!_cenviro_initialized)
+    if (!_cenviro_ctx->initialized)
     {
         LOG("Library not initialized exiting");
         return false;
     }
 
-    if (ioctl(_cenviro_bus_fd, I2C_SLAVE, WEATHER_ADDR) < 0)
+    if (!cenviro_bus_probe(WEATHER_ADDR))
     {
         LOG("Failed to set weather sensor address\n");
         return false;
@@ -65,267 +73,452 @@ bool cenviro_weather_init()
         return false;
     }
 
-    _w_initialized = true;
     return true;
 }
 
 double cenviro_weather_temperature()
 {
-    if (!_w_initialized)
+    CENVIRO_PROBE_API();
+    if (!cenviro_weather_ready())
     {
         return 0.0;
     }
-    ssize_t count = 0;
-
-    CENVIRO_LOCK_MUTEX();
-    ioctl(_cenviro_bus_fd, I2C_SLAVE, WEATHER_ADDR);
-
-    _cenviro_buffer[0] = BMP_ADDRESS_RAW_TEMP;
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    if (cenviro_weather_forced_mode())
     {
-        LOG("Failed to send command for temp. reading\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return 0.0;
+        double temperature = 0.0;
+        double pressure = 0.0;
+        cenviro_weather_read(&temperature, &pressure);
+        return temperature;
     }
+    uint8_t buffer[3];
 
-    usleep(COMMAND_WAIT * 1000);
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 3);
-    if (count != 3)
+    if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRESS_RAW_TEMP, buffer, 3))
     {
         LOG("Failed to read raw temperature data\n");
-        CENVIRO_UNLOCK_MUTEX();
         return 0.0;
     }
 
     int32_t full_raw_temp = 0;
-    full_raw_temp = ((int32_t)_cenviro_buffer[0]) << 12 | ((int32_t)_cenviro_buffer[1]) << 4 | ((int32_t)_cenviro_buffer[2]) >> 4;
+    full_raw_temp = ((int32_t)buffer[0]) << 12 | ((int32_t)buffer[1]) << 4 | ((int32_t)buffer[2]) >> 4;
 
-    int32_t calibrated_temp = _calibrate_temperature(full_raw_temp);
-    CENVIRO_UNLOCK_MUTEX();
+    int32_t fine = 0;
+    int32_t calibrated_temp = _calibrate_temperature(full_raw_temp, &fine);
 
     return ((double)calibrated_temp) / 100;
 }
 
 double cenviro_weather_pressure()
 {
-    if (!_w_initialized)
+    CENVIRO_PROBE_API();
+    double temperature = 0.0;
+    double pressure = 0.0;
+
+    // pressure compensation needs temperature from the same measurement so both are read
+    if (!cenviro_weather_read(&temperature, &pressure))
     {
         return 0.0;
     }
+    return pressure;
+}
 
-    ssize_t count = 0;
-
-    CENVIRO_LOCK_MUTEX();
-    ioctl(_cenviro_bus_fd, I2C_SLAVE, WEATHER_ADDR);
-
-    _cenviro_buffer[0] = BMP_ADDRESS_RAW_PRESS;
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+bool cenviro_weather_read(double *temperature, double *pressure)
+{
+    CENVIRO_PROBE_API();
+    if (!cenviro_weather_ready() || temperature == NULL || pressure == NULL)
     {
-        LOG("Failed to send command for temp. reading\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return 0.0;
+        return false;
     }
+    if (cenviro_weather_forced_mode())
+    {
+        return cenviro_weather_read_forced(temperature, pressure);
+    }
+    uint8_t buffer[WEATHER_BLOCK_LEN];
 
-    usleep(COMMAND_WAIT * 1000);
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 3);
-    if (count != 3)
+    if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRESS_RAW_PRESS, buffer, WEATHER_BLOCK_LEN))
     {
-        LOG("Failed to read raw temperature data\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return 0.0;
+        LOG("Failed to read raw weather data\n");
+        return false;
     }
 
-    int32_t full_raw_press = 0;
-    full_raw_press = ((int32_t)_cenviro_buffer[0]) << 12 | ((int32_t)_cenviro_buffer[1]) << 4 | ((int32_t)_cenviro_buffer[2]) >> 4;
+    cenviro_weather_decode(buffer, temperature, pressure);
+    return true;
+}
+
+bool cenviro_weather_read_forced(double *temperature, double *pressure)
+{
+    CENVIRO_PROBE_API();
+    weather_state_t *weather = &_cenviro_ctx->weather;
+    if (!cenviro_weather_ready() || temperature == NULL || pressure == NULL)
+    {
+        return false;
+    }
+    uint8_t block[WEATHER_BLOCK_LEN];
 
-    int32_t calibrated_press = _calibrate_pressure(full_raw_press);
+    CENVIRO_LOCK(&weather->conversion_lock);
+    bool status = _read_BMP_forced(block);
+    // one-shot conversion leaves chip sleeping - normal mode is resumed unless forced mode is selected
+    CENVIRO_LOCK(&weather->state_lock);
+    if (!weather->forced && !_apply_BMP_config(&weather->config, BMP_POWER_MODE_NORMAL))
+    {
+        LOG("Failed to resume normal mode after forced conversion\n");
+    }
+    CENVIRO_UNLOCK(&weather->state_lock);
+    CENVIRO_UNLOCK(&weather->conversion_lock);
+    if (!status)
+    {
+        return false;
+    }
 
-    // return value in hPa
-    CENVIRO_UNLOCK_MUTEX();
-    return ((double)calibrated_press) / 100;
+    cenviro_weather_decode(block, temperature, pressure);
+    return true;
 }
 
-// internal functions definitions
+bool cenviro_weather_set_forced_mode(bool forced)
+{
+    CENVIRO_PROBE_API();
+    weather_state_t *weather = &_cenviro_ctx->weather;
+    if (!cenviro_weather_ready())
+    {
+        return false;
+    }
+    CENVIRO_LOCK(&weather->state_lock);
+    bool status = _apply_BMP_config(&weather->config, forced ? BMP_POWER_MODE_SLEEP : BMP_POWER_MODE_NORMAL);
+    if (status)
+    {
+        weather->forced = forced;
+    }
+    CENVIRO_UNLOCK(&weather->state_lock);
+    return status;
+}
 
-// initialize chip with simple temperature and pressure measurement in normal mode
-bool _initialize_BMP()
+bool cenviro_weather_forced_mode()
 {
-#define TEMP_MEASURE 0x01
-#define PRESS_MEASURE 0x01
-#define POWER_MODE 0x03
-    uint8_t config = (TEMP_MEASURE << 5) | (PRESS_MEASURE << 2) | POWER_MODE;
+    CENVIRO_PROBE_API();
+    weather_state_t *weather = &_cenviro_ctx->weather;
+    CENVIRO_LOCK(&weather->state_lock);
+    bool forced = weather->forced;
+    CENVIRO_UNLOCK(&weather->state_lock);
+    return forced;
+}
 
-    _cenviro_buffer[0] = BMP_ADDRRESS_CONTROL;
-    _cenviro_buffer[1] = config;
-    ssize_t count = 0;
+size_t cenviro_weather_read_batch(double *temperatures, double *pressures, uint64_t *timestamps_ns, size_t count,
+                                  uint32_t interval_ms)
+{
+    CENVIRO_PROBE_API();
+    if (!cenviro_weather_ready() || temperatures == NULL || pressures == NULL)
+    {
+        return 0;
+    }
 
-    // send config
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 2);
-    if (count != 2)
+    size_t stored = 0;
+    uint64_t deadline = cenviro_monotonic_ns();
+    for (size_t i = 0; i < count; ++i)
     {
-        LOG("Failed to write config\n");
-        return false;
+        if (i > 0 && interval_ms > 0)
+        {
+            // absolute deadlines - sampling period does not drift with read time
+            deadline += (uint64_t)interval_ms * 1000000;
+            struct timespec until = {.tv_sec = deadline / 1000000000ULL, .tv_nsec = deadline % 1000000000ULL};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+        }
+        if (!cenviro_weather_read(&temperatures[stored], &pressures[stored]))
+        {
+            continue;
+        }
+        if (timestamps_ns != NULL)
+        {
+            timestamps_ns[stored] = cenviro_monotonic_ns();
+        }
+        ++stored;
     }
+    return stored;
+}
 
-    // set device to return config
-    usleep(COMMAND_WAIT * 1000);
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+bool cenviro_weather_set_profile(cenviro_weather_profile_t profile)
+{
+    CENVIRO_PROBE_API();
+    if (profile < CENVIRO_WEATHER_ULTRA_LOW_POWER || profile > CENVIRO_WEATHER_INDOOR_NAVIGATION)
     {
-        LOG("Failed to send command for config read\n");
+        LOG("Unknown weather profile\n");
         return false;
     }
+    return cenviro_weather_configure(&_w_profiles[profile]);
+}
 
-    _cenviro_buffer[0] = 0x00;
-    usleep(COMMAND_WAIT * 1000);
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+bool cenviro_weather_configure(const cenviro_weather_config_t *config)
+{
+    CENVIRO_PROBE_API();
+    weather_state_t *weather = &_cenviro_ctx->weather;
+    if (config == NULL || config->osrs_t > CENVIRO_OVERSAMPLING_X16 || config->osrs_p > CENVIRO_OVERSAMPLING_X16 ||
+        config->filter > CENVIRO_FILTER_16 || config->standby > CENVIRO_STANDBY_4000MS)
     {
-        LOG("Failed to read config\n");
+        LOG("Invalid weather configuration\n");
         return false;
     }
-    if (config != _cenviro_buffer[0])
+    if (config->osrs_t == CENVIRO_OVERSAMPLING_SKIP)
     {
-        LOG("Sent and received config differs\n");
+        // temperature is needed for pressure compensation
+        LOG("Temperature measurement cannot be skipped\n");
         return false;
     }
 
-#undef TEMP_MEASURE
-#undef PRESS_MEASURE
-#undef POWER_MODE
+    // BMP280 is initialized on first use (its init applies stored configuration), ready sensor is updated here
+    bool ready = cenviro_weather_ready();
+    CENVIRO_LOCK(&weather->state_lock);
+    if (ready && !_apply_BMP_config(config, weather->forced ? BMP_POWER_MODE_SLEEP : BMP_POWER_MODE_NORMAL))
+    {
+        CENVIRO_UNLOCK(&weather->state_lock);
+        return false;
+    }
+    weather->config = *config;
+    CENVIRO_UNLOCK(&weather->state_lock);
     return true;
 }
 
-bool _read_BMP_calibration_data()
+cenviro_weather_config_t cenviro_weather_config()
+{
+    CENVIRO_PROBE_API();
+    weather_state_t *weather = &_cenviro_ctx->weather;
+    CENVIRO_LOCK(&weather->state_lock);
+    cenviro_weather_config_t config = weather->config;
+    CENVIRO_UNLOCK(&weather->state_lock);
+    return config;
+}
+
+// measurement time and output data rate computed as in BMP280 datasheet (chapter 3.8)
+cenviro_weather_timing_t cenviro_weather_timing()
+{
+    CENVIRO_PROBE_API();
+    static const uint32_t standby_us[] = {500, 62500, 125000, 250000, 500000, 1000000, 2000000, 4000000};
+    cenviro_weather_config_t config = cenviro_weather_config();
+    cenviro_weather_timing_t timing;
+
+    uint32_t osrs_t = _oversampling_count(config.osrs_t);
+    uint32_t osrs_p = _oversampling_count(config.osrs_p);
+
+    timing.measurement_us = 1250 + 2300 * osrs_t + (osrs_p ? 2300 * osrs_p + 575 : 0);
+    timing.period_us = _typical_measurement_us(&config) + standby_us[config.standby];
+    timing.output_rate_hz = 1000000.0 / timing.period_us;
+    return timing;
+}
+
+bool cenviro_weather_ready()
+{
+    return cenviro_module_ready(CENVIRO_MODULE_WEATHER);
+}
+
+// decode burst read of all data registers (pressure and temperature from the same measurement)
+void cenviro_weather_decode(const uint8_t *block, double *temperature, double *pressure)
+{
+    int32_t full_raw_press = ((int32_t)block[0]) << 12 | ((int32_t)block[1]) << 4 | ((int32_t)block[2]) >> 4;
+    int32_t full_raw_temp = ((int32_t)block[3]) << 12 | ((int32_t)block[4]) << 4 | ((int32_t)block[5]) >> 4;
+
+    // fine temperature is computed per sample (no state shared between calls)
+    int32_t fine = 0;
+    int32_t calibrated_temp = _calibrate_temperature(full_raw_temp, &fine);
+    int32_t calibrated_press = _calibrate_pressure(full_raw_press, fine);
+
+    *temperature = ((double)calibrated_temp) / 100;
+    *pressure = ((double)calibrated_press) / 100;
+}
+
+// internal functions definitions
+
+// initialize chip with current measurement configuration (normal mode unless forced mode was selected)
+bool _initialize_BMP()
+{
+    weather_state_t *weather = &_cenviro_ctx->weather;
+    CENVIRO_LOCK(&weather->state_lock);
+    bool status = _apply_BMP_config(&weather->config, weather->forced ? BMP_POWER_MODE_SLEEP : BMP_POWER_MODE_NORMAL);
+    CENVIRO_UNLOCK(&weather->state_lock);
+    return status;
+}
+
+// program measurement configuration and set power mode
+static bool _apply_BMP_config(const cenviro_weather_config_t *config, uint8_t power_mode)
 {
-    ssize_t count = 0;
+    uint8_t control = (config->osrs_t << 5) | (config->osrs_p << 2) | power_mode;
+    uint8_t filter = (config->standby << 5) | (config->filter << 2);
 
-    _cenviro_buffer[0] = BMP_ADDRESS_CALIBRATION_TEMP;
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    // 'config' register writes can be ignored in normal mode so chip is put to sleep first;
+    // all three register/value pairs are sent in single transaction
+    uint8_t pairs[5] = {BMP_POWER_MODE_SLEEP, BMP_ADDRESS_CONFIG, filter, BMP_ADDRRESS_CONTROL, control};
+    if (!cenviro_bus_write(WEATHER_ADDR, BMP_ADDRRESS_CONTROL, pairs, sizeof(pairs)))
     {
-        LOG("Failed to send command for temperature calibration read\n");
+        LOG("Failed to write config\n");
         return false;
     }
 
-    usleep(COMMAND_WAIT * 1000);
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 6);
-    if (count != 6)
+    // read config back for verification
+    uint8_t readback[2] = {0x00, 0x00};
+    if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRRESS_CONTROL, readback, 2))
     {
-        LOG("Failed to read pressure calibration data\n");
+        LOG("Failed to read config\n");
         return false;
     }
-    _calibration_T1 = ((uint16_t)_cenviro_buffer[1]) << 8 | (uint16_t)_cenviro_buffer[0];
-    _calibration_T2 = ((int16_t)_cenviro_buffer[3]) << 8 | (int16_t)_cenviro_buffer[2];
-    _calibration_T3 = ((int16_t)_cenviro_buffer[5]) << 8 | (int16_t)_cenviro_buffer[4];
-
-    _cenviro_buffer[0] = BMP_ADDRESS_CALIBRATION_PRESS;
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    if (control != readback[0] || filter != readback[1])
     {
-        LOG("Failed to send command for pressure calibration read\n");
+        LOG("Sent and received config differs\n");
         return false;
     }
+    return true;
+}
 
-    usleep(COMMAND_WAIT * 1000);
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 18);
-    if (count != 18)
+// trigger single conversion and wait for its completion polling 'measuring' bit of status register
+static bool _read_BMP_forced(uint8_t *block)
+{
+    cenviro_weather_config_t config = cenviro_weather_config();
+    cenviro_weather_timing_t timing = cenviro_weather_timing();
+    uint8_t control = (config.osrs_t << 5) | (config.osrs_p << 2) | BMP_POWER_MODE_FORCED;
+
+    if (!cenviro_bus_write(WEATHER_ADDR, BMP_ADDRRESS_CONTROL, &control, 1))
     {
-        LOG("Failed to read pressure calibration data\n");
+        LOG("Failed to trigger forced conversion\n");
         return false;
     }
+    uint64_t start = cenviro_monotonic_ns();
+
+    // typical conversion time is known from oversampling - do not poll before it passes
+    uint32_t typical_us = _typical_measurement_us(&config);
+    usleep(typical_us);
 
-    _calibration_P1 = ((uint16_t)_cenviro_buffer[1]) << 8 | (uint16_t)_cenviro_buffer[0];
-    _calibration_P2 = ((int16_t)_cenviro_buffer[3]) << 8 | (int16_t)_cenviro_buffer[2];
-    _calibration_P3 = ((int16_t)_cenviro_buffer[5]) << 8 | (int16_t)_cenviro_buffer[4];
-    _calibration_P4 = ((int16_t)_cenviro_buffer[7]) << 8 | (int16_t)_cenviro_buffer[6];
-    _calibration_P5 = ((int16_t)_cenviro_buffer[9]) << 8 | (int16_t)_cenviro_buffer[8];
-    _calibration_P6 = ((int16_t)_cenviro_buffer[11]) << 8 | (int16_t)_cenviro_buffer[10];
-    _calibration_P7 = ((int16_t)_cenviro_buffer[13]) << 8 | (int16_t)_cenviro_buffer[12];
-    _calibration_P8 = ((int16_t)_cenviro_buffer[15]) << 8 | (int16_t)_cenviro_buffer[14];
-    _calibration_P9 = ((int16_t)_cenviro_buffer[17]) << 8 | (int16_t)_cenviro_buffer[16];
+    // then back off adaptively (interval doubles) until maximum conversion time is twice exceeded
+    uint32_t step_us = (timing.measurement_us - typical_us) / 4;
+    if (step_us < BMP_POLL_MIN)
+    {
+        step_us = BMP_POLL_MIN;
+    }
+    uint64_t limit_ns = (uint64_t)timing.measurement_us * 2000;
+    uint8_t buffer[BMP_STATUS_BLOCK_LEN];
+    while (true)
+    {
+        // status and data registers are read at once so finished conversion costs single transaction
+        if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRESS_STATUS, buffer, BMP_STATUS_BLOCK_LEN))
+        {
+            LOG("Failed to read status\n");
+            return false;
+        }
+        if (!(buffer[0] & BMP_STATUS_MEASURING))
+        {
+            break;
+        }
+        if (cenviro_monotonic_ns() - start > limit_ns)
+        {
+            LOG("Forced conversion timeout\n");
+            return false;
+        }
+        cenviro_stats_retry(WEATHER_ADDR);
+        usleep(step_us);
+        step_us *= 2;
+    }
 
+    memcpy(block, &buffer[4], WEATHER_BLOCK_LEN);
     return true;
 }
 
-// temporary helper functions definitions
-uint8_t cenviro_weather_chip_id()
+static uint32_t _oversampling_count(cenviro_oversampling_t oversampling)
 {
-    if (!_w_initialized)
-    {
-        return 0x00;
-    }
+    return (oversampling == CENVIRO_OVERSAMPLING_SKIP) ? 0 : 1u << (oversampling - 1);
+}
+
+static uint32_t _typical_measurement_us(const cenviro_weather_config_t *config)
+{
+    uint32_t osrs_t = _oversampling_count(config->osrs_t);
+    uint32_t osrs_p = _oversampling_count(config->osrs_p);
+    return 1000 + 2000 * osrs_t + (osrs_p ? 2000 * osrs_p + 500 : 0);
+}
+
+// calibration PROM is taken from calibration cache when chip was already seen on this bus
+bool _read_BMP_calibration_data()
+{
+    weather_calibration_t *calibration = &_cenviro_ctx->weather.calibration;
+    uint8_t buffer[BMP_CALIBRATION_LEN];
+    uint8_t chip_id = 0x00;
 
-    CENVIRO_LOCK_MUTEX();
-    if (ioctl(_cenviro_bus_fd, I2C_SLAVE, WEATHER_ADDR) < 0)
+    if (!cenviro_calcache_get(WEATHER_ADDR, &chip_id, buffer, BMP_CALIBRATION_LEN))
     {
-        LOG("Failed to set weather sensor address\n");
-        CENVIRO_UNLOCK_MUTEX();
-        return false;
+        // temperature and pressure trimming parameters are stored in one continuous block
+        if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRESS_CALIBRATION_TEMP, buffer, BMP_CALIBRATION_LEN))
+        {
+            LOG("Failed to read calibration data\n");
+            return false;
+        }
+        if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRESS_ID, &chip_id, 1))
+        {
+            LOG("Failed to read chip id\n");
+            return false;
+        }
+        cenviro_calcache_put(WEATHER_ADDR, BMP_ADDRESS_ID, chip_id, BMP_ADDRESS_CALIBRATION_TEMP, buffer,
+                             BMP_CALIBRATION_LEN);
     }
 
-    _cenviro_buffer[0] = BMP_ADDRESS_ID;
-    ssize_t count = 0;
+    calibration->T1 = ((uint16_t)buffer[1]) << 8 | (uint16_t)buffer[0];
+    calibration->T2 = ((int16_t)buffer[3]) << 8 | (int16_t)buffer[2];
+    calibration->T3 = ((int16_t)buffer[5]) << 8 | (int16_t)buffer[4];
+
+    calibration->P1 = ((uint16_t)buffer[7]) << 8 | (uint16_t)buffer[6];
+    calibration->P2 = ((int16_t)buffer[9]) << 8 | (int16_t)buffer[8];
+    calibration->P3 = ((int16_t)buffer[11]) << 8 | (int16_t)buffer[10];
+    calibration->P4 = ((int16_t)buffer[13]) << 8 | (int16_t)buffer[12];
+    calibration->P5 = ((int16_t)buffer[15]) << 8 | (int16_t)buffer[14];
+    calibration->P6 = ((int16_t)buffer[17]) << 8 | (int16_t)buffer[16];
+    calibration->P7 = ((int16_t)buffer[19]) << 8 | (int16_t)buffer[18];
+    calibration->P8 = ((int16_t)buffer[21]) << 8 | (int16_t)buffer[20];
+    calibration->P9 = ((int16_t)buffer[23]) << 8 | (int16_t)buffer[22];
+
+    return true;
+}
 
-    count = write(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+// temporary helper functions definitions
+uint8_t cenviro_weather_chip_id()
+{
+    CENVIRO_PROBE_API();
+    if (!cenviro_weather_ready())
     {
-        LOG("Failed to write command for chip id\n");
-        CENVIRO_UNLOCK_MUTEX();
         return 0x00;
     }
 
-    usleep(COMMAND_WAIT * 1000);
-    count = read(_cenviro_bus_fd, _cenviro_buffer, 1);
-    if (count != 1)
+    uint8_t chip_id = 0x00;
+    if (!cenviro_bus_read(WEATHER_ADDR, BMP_ADDRESS_ID, &chip_id, 1))
     {
         LOG("Failed to read chip id\n");
-        CENVIRO_UNLOCK_MUTEX();
         return 0x00;
     }
 
-    CENVIRO_UNLOCK_MUTEX();
-    return _cenviro_buffer[0];
+    return chip_id;
 }
 
 // compute temperature
 
-int32_t t_fine = 0;
-
 // _calibrate_temperature() is a compensation function from Bosh specification for BMP280
-int32_t _calibrate_temperature(int32_t adc_T)
+// (t_fine is returned through 'fine' param instead of global variable)
+int32_t _calibrate_temperature(int32_t adc_T, int32_t *fine)
 {
-    int32_t var1, var2, T;
-    var1 = ((((adc_T >> 3) - ((int32_t)_calibration_T1 << 1))) * ((int32_t)_calibration_T2)) >> 11;
-    var2 = (((((adc_T >> 4) - ((int32_t)_calibration_T1)) * ((adc_T >> 4) - ((int32_t)_calibration_T1))) >> 12) *
-            ((int32_t)_calibration_T3)) >>
+    const weather_calibration_t *calibration = &_cenviro_ctx->weather.calibration;
+    int32_t var1, var2, T, t_fine;
+    var1 = ((((adc_T >> 3) - ((int32_t)calibration->T1 << 1))) * ((int32_t)calibration->T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((int32_t)calibration->T1)) * ((adc_T >> 4) - ((int32_t)calibration->T1))) >> 12) *
+            ((int32_t)calibration->T3)) >>
            14;
     t_fine = var1 + var2;
     T = (t_fine * 5 + 128) >> 8;
+    *fine = t_fine;
     return T;
 }
 
 // _calibrate_pressure() is a compensation function from Bosh specification for BMP280
-int32_t _calibrate_pressure(int32_t adc_P)
+int32_t _calibrate_pressure(int32_t adc_P, int32_t t_fine)
 {
+    const weather_calibration_t *calibration = &_cenviro_ctx->weather.calibration;
     int32_t var1 = 0, var2 = 0;
     uint32_t p = 0;
 
-    if (t_fine == 0)
-    {
-        // this param is computed during temperature computation but needed for pressure calibration
-        // if not set yet then force one temperature reading
-        cenviro_weather_temperature();
-    }
-
     var1 = (((int32_t)t_fine) >> 1) - (int32_t)64000;
-    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)_calibration_P6);
-    var2 = var2 + ((var1 * ((int32_t)_calibration_P5)) << 1);
-    var2 = (var2 >> 2) + (((int32_t)_calibration_P4) << 16);
-    var1 = (((_calibration_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)_calibration_P2) * var1) >> 1)) >> 18;
-    var1 = ((((32768 + var1)) * ((int32_t)_calibration_P1)) >> 15);
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)calibration->P6);
+    var2 = var2 + ((var1 * ((int32_t)calibration->P5)) << 1);
+    var2 = (var2 >> 2) + (((int32_t)calibration->P4) << 16);
+    var1 = (((calibration->P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)calibration->P2) * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * ((int32_t)calibration->P1)) >> 15);
     if (var1 == 0)
     {
         return 0; // avoid exception caused by division by zero
@@ -339,8 +532,8 @@ int32_t _calibrate_pressure(int32_t adc_P)
     {
         p = (p / (uint32_t)var1) * 2;
     }
-    var1 = (((int32_t)_calibration_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
-    var2 = (((int32_t)(p >> 2)) * ((int32_t)_calibration_P8)) >> 13;
-    p = (uint32_t)((int32_t)p + ((var1 + var2 + _calibration_P7) >> 4));
+    var1 = (((int32_t)calibration->P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t)(p >> 2)) * ((int32_t)calibration->P8)) >> 13;
+    p = (uint32_t)((int32_t)p + ((var1 + var2 + calibration->P7) >> 4));
     return p;
 }